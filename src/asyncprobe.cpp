@@ -0,0 +1,207 @@
+#include "asyncprobe.h"
+
+#include "probehelper.h"
+#include "safe_signals.h"
+#include "event_desc.h"
+#include "util.h"
+
+#include <QSocketNotifier>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <QLoggingCategory>
+#define THIS_SOURCE_FILE_LOG_CATEGORY "APRB"
+static Q_LOGGING_CATEGORY(category, THIS_SOURCE_FILE_LOG_CATEGORY)
+#define MYDBG(msg, ...) qCDebug(category, msg, ##__VA_ARGS__)
+
+// without a pidfd, look whether the reading child exited that often
+static_var const int child_retry_ms = 10;
+
+static int open_pidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    const long fd = ::syscall(SYS_pidfd_open, pid, 0);
+
+    if(fd < 0) {
+        MYDBG("pidfd_open(PID=%d): %s", int(pid), strerror(errno));
+        return (-1);
+    }
+
+    return int(fd);
+#else
+    Q_UNUSED(pid);
+    return (-1);
+#endif
+}
+
+AsyncProbe::AsyncProbe(QObject *parent, const QString &url, bool getc, off_t maxreadsize, qint64 timeout_msec, off_t offset)
+    : super()
+    , m_url(url)
+    , m_arf(url, getc, maxreadsize, offset)
+    , m_done(false)
+    , m_elapsed_msec(0)
+    , m_watched_msgfd(-1)
+    , m_msgnotifier(NULL)
+    , m_watched_pid(0)
+    , m_pidfd(-1)
+    , m_pidnotifier(NULL)
+    , m_watching_helper(false)
+{
+    setObjectName(QStringLiteral("AsyncProbe"));
+    setParent(parent);
+
+    MYDBG("probing \"%s\", %ld bytes from %ld, fail after %ld msec", qPrintable(m_url), (long int)maxreadsize, (long int)offset, (long int)timeout_msec);
+
+    m_clock.start();
+
+    m_childtimer.setSingleShot(true);
+    XCONNECT(&m_childtimer, SIGNAL(timeout()), this, SLOT(slot_step()), QUEUEDCONN);
+
+    m_timeouttimer.setSingleShot(true);
+    XCONNECT(&m_timeouttimer, SIGNAL(timeout()), this, SLOT(slot_timeout()), QUEUEDCONN);
+    m_timeouttimer.start(int(timeout_msec));
+
+    // not from here, nobody is connected yet
+    QTimer::singleShot(0, this, SLOT(slot_step()));
+}
+
+AsyncProbe::~AsyncProbe()
+{
+    unwatch();
+    m_timeouttimer.stop();
+}
+
+bool AsyncProbe::event(QEvent *event)
+{
+    log_qevent(category(), this, event);
+
+    return super::event(event);
+}
+
+void AsyncProbe::slot_fd_ready(int fd)
+{
+    Q_UNUSED(fd);
+    slot_step();
+}
+
+void AsyncProbe::slot_step()
+{
+    if(m_done) {
+        return;
+    }
+
+    bool more = true;
+    bool made_progress = true;
+
+    while(more && made_progress) {
+        more = m_arf.iter(&m_errors, &made_progress);
+    }
+
+    if(!more) {
+        finish_probe();
+        return;
+    }
+
+    watch();
+}
+
+void AsyncProbe::slot_timeout()
+{
+    if(m_done) {
+        return;
+    }
+
+    m_errors.append(QStringLiteral("took too long"));
+    finish_probe();
+}
+
+// Makes the notifiers match what m_arf waits for now.
+void AsyncProbe::watch()
+{
+    if(m_arf.msg_fd() != m_watched_msgfd) {
+        delete m_msgnotifier;
+        m_msgnotifier = NULL;
+        m_watched_msgfd = m_arf.msg_fd();
+
+        if(m_watched_msgfd >= 0) {
+            m_msgnotifier = new QSocketNotifier(m_watched_msgfd, QSocketNotifier::Read, this);
+            XCONNECT(m_msgnotifier, SIGNAL(activated(int)), this, SLOT(slot_fd_ready(int)));
+        }
+    }
+
+    if(m_arf.child_pid() != m_watched_pid) {
+        delete m_pidnotifier;
+        m_pidnotifier = NULL;
+
+        if(m_pidfd >= 0) {
+            ::close(m_pidfd);
+            m_pidfd = (-1);
+        }
+
+        m_watched_pid = m_arf.child_pid();
+
+        if(m_watched_pid > 0) {
+            m_pidfd = open_pidfd(m_watched_pid);
+
+            if(m_pidfd >= 0) {
+                m_pidnotifier = new QSocketNotifier(m_pidfd, QSocketNotifier::Read, this);
+                XCONNECT(m_pidnotifier, SIGNAL(activated(int)), this, SLOT(slot_fd_ready(int)));
+            }
+        }
+    }
+
+    if(m_watched_pid > 0 && m_pidfd < 0) {
+        m_childtimer.start(child_retry_ms);
+    }
+
+    if(m_arf.probe_job() != 0 && !m_watching_helper) {
+        XCONNECT(&ProbeHelper::instance(), SIGNAL(sig_replies()), this, SLOT(slot_step()), QUEUEDCONN);
+        m_watching_helper = true;
+    }
+}
+
+void AsyncProbe::unwatch()
+{
+    m_childtimer.stop();
+
+    delete m_msgnotifier;
+    m_msgnotifier = NULL;
+    m_watched_msgfd = (-1);
+
+    delete m_pidnotifier;
+    m_pidnotifier = NULL;
+    m_watched_pid = 0;
+
+    if(m_pidfd >= 0) {
+        ::close(m_pidfd);
+        m_pidfd = (-1);
+    }
+
+    if(m_watching_helper) {
+        ProbeHelper::instance().disconnect(this);
+        m_watching_helper = false;
+    }
+}
+
+void AsyncProbe::finish_probe()
+{
+    m_done = true;
+    m_elapsed_msec = m_clock.elapsed();
+    m_timeouttimer.stop();
+    // before m_arf closes the fds
+    unwatch();
+    m_arf.finish();
+
+    if(m_errors.isEmpty()) {
+        MYDBG("\"%s\": success in %ld msec", qPrintable(m_url), (long int)m_elapsed_msec);
+    }
+    else {
+        MYDBG("\"%s\": FAILURE %s", qPrintable(m_url), qPrintable(m_errors.join(QStringLiteral("; "))));
+    }
+
+    MYDBG("EMIT sig_done");
+    emit sig_done();
+}
@@ -0,0 +1,112 @@
+#ifndef ASYNCPROBE_H
+#define ASYNCPROBE_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include "asyncreadfile.h"
+
+class QSocketNotifier;
+
+// Runs an AsyncReadFile from the event loop: it is stepped when its
+// message pipe gets readable, when the reading child exits (seen through
+// a pidfd, or a short retry timer where there is none) or when the probe
+// helper has replies. sig_done() is emitted once, from the event loop,
+// when it is finished or took longer than timeout_msec.
+class AsyncProbe : public QObject
+{
+    Q_OBJECT
+public:
+    typedef QObject super;
+private:
+    QString m_url;
+    AsyncReadFile m_arf;
+    QStringList m_errors;
+    bool m_done;
+    QElapsedTimer m_clock;
+    // from the start to finishing, or till now
+    qint64 m_elapsed_msec;
+
+    // the fds the notifiers are for, they are closed by m_arf
+    int m_watched_msgfd;
+    QSocketNotifier *m_msgnotifier;
+    // the child the pidfd is for
+    pid_t m_watched_pid;
+    int m_pidfd;
+    QSocketNotifier *m_pidnotifier;
+    bool m_watching_helper;
+
+    // only used when there is no pidfd
+    QTimer m_childtimer;
+    QTimer m_timeouttimer;
+
+    // forbid
+    AsyncProbe();
+    AsyncProbe(const AsyncProbe &);
+    AsyncProbe &operator=(const AsyncProbe &in);
+
+public:
+    // reads maxreadsize bytes from offset on into the page cache, with
+    // getc also into contents()
+    AsyncProbe(QObject *parent, const QString &url, bool getc, off_t maxreadsize, qint64 timeout_msec, off_t offset = 0);
+    virtual ~AsyncProbe();
+
+    bool is_done() const
+    {
+        return m_done;
+    }
+    // empty if the file could be read
+    const QStringList &errors() const
+    {
+        return m_errors;
+    }
+    qint64 elapsed_msec() const
+    {
+        return (m_done ? m_elapsed_msec : m_clock.elapsed());
+    }
+    // of the whole file, -1 if not known
+    qint64 file_size() const
+    {
+        return m_arf.identity().size;
+    }
+    const FileIdentity &identity() const
+    {
+        return m_arf.identity();
+    }
+    // -1 if not known, and then also not whether it was cached
+    qint64 bytes_read() const
+    {
+        return m_arf.bytes_read();
+    }
+    bool was_cached() const
+    {
+        return m_arf.was_cached();
+    }
+    // with getc, when done without errors; may outlive this
+    QSharedPointer<MappedFileContents> contents() const
+    {
+        return m_arf.contents();
+    }
+
+signals:
+    void sig_done();
+
+public slots:
+    // internal, from the notifiers, the timers and the probe helper
+    void slot_step();
+    void slot_fd_ready(int fd);
+    void slot_timeout();
+
+protected:
+    virtual bool event(QEvent *event);
+
+private:
+    void watch();
+    void unwatch();
+    void finish_probe();
+};
+
+#endif // ASYNCPROBE_H
@@ -1,6 +1,4 @@
 #include <QFile>
-#include <QElapsedTimer>
-#include <QCoreApplication>
 #include <QFileInfo>
 
 #include <unistd.h>
@@ -8,6 +6,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <limits.h>
 #include <signal.h>
 #include <new>
 
@@ -15,6 +15,7 @@
 #include "asyncreadfile_child.h"
 #include "encoding.h"
 #include "asynckillproc.h"
+#include "probehelper.h"
 #include "util.h"
 
 #include <QLoggingCategory>
@@ -31,21 +32,67 @@ static_var const bool CLF_DEBUG_enabled = false;
 #define ASFMYDBG(msg, ...) do{if(CLF_DEBUG_enabled){fprintf(stderr, "CLF P  %s " msg "\n", qPrintable(m_ofn.right(20)), ##__VA_ARGS__);}}while(0)
 #define CLDMYDBG(msg, ...) do{if(CLF_DEBUG_enabled){fprintf(stderr, "CLF C  %s PID=%d " msg "\n", c_filename_short, getpid(), ##__VA_ARGS__);}}while(0)
 
-AsyncReadFile::AsyncReadFile(const QString &in_fn, bool in_getc, off_t in_maxreadsize):
+MappedFileContents::MappedFileContents()
+    : m_map(NULL)
+    , m_size(0)
+{
+}
+
+MappedFileContents::~MappedFileContents()
+{
+    if(m_map != NULL) {
+        ::munmap(m_map, size_t(m_size));
+    }
+}
+
+bool MappedFileContents::map(int memfd, QString *error)
+{
+    struct stat st;
+
+    if(::fstat(memfd, &st)) {
+        *error = QStringLiteral("could not stat content: ") + warn_xbin_2_local_qstring(strerror(errno));
+        return false;
+    }
+
+    if(qint64(st.st_size) > qint64(INT_MAX)) {
+        *error = QStringLiteral("content too big");
+        return false;
+    }
+
+    // nothing to map, bytes() is empty
+    if(st.st_size == 0) {
+        return true;
+    }
+
+    void *m = ::mmap(NULL, size_t(st.st_size), PROT_READ, MAP_SHARED, memfd, 0);
+
+    if(m == MAP_FAILED) {
+        *error = QStringLiteral("could not map content: ") + warn_xbin_2_local_qstring(strerror(errno));
+        return false;
+    }
+
+    m_map = m;
+    m_size = st.st_size;
+    return true;
+}
+
+AsyncReadFile::AsyncReadFile(const QString &in_fn, bool in_getc, off_t in_maxreadsize, off_t in_offset):
     m_ofn(in_fn)
     , m_getc(in_getc)
     , m_maxreadsize(in_maxreadsize)
+    , m_offset(in_offset)
+    , m_bytes_read(-1)
+    , m_was_cached(false)
     , c_filename(NULL)
     , m_done_pipefork(false)
+    , m_probejob(0)
     , m_msgfd(-1)
-    , m_contentfd(-1)
+    , m_contentmemfd(-1)
     , m_pid(0)
     , m_done(false)
     , errmsg_bufsize(16384)
     , fileread_bufsize(65536)
-    , pipe_bufsize(16384)
     , m_errmsg_buffer(NULL)
-    , m_content_buffer_pipe_from_child(NULL)
 {
 }
 
@@ -258,7 +305,26 @@ bool AsyncReadFile::xwaitpid(int &pid, QStringList *errors, bool *pgot_pid_chang
     return false;
 }
 
-bool AsyncReadFile::iter(QStringList *errors, QByteArray *acc_contents, bool *p_made_progress)
+// The child exited fine: its memfd holds the contents, sized to them.
+// They are mapped as they are, no copy into the heap.
+bool AsyncReadFile::take_contents(QStringList *errors)
+{
+    QSharedPointer<MappedFileContents> contents(new MappedFileContents());
+    QString maperr;
+
+    if(!contents->map(m_contentmemfd, &maperr)) {
+        errors->append(make_latin1_errmsg(0, "%s", qPrintable(maperr)));
+        (void)xclose(m_contentmemfd, "content");
+        return false;
+    }
+
+    ASFMYDBG("mapped %lld bytes of content", (long long)contents->size());
+    (void)xclose(m_contentmemfd, "content");
+    m_contents = contents;
+    return true;
+}
+
+bool AsyncReadFile::iter(QStringList *errors, bool *p_made_progress)
 {
     *p_made_progress = true;
 
@@ -283,17 +349,36 @@ bool AsyncReadFile::iter(QStringList *errors, QByteArray *acc_contents, bool *p_
 
     // ******** ITER 2
 
+    // only reading, no contents to pass back: the probe helper can do
+    // that, without forking us
+    if(!m_done_pipefork && !m_getc) {
+        QString helpererr;
+        m_probejob = ProbeHelper::instance().submit(QByteArray(c_filename), m_offset, m_maxreadsize, &helpererr);
+
+        if(m_probejob != 0) {
+            ASFMYDBG("handed to the probe helper as job %u", m_probejob);
+            m_done_pipefork = true;
+            return true;
+        }
+
+        MYDBG("probe helper not available, forking: %s", qPrintable(helpererr));
+    }
+
     if(!m_done_pipefork) {
 
         int fds_msg[2] = { -1, -1 };
-        int fds_content[2] = { -1, -1 };
 
         if(!xpipe2(fds_msg, "error message", errors)) {
             return false;
         }
 
         if(m_getc) {
-            if(!xpipe2(fds_content, "content", errors)) {
+            m_contentmemfd = ::memfd_create("AsyncReadFile", MFD_CLOEXEC);
+
+            if(m_contentmemfd < 0) {
+                errors->append(make_latin1_errmsg(errno, "could not memfd_create"));
+                (void)xclose(fds_msg[PIPE_READ], "error message");
+                (void)xclose(fds_msg[PIPE_WRITE], "error message");
                 return false;
             }
         }
@@ -322,20 +407,6 @@ bool AsyncReadFile::iter(QStringList *errors, QByteArray *acc_contents, bool *p_
 
             fds_msg[PIPE_READ] = (-1);
 
-            if(m_getc) {
-
-
-                if(::close(fds_content[PIPE_READ])) {
-                    CLDMYDBG("close(content FD=%d): %s", fds_content[PIPE_READ], strerror(errno));
-                }
-                else {
-                    CLDMYDBG("close(content FD=%d)", fds_content[PIPE_READ]);
-                }
-
-
-                fds_content[PIPE_READ] = (-1);
-            }
-
             FILE *msgfd_h = ::fdopen(fds_msg[PIPE_WRITE], "w");
 
             if(msgfd_h == NULL) {
@@ -346,8 +417,8 @@ bool AsyncReadFile::iter(QStringList *errors, QByteArray *acc_contents, bool *p_
                 ::_exit(1);
             }
 
-            // pipe write, file read
-            child_read_file(c_filename, c_filename_short, msgfd_h, fds_content[PIPE_WRITE], m_maxreadsize, pipe_bufsize, fileread_bufsize, CLF_DEBUG_enabled);
+            // memfd write, file read
+            child_read_file(c_filename, c_filename_short, msgfd_h, m_contentmemfd, m_offset, m_maxreadsize, fileread_bufsize, CLF_DEBUG_enabled);
             // should never return
         }
 
@@ -355,12 +426,7 @@ bool AsyncReadFile::iter(QStringList *errors, QByteArray *acc_contents, bool *p_
 
         (void)xclose(fds_msg[PIPE_WRITE], "error message");
 
-        if(m_getc) {
-            (void)xclose(fds_content[PIPE_WRITE], "content");
-        }
-
         m_msgfd = fds_msg[PIPE_READ];
-        m_contentfd = fds_content[PIPE_READ];
 
         m_done_pipefork = true;
         return true;
@@ -368,6 +434,24 @@ bool AsyncReadFile::iter(QStringList *errors, QByteArray *acc_contents, bool *p_
 
     // ******** ITER 3...
 
+    if(!m_done && m_probejob != 0) {
+        QString joberr;
+
+        if(!ProbeHelper::instance().poll(m_probejob, &joberr, &m_identity, &m_bytes_read, &m_was_cached, p_made_progress)) {
+            return true;
+        }
+
+        m_probejob = 0;
+        m_done = true;
+        *p_made_progress = true;
+
+        if(!joberr.isEmpty()) {
+            errors->append(make_latin1_errmsg(0, "%s", qPrintable(joberr)));
+        }
+
+        return false;
+    }
+
     if(!m_done) {
         bool got_errmsg_data = false;
 
@@ -389,32 +473,13 @@ bool AsyncReadFile::iter(QStringList *errors, QByteArray *acc_contents, bool *p_
 
         }
 
-        bool got_content_data = false;
-
-        if(m_contentfd >= 0 && m_getc) {
-
-            if(m_content_buffer_pipe_from_child == NULL) {
-                m_content_buffer_pipe_from_child = (char *)::malloc(pipe_bufsize);
-
-                if(m_content_buffer_pipe_from_child == NULL) {
-                    force_kill_child("no memory");
-                    errors->append(make_latin1_errmsg(0, "no memory"));
-                    return false;
-                }
-            }
-
-            if(!xread(m_contentfd, "content", m_content_buffer_pipe_from_child, pipe_bufsize, errors, acc_contents, &got_content_data)) {
-                return false;
-            }
-
-        }
-
-        *p_made_progress = (got_errmsg_data || got_content_data);
+        *p_made_progress = got_errmsg_data;
 
         // we only do this if there is a chance it will be interesting
-        if((m_msgfd < 0 && m_contentfd < 0) || (!*p_made_progress)) {
+        if(m_msgfd < 0 || (!*p_made_progress)) {
 
             bool got_pid_change = false;
+            const int errors_before = errors->size();
 
             if(!xwaitpid(m_pid, errors, &got_pid_change)) {
                 m_done = true;
@@ -425,10 +490,14 @@ bool AsyncReadFile::iter(QStringList *errors, QByteArray *acc_contents, bool *p_
                     m_acc_err.clear();
                 }
 
+                if(m_getc && got_pid_change && errors->size() == errors_before) {
+                    (void)take_contents(errors);
+                }
+
                 return false;
             }
 
-            *p_made_progress = (got_errmsg_data || got_content_data || got_pid_change);
+            *p_made_progress = (got_errmsg_data || got_pid_change);
         }
 
         return true;
@@ -457,9 +526,14 @@ void AsyncReadFile::finish()
         c_filename = NULL;
     }
 
+    if(m_probejob != 0) {
+        ProbeHelper::instance().abandon(m_probejob);
+        m_probejob = 0;
+    }
+
     (void)xclose(m_msgfd, "error message");
 
-    (void)xclose(m_contentfd, "content");
+    (void)xclose(m_contentmemfd, "content");
 
     force_kill_child("still alive");
 
@@ -468,11 +542,6 @@ void AsyncReadFile::finish()
         m_errmsg_buffer = NULL;
     }
 
-    if(m_content_buffer_pipe_from_child != NULL) {
-        ::free(m_content_buffer_pipe_from_child);
-        m_content_buffer_pipe_from_child = NULL;
-    }
-
     m_fn.clear();
     m_ofn.clear();
     m_acc_err.clear();
@@ -482,91 +551,3 @@ AsyncReadFile::~AsyncReadFile()
 {
     finish();
 }
-
-void async_slurp_file(const QString &url, QStringList &errors, QByteArray &contents, const qint64 wholetimeout_msec, const qint64 sleep_usec)
-{
-    MYDBG("async_slurp_file: %s, fail after %lu msec", qPrintable(url), (unsigned long)wholetimeout_msec);
-
-    AsyncReadFile ASF(url, true, -1);
-
-    QElapsedTimer timer;
-    timer.start();
-
-    bool made_progress;
-
-    while(ASF.iter(&errors, &contents, &made_progress)) {
-
-        const qint64 timepassed_msec = timer.elapsed();
-
-        if(timepassed_msec > wholetimeout_msec) {
-            errors.append(QStringLiteral("took too long"));
-            MYDBG("async_slurp_file: FAILURE %s", qPrintable(errors.join(QLatin1String("; "))));
-            return;
-        }
-
-        if(!made_progress) {
-            const qint64 time_still_allowed_msec = wholetimeout_msec - timepassed_msec;
-            const qint64 timetosleep_usec = qMin(sleep_usec, 1000 * time_still_allowed_msec);
-            ::usleep(timetosleep_usec);
-        }
-
-        QCoreApplication::processEvents();
-
-    }
-
-    if(errors.isEmpty()) {
-        MYDBG("async_slurp_file: success");
-    }
-    else {
-        MYDBG("async_slurp_file: FAILURE %s", qPrintable(errors.join(QLatin1String("; "))));
-    }
-
-}
-
-QString try_load_start_of_file(const QString &url, const off_t maxreadsize, const qint64 wholetimeout_msec, const qint64 sleep_usec)
-{
-
-    MYDBG("try_load_start_of_file: %s, read first %lu bytes, fail after %lu msec", qPrintable(url), (unsigned long)maxreadsize, (unsigned long)wholetimeout_msec);
-
-    QStringList errors;
-
-    AsyncReadFile ASF(url, false, maxreadsize);
-
-    QElapsedTimer timer;
-    timer.start();
-
-    bool made_progress;
-
-    while(ASF.iter(&errors, NULL, &made_progress)) {
-
-        const qint64 timepassed_msec = timer.elapsed();
-
-        if(timepassed_msec > wholetimeout_msec) {
-            errors.append(QStringLiteral("took too long"));
-            const QString ret = errors.join(QStringLiteral("; "));
-            MYDBG("try_load_start_of_file: FAILURE %s", qPrintable(ret));
-            return ret;
-        }
-
-        if(!made_progress) {
-            const qint64 time_still_allowed_msec = wholetimeout_msec - timepassed_msec;
-            const qint64 timetosleep_usec = qMin(sleep_usec, 1000 * time_still_allowed_msec);
-            ::usleep(timetosleep_usec);
-        }
-
-        QCoreApplication::processEvents();
-
-    }
-
-    const QString ret = errors.join(QStringLiteral("; "));
-
-    if(ret.isEmpty()) {
-        MYDBG("try_load_start_of_file: success");
-    }
-    else {
-        MYDBG("try_load_start_of_file: FAILURE %s", qPrintable(ret));
-    }
-
-    return ret;
-
-}
@@ -4,6 +4,37 @@
 #include <QString>
 #include <QByteArray>
 #include <QStringList>
+#include <QSharedPointer>
+
+#include "probecache.h"
+
+// What a reading child left in its memfd, mapped read-only. bytes() is
+// a QByteArray over the mapping, not a copy: it, and every copy of it
+// that was not modified, is only valid while this lives.
+class MappedFileContents
+{
+private:
+    void *m_map;
+    qint64 m_size;
+
+    // forbid
+    MappedFileContents(const MappedFileContents &);
+    MappedFileContents &operator=(const MappedFileContents &in);
+public:
+    MappedFileContents();
+    ~MappedFileContents();
+
+    // the fd can be closed afterwards
+    bool map(int memfd, QString *error);
+    qint64 size() const
+    {
+        return m_size;
+    }
+    QByteArray bytes() const
+    {
+        return QByteArray::fromRawData((char const *)m_map, int(m_size));
+    }
+};
 
 class AsyncReadFile
 {
@@ -12,20 +43,27 @@ private:
     QString m_fn;
     bool m_getc;
     off_t m_maxreadsize;
+    off_t m_offset;
+    // once the probe helper told
+    FileIdentity m_identity;
+    qint64 m_bytes_read;
+    bool m_was_cached;
     char *c_filename;
     QByteArray m_acc_err;
 
     bool m_done_pipefork;
+    // job of the ProbeHelper doing the reading instead of a child, 0 if none
+    unsigned m_probejob;
     int m_msgfd;
-    int m_contentfd;
+    // with getc, the child fills this memfd, mapped once it exited
+    int m_contentmemfd;
+    QSharedPointer<MappedFileContents> m_contents;
     pid_t m_pid;
 
     bool m_done;
     size_t errmsg_bufsize;
     size_t fileread_bufsize;
-    size_t pipe_bufsize;
     char *m_errmsg_buffer;
-    char *m_content_buffer_pipe_from_child;
 
 private:
 
@@ -35,15 +73,50 @@ private:
     bool xclose(int &fd, char const *const desc);
     bool xread(int &fd, char const *const desc, char *buffer, size_t bufsize, QStringList *errors, QByteArray *accumulator, bool *got_bytes);
     bool xwaitpid(int &pid, QStringList *errors, bool *pgot_pid_change);
+    bool take_contents(QStringList *errors);
 
 public:
-    AsyncReadFile(const QString &in_fn, bool in_getc, off_t in_maxreadsize);
+    // reads at most in_maxreadsize bytes (< 0: all) from in_offset on,
+    // with in_getc into contents(), otherwise only into the page cache
+    AsyncReadFile(const QString &in_fn, bool in_getc, off_t in_maxreadsize, off_t in_offset = 0);
     ~AsyncReadFile();
-    bool iter(QStringList *errors, QByteArray *contents, bool *p_made_progress);
+    bool iter(QStringList *errors, bool *p_made_progress);
     void finish();
-};
 
-void async_slurp_file(const QString &url, QStringList &errors, QByteArray &contents, const qint64 wholetimeout_msec, const qint64 sleep_usec);
-QString try_load_start_of_file(const QString &url, const off_t maxreadsize, const qint64 wholetimeout_msec, const qint64 sleep_usec);
+    // what iter() waits for, so it can be called when there is news
+    // (see AsyncProbe): -1/0 if nothing
+    int msg_fd() const
+    {
+        return m_msgfd;
+    }
+    pid_t child_pid() const
+    {
+        return m_pid;
+    }
+    unsigned probe_job() const
+    {
+        return m_probejob;
+    }
+    // only known when the probe helper did the reading
+    const FileIdentity &identity() const
+    {
+        return m_identity;
+    }
+    // of the file, also only from the probe helper, -1 if unknown
+    qint64 bytes_read() const
+    {
+        return m_bytes_read;
+    }
+    // all of bytes_read() was in the page cache already
+    bool was_cached() const
+    {
+        return m_was_cached;
+    }
+    // with getc, once iter() finished without errors
+    QSharedPointer<MappedFileContents> contents() const
+    {
+        return m_contents;
+    }
+};
 
 #endif // ASYNCREADFILE_H
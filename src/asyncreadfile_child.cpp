@@ -4,17 +4,15 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <signal.h>
-#include <sys/select.h>
-#include <sys/time.h>
+#include <sys/mman.h>
 
 #include "asyncreadfile_child.h"
+#include "pagecachewarmup.h"
 #include "util.h"
 
 #define CLDMYDBG(msg, ...) do{if(dodebug){fprintf(stderr, "CLF C  %s PID=%d " msg "\n", c_filename_short, getpid(), ##__VA_ARGS__);}}while(0)
 
 static_var const int sleep_if_read_not_ready_usec = 1000;
-static_var const int sleep_if_pipe_full_usec = 1000;
-static_var const int sleep_after_successful_write_usec = 0;
 
 template<typename T>
 static inline T MIN(const T a, const T b)
@@ -126,60 +124,74 @@ static int xopen(char const *const c_filename, FILE *errmsg_write_fh, char const
     return file_read_fd;
 }
 
-void child_read_file(char const *const c_filename, char const *const c_filename_short, FILE *errmsg_write_fh,  int file_write_fd, const off_t maxreadsize, const off_t pipe_write_blocksize, const off_t file_read_blocksize, bool dodebug)
+void child_read_file(char const *const c_filename, char const *const c_filename_short, FILE *errmsg_write_fh, int content_memfd, const off_t offset, const off_t maxreadsize, const off_t file_read_blocksize, bool dodebug)
 {
 
-    CLDMYDBG("hi from child. errmsg FD=%d, pipe FD=%d", fileno(errmsg_write_fh), file_write_fd);
+    CLDMYDBG("hi from child. errmsg FD=%d, content memfd FD=%d", fileno(errmsg_write_fh), content_memfd);
 
     int file_read_fd = xopen(c_filename, errmsg_write_fh, c_filename_short, dodebug);
 
     const off_t size = xfsize(file_read_fd, errmsg_write_fh, c_filename_short, dodebug);
 
-    const off_t toread = (maxreadsize < 0 ? size : (size > maxreadsize ? maxreadsize : size));
+    const off_t from = (offset > size ? size : offset);
+    const off_t left = size - from;
+    const off_t toread = (maxreadsize < 0 ? left : (left > maxreadsize ? maxreadsize : left));
 
-    if(maxreadsize < 0) {
-        if(file_write_fd >= 0) {
-            CLDMYDBG("read moviefile size: %lu bytes. Will try to read all of that, in %lu byte blocks, and transmit in %lu byte blocks", (unsigned long) size, (unsigned long) file_read_blocksize, (unsigned long) pipe_write_blocksize);
-        }
-        else {
-            CLDMYDBG("read moviefile size: %lu bytes. Will try to read all of that, in %lu byte blocks", (unsigned long) size, (unsigned long) file_read_blocksize);
-        }
+    CLDMYDBG("read moviefile size: %lu bytes. Will try to read %lu bytes of that from %lu on, in %lu byte blocks", (unsigned long) size, (long unsigned) toread, (unsigned long) from, (unsigned long) file_read_blocksize);
+
+    if(file_read_blocksize <= 0) {
+        PROGRAMMERERROR("file blocksize negative/0?");
     }
-    else {
-        if(file_write_fd >= 0) {
-            CLDMYDBG("read moviefile size: %lu bytes. Will try to read first %lu bytes of that, in %lu byte blocks, and transmit in %lu byte blocks", (unsigned long) size, (long unsigned) toread, (unsigned long) file_read_blocksize, (unsigned long) pipe_write_blocksize);
+
+    // nobody wants the contents: let the kernel fill the page cache, no copying
+    if(content_memfd < 0) {
+        bool unsupported = false;
+        PageCacheWarmupStats stats;
+        char errbuf[256] = "";
+
+        if(warm_page_cache(file_read_fd, from, toread, &unsupported, &stats, errbuf, sizeof(errbuf))) {
+            CLDMYDBG("warmed %lu bytes in %lld usec (%lld KB/s), slowest window %lld usec, %lu waits", (unsigned long)toread, stats.usecs, (stats.usecs > 0 ? (long long)toread * 1000 / 1024 * 1000 / stats.usecs : 0LL), stats.slowest_window_usecs, stats.waits);
+            xclose(file_read_fd, errmsg_write_fh, c_filename_short, dodebug);
+            childexit(true, errmsg_write_fh, c_filename_short, dodebug);
         }
-        else {
-            CLDMYDBG("read moviefile size: %lu bytes. Will try to read first %lu bytes of that, in %lu byte blocks", (unsigned long) size, (long unsigned) toread, (unsigned long) file_read_blocksize);
+
+        if(!unsupported) {
+            childerrfatal(errmsg_write_fh, c_filename_short, dodebug, "%s", errbuf);
         }
+
+        CLDMYDBG("cannot warm FD=%d without reading, reading", file_read_fd);
     }
 
-    if(file_read_blocksize <= 0) {
-        PROGRAMMERERROR("file blocksize negative/0?");
+    if(from > 0 && ::lseek(file_read_fd, from, SEEK_SET) != from) {
+        childerrfatal(errmsg_write_fh, c_filename_short, dodebug, "could not seek to byte %lu: %s", (unsigned long)from, strerror(errno));
     }
 
-    if(file_write_fd >= 0) {
-        if(pipe_write_blocksize <= 0) {
-            PROGRAMMERERROR("pipe blocksize negative/0?");
-        }
+    // the contents go straight into the memfd, sized once from the file
+    // size, and the parent maps it after we exited
+    char *content_map = NULL;
 
-        if(pipe_write_blocksize > file_read_blocksize) {
-            PROGRAMMERERROR("pipe blocksize needs to be smaller or equal to file blocksize");
+    if(content_memfd >= 0 && toread > 0) {
+        if(::ftruncate(content_memfd, toread)) {
+            childerrfatal(errmsg_write_fh, c_filename_short, dodebug, "could not size content memfd: %s", strerror(errno));
         }
 
-        {
-            const int file_to_pipe = file_read_blocksize / pipe_write_blocksize;
+        void *m = ::mmap(NULL, size_t(toread), PROT_READ | PROT_WRITE, MAP_SHARED, content_memfd, 0);
 
-            if(file_to_pipe * pipe_write_blocksize != file_read_blocksize) {
-                PROGRAMMERERROR("file blocksize needs to be a multiple of pipe blocksize");
-            }
+        if(m == MAP_FAILED) {
+            childerrfatal(errmsg_write_fh, c_filename_short, dodebug, "could not map content memfd: %s", strerror(errno));
         }
+
+        content_map = (char *)m;
     }
 
-    char *file_buffer = (char *)::malloc(file_read_blocksize);
+    char *file_buffer = NULL;
+
+    if(content_map == NULL) {
+        file_buffer = (char *)::malloc(file_read_blocksize);
 
-    if(file_buffer == NULL) {
-        childerrfatal(errmsg_write_fh, c_filename_short, dodebug, "no memory");
+        if(file_buffer == NULL) {
+            childerrfatal(errmsg_write_fh, c_filename_short, dodebug, "no memory");
+        }
     }
 
     size_t readiters = 0;
@@ -193,35 +205,8 @@ void child_read_file(char const *const c_filename, char const *const c_filename_
             break;
         }
 
-        // wait for data to be ready
-        {
-            int nfds = file_read_fd + 1;
-            fd_set readfds;
-            FD_ZERO(&readfds);
-            FD_SET(file_read_fd, &readfds);
-            struct timeval timeout;
-            timeout.tv_sec = 0;
-            timeout.tv_usec = sleep_if_read_not_ready_usec;
-            int selectret = select(nfds, &readfds, NULL, NULL, &timeout);
-
-            if(selectret < 0) {
-                childerrfatal(errmsg_write_fh, c_filename_short, dodebug, "error waiting for data: %s", strerror(errno));
-            }
-
-            if(selectret == 0) {
-                CLDMYDBG("data is not available on file FD=%d", file_read_fd);
-                //usleep_verboseonerr(sleep_if_read_not_ready_usec, c_filename_short, dodebug);
-                continue;
-            }
-
-            if(!FD_ISSET(file_read_fd, &readfds)) {
-                childerrfatal(errmsg_write_fh, c_filename_short, dodebug, "select returned but file FD is not set?");
-            }
-
-            CLDMYDBG("data is available on file FD=%d", file_read_fd);
-        }
-
-        ssize_t bytes_read = ::read(file_read_fd, file_buffer, file_read_blocksize);
+        char *const dst = (content_map != NULL ? content_map + pos : file_buffer);
+        ssize_t bytes_read = ::read(file_read_fd, dst, MIN((size_t)(toread - pos), (size_t)file_read_blocksize));
 
         readiters++;
 
@@ -230,7 +215,7 @@ void child_read_file(char const *const c_filename, char const *const c_filename_
                 childerrfatal(errmsg_write_fh, c_filename_short, dodebug, "error reading: %s", strerror(errno));
             }
 
-            // since we had a select before and the FD is blocking this should never happen
+            // a regular file never says so, other files might
             CLDMYDBG("wait on next data from file FD=%d to become available", file_read_fd);
             usleep_verboseonerr(sleep_if_read_not_ready_usec, c_filename_short, dodebug);
             continue;
@@ -248,81 +233,19 @@ void child_read_file(char const *const c_filename, char const *const c_filename_
 
         CLDMYDBG("read %lu bytes from file FD=%d", (unsigned long)bytes_read, file_read_fd);
 
-        if(file_write_fd >= 0) {
-
-            size_t bytes_written = 0;
-
-            while(bytes_written < (size_t)bytes_read) {
-                const size_t bytes_to_write = bytes_read - bytes_written;
-                const size_t bytes_to_write_at_once = MIN((size_t)bytes_to_write, (size_t)pipe_write_blocksize);
-
-                // wait for pipe to be ready
-                {
-                    int nfds = file_write_fd + 1;
-                    fd_set writefds;
-                    FD_ZERO(&writefds);
-                    FD_SET(file_write_fd, &writefds);
-                    struct timeval timeout;
-                    timeout.tv_sec = 0;
-                    timeout.tv_usec = sleep_if_pipe_full_usec;
-                    int selectret = select(nfds, NULL, &writefds, NULL, &timeout);
-
-                    if(selectret < 0) {
-                        childerrfatal(errmsg_write_fh, c_filename_short, dodebug, "error waiting for pipe to drain: %s", strerror(errno));
-                    }
-
-                    if(selectret == 0) {
-                        // since we did not give a timeout this should never happen....
-                        CLDMYDBG("data can not be written to pipe FD=%d", file_write_fd);
-                        //usleep_verboseonerr(sleep_if_pipe_full_usec, c_filename_short, dodebug);
-                        continue;
-                    }
-
-                    if(!FD_ISSET(file_write_fd, &writefds)) {
-                        childerrfatal(errmsg_write_fh, c_filename_short, dodebug, "select returned but file FD is not set?");
-                    }
-
-                    CLDMYDBG("data can be written to pipe FD=%d", file_write_fd);
-                }
-
-                CLDMYDBG("trying to write %lu bytes to FD=%d", (unsigned long)bytes_to_write_at_once, file_write_fd);
-                const ssize_t bw = write(file_write_fd, file_buffer + bytes_written, bytes_to_write_at_once);
-
-                if(bw < 0) {
-                    if(errno == EAGAIN || errno == EWOULDBLOCK) {
-                        // fine....
-                        CLDMYDBG("FD=%d not ready, weird", file_write_fd);
-
-                        // this should never happen since we used the select above
-                        usleep_verboseonerr(sleep_if_pipe_full_usec, c_filename_short, dodebug);
-                        continue;
-                    }
-
-                    childerrfatal(errmsg_write_fh, c_filename_short, dodebug, "error writing: %s", strerror(errno));
-                }
-                else if(bw == 0) {
-                    CLDMYDBG("write(FD=%d) returned 0?", file_write_fd);
-                    continue;
-                }
-                else {
-                    bytes_written += bw;
-
-                    // give other end time to react
-                    usleep_verboseonerr(sleep_after_successful_write_usec, c_filename_short, dodebug);
-                }
-
-            }
-
-        }
-
         // okay, we got some bytes, carrying on...
-        //CLDMYDBG("read %lu bytes from file", (unsigned long)bytes_read);
         pos += bytes_read;
 
     }
 
+    if(content_map != NULL) {
+        ::munmap(content_map, size_t(toread));
+    }
+
+    ::free(file_buffer);
+
     xclose(file_read_fd, errmsg_write_fh, c_filename_short, dodebug);
-    xclose(file_write_fd, errmsg_write_fh, c_filename_short, dodebug);
+    xclose(content_memfd, errmsg_write_fh, c_filename_short, dodebug);
 
     CLDMYDBG("successfully read %lu bytes, exiting", (unsigned long) toread);
     childexit(true, errmsg_write_fh, c_filename_short, dodebug);
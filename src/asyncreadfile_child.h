@@ -3,6 +3,8 @@
 
 #include <cstdio>
 
-void child_read_file(char const *const c_filename, char const *const c_filename_short, FILE *errmsg_write_fh,  int file_write_fd, const off_t maxreadsize, const off_t pipe_write_blocksize, const off_t file_read_blocksize, const bool dodebug);
+// reads at most maxreadsize bytes (< 0: all) from offset on, into the page
+// cache or, if content_memfd is not -1, into that memfd, sized to them
+void child_read_file(char const *const c_filename, char const *const c_filename_short, FILE *errmsg_write_fh, int content_memfd, const off_t offset, const off_t maxreadsize, const off_t file_read_blocksize, const bool dodebug);
 
 #endif // ASYNCREADFILECHILD_H
@@ -89,3 +89,35 @@ QString get_VDB_RUN()
 {
     return get_X("VDB_RUN", &cache_VDB_RUN, &mutex_VDB_RUN);
 }
+
+static_var QString cache_MP_PATH;
+static_var QMutex mutex_MP_PATH;
+
+QString get_MP_PATH()
+{
+    return get_X("MP_PATH", &cache_MP_PATH, &mutex_MP_PATH);
+}
+
+static_var QString cache_MP_TRACE;
+static_var QMutex mutex_MP_TRACE;
+
+QString get_MP_TRACE()
+{
+    return get_X("MP_TRACE", &cache_MP_TRACE, &mutex_MP_TRACE);
+}
+
+static_var QString cache_MP_PREFETCH_SECS;
+static_var QMutex mutex_MP_PREFETCH_SECS;
+
+QString get_MP_PREFETCH_SECS()
+{
+    return get_X("MP_PREFETCH_SECS", &cache_MP_PREFETCH_SECS, &mutex_MP_PREFETCH_SECS);
+}
+
+static_var QString cache_MP_PROBE_CACHE;
+static_var QMutex mutex_MP_PROBE_CACHE;
+
+QString get_MP_PROBE_CACHE()
+{
+    return get_X("MP_PROBE_CACHE", &cache_MP_PROBE_CACHE, &mutex_MP_PROBE_CACHE);
+}
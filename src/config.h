@@ -7,5 +7,9 @@ QString get_MP_VO();
 QString get_MP_OPTS_APPEND();
 QString get_MP_OPTS_OVERRIDE();
 QString get_VDB_RUN();
+QString get_MP_PATH();
+QString get_MP_TRACE();
+QString get_MP_PREFETCH_SECS();
+QString get_MP_PROBE_CACHE();
 
 #endif // MOVIES_CONFIG_H
@@ -7,7 +7,7 @@
 
 #include <sys/prctl.h>
 #include <string.h>
-#include <stdio.h>
+#include <unistd.h>
 
 #include <QLoggingCategory>
 #define THIS_SOURCE_FILE_LOG_CATEGORY "DSP"
@@ -39,6 +39,8 @@ DeathSigProcess::~DeathSigProcess()
 
 void DeathSigProcess::init(const QString &oName, QObject *parent)
 {
+    m_child_stdout_fd = (-1);
+    m_child_stderr_fd = (-1);
     setObjectName(oName);
     setParent(parent);
     qRegisterMetaType<QProcess::ProcessError>();
@@ -102,15 +104,40 @@ bool DeathSigProcess::event(QEvent *event)
 
     return super::event(event);
 }
+// between fork and exec, only async-signal-safe calls: the reader thread
+// can hold the malloc or stdio locks in the copy of the parent
+static void child_write_msg(char const *const msg)
+{
+    const ssize_t len = ssize_t(::strlen(msg));
+    ssize_t done = 0;
+
+    while(done < len) {
+        const ssize_t got = ::write(STDERR_FILENO, msg + done, size_t(len - done));
+
+        if(got <= 0) {
+            return;
+        }
+
+        done += got;
+    }
+}
+
 void DeathSigProcess::setupChildProcess()
 {
-    // int prctl(int option, unsigned long arg2, unsigned long arg3, unsigned long arg4, unsigned long arg5);
-    int ret = prctl(PR_SET_PDEATHSIG, 9);
+    // in the child, after QProcess set up its channels
+    if(m_child_stdout_fd >= 0 && ::dup2(m_child_stdout_fd, STDOUT_FILENO) < 0) {
+        child_write_msg(THIS_SOURCE_FILE_LOG_CATEGORY " child: could not dup2 the stdout pipe, exiting\n");
+        ::_exit(127);
+    }
 
-    if(ret == 0) {
-        fprintf(stderr, THIS_SOURCE_FILE_LOG_CATEGORY " %s %ld prctl(PR_SET_PDEATHSIG, 9) = success\n", qPrintable(objectName()), (long)(this->processId()));
+    if(m_child_stderr_fd >= 0 && ::dup2(m_child_stderr_fd, STDERR_FILENO) < 0) {
+        child_write_msg(THIS_SOURCE_FILE_LOG_CATEGORY " child: could not dup2 the stderr pipe, exiting\n");
+        ::_exit(127);
     }
-    else {
-        fprintf(stderr, THIS_SOURCE_FILE_LOG_CATEGORY " %s %ld prctl(PR_SET_PDEATHSIG, 9) = %d (%s)\n", qPrintable(objectName()), (long)(this->processId()), ret, strerror(errno));
+
+    // int prctl(int option, unsigned long arg2, unsigned long arg3, unsigned long arg4, unsigned long arg5);
+    if(::prctl(PR_SET_PDEATHSIG, 9) != 0) {
+        child_write_msg(THIS_SOURCE_FILE_LOG_CATEGORY " child: prctl(PR_SET_PDEATHSIG, 9) failed, exiting\n");
+        ::_exit(127);
     }
 }
@@ -9,6 +9,10 @@ class DeathSigProcess : public QProcess
 public:
     typedef QProcess super;
 private:
+    // dup2()ed onto the child's stdout / stderr if >= 0
+    int m_child_stdout_fd;
+    int m_child_stderr_fd;
+
     void init(const QString &oName, QObject *parent);
 
     // forbid
@@ -20,6 +24,14 @@ public:
     DeathSigProcess(char const *const oName_latin1, QObject *parent);
     DeathSigProcess(const QString &oName, QObject *parent);
     virtual ~DeathSigProcess();
+    // The child writes its output to these instead of QProcess's pipes.
+    // Set QProcess's own channels to QProcess::nullDevice(), nothing
+    // arrives there anymore.
+    void set_child_output_fds(int stdout_fd, int stderr_fd)
+    {
+        m_child_stdout_fd = stdout_fd;
+        m_child_stderr_fd = stderr_fd;
+    }
 protected:
     virtual bool event(QEvent *event);
     virtual void setupChildProcess();
@@ -2,11 +2,36 @@
 
 #include "util.h"
 
+#include <cstring>
+
 //#include <QLoggingCategory>
 //#define THIS_SOURCE_FILE_LOG_CATEGORY "ENC"
 //static Q_LOGGING_CATEGORY(category, THIS_SOURCE_FILE_LOG_CATEGORY)
 //#define MYDBG(msg, ...) qCDebug(category, msg, ##__VA_ARGS__)
 
+static bool is_ascii(char const *const blob, const size_t len)
+{
+    size_t i = 0;
+
+    // eight bytes at a time
+    for(; i + sizeof(quint64) <= len; i += sizeof(quint64)) {
+        quint64 w;
+        memcpy(&w, blob + i, sizeof(w));
+
+        if(w & Q_UINT64_C(0x8080808080808080)) {
+            return false;
+        }
+    }
+
+    for(; i < len; i++) {
+        if((unsigned char)(blob[i]) >= 0x80) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 QString xbin_2_codec_qstring(bool doerr, char const *const blob, const size_t len, QTextCodec const *const codec)
 {
     if(blob == NULL) {
@@ -18,7 +43,13 @@ QString xbin_2_codec_qstring(bool doerr, char const *const blob, const size_t le
     }
 
     if(codec == NULL) {
-        PROGRAMMERERROR("Blob-string \"%s\": no codec found?", blob);
+        PROGRAMMERERROR("Blob-string \"%.*s\": no codec found?", int(len), blob);
+    }
+
+    // we are only ever called with the locale codec or UTF-8, both ASCII
+    // compatible, so plain ASCII does not need a trip through the codec
+    if(is_ascii(blob, len)) {
+        return QString::fromLatin1(blob, int(len));
     }
 
     QTextCodec::ConverterState state;
@@ -26,20 +57,20 @@ QString xbin_2_codec_qstring(bool doerr, char const *const blob, const size_t le
 
     if(state.invalidChars > 0) {
         if(doerr) {
-            qFatal("Blob-string \"%s\" not a valid %s sequence.", blob, codec->name().constData());
+            qFatal("Blob-string \"%.*s\" not a valid %s sequence.", int(len), blob, codec->name().constData());
         }
         else {
-            qWarning("Blob-string \"%s\" not a valid %s sequence.", blob, codec->name().constData());
+            qWarning("Blob-string \"%.*s\" not a valid %s sequence.", int(len), blob, codec->name().constData());
         }
 
     }
 
     if(state.remainingChars > 0) {
         if(doerr) {
-            qFatal("Blob-string \"%s\" not a valid %s sequence.", blob, codec->name().constData());
+            qFatal("Blob-string \"%.*s\" not a valid %s sequence.", int(len), blob, codec->name().constData());
         }
         else {
-            qWarning("Blob-string \"%s\" not a valid %s sequence.", blob, codec->name().constData());
+            qWarning("Blob-string \"%.*s\" not a valid %s sequence.", int(len), blob, codec->name().constData());
         }
     }
 
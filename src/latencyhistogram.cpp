@@ -0,0 +1,124 @@
+#include "latencyhistogram.h"
+
+#include "util.h"
+
+// 2^sub_bucket_bits sub buckets per power of two
+static_var const int sub_bucket_bits = 3;
+static_var const int sub_buckets = (1 << sub_bucket_bits);
+// enough for any positive qint64
+static_var const int bucket_count = (63 - sub_bucket_bits + 1) * sub_buckets;
+
+int MyLatencyHistogram::bucket_of(qint64 usecs)
+{
+    if(usecs < sub_buckets) {
+        return int(usecs);
+    }
+
+    const int msb = 63 - __builtin_clzll((unsigned long long)usecs);
+    const int shift = msb - sub_bucket_bits;
+    return (shift + 1) * sub_buckets + int((usecs >> shift) & (sub_buckets - 1));
+}
+
+qint64 MyLatencyHistogram::bucket_upper(int idx)
+{
+    if(idx < sub_buckets) {
+        return idx;
+    }
+
+    const int shift = idx / sub_buckets - 1;
+    const qint64 sub = idx % sub_buckets;
+    const qint64 lower = (sub_buckets + sub) << shift;
+    return lower + (Q_INT64_C(1) << shift) - 1;
+}
+
+MyLatencyHistogram::MyLatencyHistogram()
+    : m_count(0)
+    , m_min_usecs(0)
+    , m_max_usecs(0)
+    , m_sum_usecs(0)
+{
+}
+
+void MyLatencyHistogram::clear()
+{
+    m_counts.fill(0);
+    m_count = 0;
+    m_min_usecs = 0;
+    m_max_usecs = 0;
+    m_sum_usecs = 0;
+}
+
+void MyLatencyHistogram::record_usecs(qint64 usecs)
+{
+    if(usecs < 0) {
+        PROGRAMMERERROR("negative latency %lld usecs", (long long)usecs);
+    }
+
+    if(m_counts.isEmpty()) {
+        m_counts.fill(0, bucket_count);
+    }
+
+    m_counts[bucket_of(usecs)]++;
+
+    if(m_count == 0 || usecs < m_min_usecs) {
+        m_min_usecs = usecs;
+    }
+
+    if(m_count == 0 || usecs > m_max_usecs) {
+        m_max_usecs = usecs;
+    }
+
+    m_count++;
+    m_sum_usecs += double(usecs);
+}
+
+double MyLatencyHistogram::mean_usecs() const
+{
+    if(m_count == 0) {
+        return 0.;
+    }
+
+    return m_sum_usecs / double(m_count);
+}
+
+qint64 MyLatencyHistogram::percentile_usecs(double pct) const
+{
+    if(m_count == 0) {
+        return 0;
+    }
+
+    quint64 wanted = quint64(double(m_count) * pct / 100. + 0.5);
+
+    if(wanted < 1) {
+        wanted = 1;
+    }
+
+    quint64 seen = 0;
+
+    for(int idx = 0; idx < m_counts.size(); idx++) {
+        seen += m_counts.at(idx);
+
+        if(seen >= wanted) {
+            const qint64 upper = bucket_upper(idx);
+            return (upper < m_max_usecs ? upper : m_max_usecs);
+        }
+    }
+
+    return m_max_usecs;
+}
+
+QString MyLatencyHistogram::summary() const
+{
+    if(m_count == 0) {
+        return QStringLiteral("n=0");
+    }
+
+    return QString(QStringLiteral("n=%1 min=%2 p50=%3 p90=%4 p99=%5 p99.9=%6 max=%7 ms"))
+           .arg(m_count)
+           .arg(double(m_min_usecs) / 1e3, 0, 'f', 1)
+           .arg(double(percentile_usecs(50)) / 1e3, 0, 'f', 1)
+           .arg(double(percentile_usecs(90)) / 1e3, 0, 'f', 1)
+           .arg(double(percentile_usecs(99)) / 1e3, 0, 'f', 1)
+           .arg(double(percentile_usecs(99.9)) / 1e3, 0, 'f', 1)
+           .arg(double(m_max_usecs) / 1e3, 0, 'f', 1);
+}
@@ -0,0 +1,56 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <QString>
+
+#include "monotime.h"
+
+// Counts latencies in logarithmic buckets, like HdrHistogram: every power
+// of two is split into 8 linear sub buckets, so any value is known to
+// within 12.5%, from microseconds to days, in a fixed 4k of counters.
+// Recording is a few shifts and an increment.
+class MyLatencyHistogram
+{
+private:
+    // allocated on the first record()
+    QVector<quint64> m_counts;
+    quint64 m_count;
+    qint64 m_min_usecs;
+    qint64 m_max_usecs;
+    double m_sum_usecs;
+
+    static int bucket_of(qint64 usecs);
+    static qint64 bucket_upper(int idx);
+public:
+    MyLatencyHistogram();
+
+    void record_usecs(qint64 usecs);
+    void record(const MonoTime &from, const MonoTime &to)
+    {
+        record_usecs((to.nsecs() - from.nsecs()) / 1000);
+    }
+    void clear();
+
+    quint64 count() const
+    {
+        return m_count;
+    }
+    qint64 min_usecs() const
+    {
+        return m_min_usecs;
+    }
+    qint64 max_usecs() const
+    {
+        return m_max_usecs;
+    }
+    double mean_usecs() const;
+    // pct in [0, 100]. The highest value of the bucket, but never above max.
+    qint64 percentile_usecs(double pct) const;
+
+    // "n=17 min=1.2 p50=3.1 p90=8.0 p99=12.5 p99.9=12.5 max=12.4 ms"
+    QString summary() const;
+};
+
+#endif // LATENCY_HISTOGRAM_H
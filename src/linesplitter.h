@@ -0,0 +1,168 @@
+#ifndef LINE_SPLITTER_H
+#define LINE_SPLITTER_H
+
+#include <QByteArray>
+#include <cstring>
+
+// Splits a byte stream into lines terminated by '\n' or '\r'.
+// The lines handed out by next_line() point into the internal buffer,
+// so they stay valid only until the next call to append() or clear().
+// Every byte is looked at once per terminator character, and consumed
+// bytes are only dropped once per append(), not once per line.
+class MyLineSplitter
+{
+private:
+    QByteArray m_buf;
+    // first byte not yet handed out
+    int m_cursor;
+    // next known '\n' / '\r' at or after m_cursor, -1 if none found yet
+    int m_pos_n;
+    int m_pos_r;
+    // no '\n' / '\r' between m_cursor and these
+    int m_scanned_n;
+    int m_scanned_r;
+
+    // throughput statistics
+    quint64 m_stat_bytes;
+    quint64 m_stat_lines;
+    qint64 m_stat_busy_nsecs;
+
+    // forbid
+    MyLineSplitter(const MyLineSplitter &);
+    MyLineSplitter &operator=(const MyLineSplitter &in);
+private:
+    int find_from(char c, int &pos, int &scanned) const
+    {
+        if(pos >= m_cursor) {
+            return pos;
+        }
+
+        const int from = (scanned > m_cursor ? scanned : m_cursor);
+        char const *const base = m_buf.constData();
+        void const *const hit = ::memchr(base + from, c, m_buf.size() - from);
+
+        if(hit == NULL) {
+            pos = (-1);
+            scanned = m_buf.size();
+            return (-1);
+        }
+
+        pos = (char const *)hit - base;
+        scanned = pos;
+        return pos;
+    }
+    void compact()
+    {
+        if(m_cursor <= 0) {
+            return;
+        }
+
+        // capacity is reserved, so neither of these gives the memory back
+        if(m_cursor >= m_buf.size()) {
+            m_buf.resize(0);
+        }
+        else {
+            m_buf.remove(0, m_cursor);
+        }
+
+        m_pos_n = (m_pos_n >= m_cursor ? m_pos_n - m_cursor : (-1));
+        m_pos_r = (m_pos_r >= m_cursor ? m_pos_r - m_cursor : (-1));
+        m_scanned_n = (m_scanned_n > m_cursor ? m_scanned_n - m_cursor : 0);
+        m_scanned_r = (m_scanned_r > m_cursor ? m_scanned_r - m_cursor : 0);
+        m_cursor = 0;
+    }
+public:
+    explicit MyLineSplitter(int initial_capacity = 65536)
+        : m_cursor(0)
+        , m_pos_n(-1)
+        , m_pos_r(-1)
+        , m_scanned_n(0)
+        , m_scanned_r(0)
+        , m_stat_bytes(0)
+        , m_stat_lines(0)
+        , m_stat_busy_nsecs(0)
+    {
+        m_buf.reserve(initial_capacity);
+    }
+    void clear()
+    {
+        m_buf.resize(0);
+        m_cursor = 0;
+        m_pos_n = (-1);
+        m_pos_r = (-1);
+        m_scanned_n = 0;
+        m_scanned_r = 0;
+    }
+    void append(const QByteArray &bytes)
+    {
+        compact();
+        m_buf.append(bytes);
+        m_stat_bytes += bytes.size();
+    }
+    bool has_partial_line() const
+    {
+        return m_cursor < m_buf.size();
+    }
+    // returns false if there is no complete line left
+    // the line is returned without its terminator and might be empty
+    bool next_line(char const **pline, int *plen)
+    {
+        const int idxn = find_from('\n', m_pos_n, m_scanned_n);
+        const int idxr = find_from('\r', m_pos_r, m_scanned_r);
+
+        int idx;
+
+        if(idxn < 0 && idxr < 0) {
+            return false;
+        }
+        else if(idxn < 0) {
+            idx = idxr;
+        }
+        else if(idxr < 0) {
+            idx = idxn;
+        }
+        else {
+            idx = (idxr < idxn ? idxr : idxn);
+        }
+
+        *pline = m_buf.constData() + m_cursor;
+        *plen = idx - m_cursor;
+        m_cursor = idx + 1;
+        m_stat_lines++;
+        return true;
+    }
+    void add_busy_nsecs(qint64 nsecs)
+    {
+        m_stat_busy_nsecs += nsecs;
+    }
+    quint64 stat_bytes() const
+    {
+        return m_stat_bytes;
+    }
+    quint64 stat_lines() const
+    {
+        return m_stat_lines;
+    }
+    qint64 stat_busy_nsecs() const
+    {
+        return m_stat_busy_nsecs;
+    }
+    double stat_bytes_per_sec() const
+    {
+        if(m_stat_busy_nsecs <= 0) {
+            return 0.;
+        }
+
+        return double(m_stat_bytes) * 1e9 / double(m_stat_busy_nsecs);
+    }
+    double stat_lines_per_sec() const
+    {
+        if(m_stat_busy_nsecs <= 0) {
+            return 0.;
+        }
+
+        return double(m_stat_lines) * 1e9 / double(m_stat_busy_nsecs);
+    }
+};
+
+#endif // LINE_SPLITTER_H
@@ -13,11 +13,13 @@
 
 #include "mpwidget.h"
 #include "cropdetector.h"
+#include "nextitempreparer.h"
 #include "gui_overlayquit.h"
 #include "safe_signals.h"
 #include "config.h"
 #include "system.h"
 #include "remote_local.h"
+#include "mountthroughput.h"
 #include "event_desc.h"
 
 #include <QLoggingCategory>
@@ -33,9 +35,6 @@ const double MIN_LASTPOS_DIFF_ABS_SECONDS = 300.;
 // 4.5% = 4 minutes on a 90 minutes movie
 const double MIN_LASTPOS_DIFF_REL_PERCENT = 4.5;
 
-static const unsigned CACHE_KBYTES_FOR_LOCAL   =  8192;
-static const unsigned CACHE_KBYTES_FOR_REMOTE  = 32768;
-
 void PlayerWindow::slot_MP_died(QObject *dead)
 {
     if(dead == (QObject *)MP) {
@@ -43,17 +42,9 @@ void PlayerWindow::slot_MP_died(QObject *dead)
     }
 }
 
-void PlayerWindow::init_MP_object()
+// the cache as planned by plan_reading()
+QStringList PlayerWindow::make_MP_args(const ReadPlan &plan) const
 {
-
-    if(MP != NULL) {
-        MP->deleteLater();
-        MP = NULL;
-    }
-
-    MP = new MpWidget(this, fullscreen);
-    XCONNECT(MP, SIGNAL(destroyed(QObject *)), this, SLOT(slot_MP_died(QObject *)));
-
     QStringList MP_args_default;
     MP_args_default += QLatin1String("-osdlevel");
     MP_args_default += QLatin1String("1");
@@ -71,9 +62,9 @@ void PlayerWindow::init_MP_object()
     MP_args_default += QLatin1String("-framedrop");
 
     MP_args_default += QLatin1String("-cache");
-    MP_args_default += QString::number(might_get_remote_files ? CACHE_KBYTES_FOR_REMOTE : CACHE_KBYTES_FOR_LOCAL);
+    MP_args_default += QString::number(plan.cache_kbytes);
     MP_args_default += QLatin1String("-cache-min");
-    MP_args_default += QLatin1String("20");
+    MP_args_default += QString::number(plan.cache_min_percent);
 
     MP_args_default += QLatin1String("-mc");
     MP_args_default += QLatin1String("3");
@@ -97,7 +88,37 @@ void PlayerWindow::init_MP_object()
         MP_args += l;
     }
 
-    MP->setMplayerArgs(MP_args);
+    return MP_args;
+}
+
+void PlayerWindow::init_MP_object()
+{
+
+    if(MP != NULL) {
+        MP->deleteLater();
+        MP = NULL;
+    }
+
+    MP = new MpWidget(this, fullscreen);
+    XCONNECT(MP, SIGNAL(destroyed(QObject *)), this, SLOT(slot_MP_died(QObject *)));
+
+    // the bitrate of the first file is not known yet
+    const ReadPlan plan = plan_reading(mfns.isEmpty() ? QString() : mfns.first(), 0, might_get_remote_files);
+    MP->setMplayerArgs(make_MP_args(plan));
+    MP_cache_kbytes = plan.cache_kbytes;
+    MP_cache_min_percent = plan.cache_min_percent;
+
+    const QString MP_PATH_s = get_MP_PATH();
+
+    if(!MP_PATH_s.isEmpty()) {
+        MP->setMPlayerPath(MP_PATH_s);
+    }
+
+    const QString MP_TRACE_s = get_MP_TRACE();
+
+    if(!MP_TRACE_s.isEmpty()) {
+        MP->setMPlayerTraceFile(MP_TRACE_s);
+    }
 
     MP->setVideoOutput(compute_MP_VO());
 
@@ -138,9 +159,12 @@ PlayerWindow::PlayerWindow(bool in_fullscreen
     , fullscreen(in_fullscreen)
     , MP(NULL)
     , cd(NULL)
+    , prep(NULL)
     , falangs(in_falangs)
     , palangs(in_palangs)
     , pslangs(in_pslangs)
+    , MP_cache_kbytes(0)
+    , MP_cache_min_percent(0)
 {
     setObjectName(QLatin1String("PlayerWindow"));
 
@@ -172,7 +196,6 @@ PlayerWindow::PlayerWindow(bool in_fullscreen
     }
 
     might_get_remote_files = false;
-
     foreach(const QString &mfn, mfns) {
         if(path_is_definitely_remote(mfn.toLocal8Bit().constData())) {
             might_get_remote_files = true;
@@ -323,8 +346,8 @@ void PlayerWindow::slot_MP_error_while(QString reason, QString url, MpMediaInfo
 {
 
     if(!url.isEmpty()) {
-        qWarning("IV: MP error received: \"%s\", reloading again \"%s\" at %f", qPrintable(reason), qPrintable(url), lastpos);
-        MP->load(url, mmi, lastpos);
+        qWarning("IV: MP error received: \"%s\", resuming \"%s\" at %f", qPrintable(reason), qPrintable(url), lastpos);
+        MP->resume(url, mmi, lastpos);
     }
     else {
         qWarning("IV: MP error received: \"%s\"", qPrintable(reason));
@@ -352,6 +375,7 @@ void PlayerWindow::slot_MP_state_changed(MpState oldstate, MpState newstate)
 
         case MpState::PlayingState:
             MP_window_correct();
+            prepare_next();
             break;
 
         case MpState::BufferingState:
@@ -416,11 +440,25 @@ void PlayerWindow::slot_MP_start()
 
     const QString absfn = mfns.takeFirst();
 
+    NextItemPreparer *prepared = prep;
+    prep = NULL;
+
+    if(prepared != NULL && (prepared->mfn() != absfn || !prepared->is_done() || !prepared->warmup_error().isEmpty())) {
+        MYDBG("\"%s\" is not prepared, loading it the slow way", qPrintable(absfn));
+        prepared->deleteLater();
+        prepared = NULL;
+    }
+
     QFileInfo qfi(absfn);
 
     setWindowTitle(qfi.fileName());
 
     MpMediaInfo mmi;
+
+    if(prepared != NULL) {
+        mmi = prepared->mediainfo();
+    }
+
     mmi.set_seekable(true);
     // FIXME get deinterlace from command line or something
 
@@ -428,21 +466,59 @@ void PlayerWindow::slot_MP_start()
 
     const QByteArray bcropstring = qgetenv("CROP");
 
-    if(bcropstring.isEmpty()) {
-        if(cd != NULL) {
-            delete cd;
-            cd = NULL;
-        }
+    if(cd != NULL) {
+        delete cd;
+        cd = NULL;
+    }
 
+    if(!bcropstring.isEmpty()) {
+        QString scropstring = QString::fromLocal8Bit(bcropstring.constData());
+        mmi.set_crop(scropstring);
+    }
+    else if(prepared != NULL) {
+        MYDBG("\"%s\" is prepared, crop \"%s\"", qPrintable(absfn), qPrintable(prepared->crop()));
+
+        if(!prepared->crop().isEmpty()) {
+            mmi.set_crop(prepared->crop());
+        }
+    }
+    else {
         cd = new CropDetector(this, absfn);
         XCONNECT(cd, SIGNAL(sig_detected(bool, QString, QString)), this, SLOT(slot_cdDetected(bool, QString, QString)), QUEUEDCONN);
     }
+
+    // -identify of a prepared file told the bitrate, otherwise it is 0.
+    // mplayer only takes the cache settings on its command line
+    {
+        const ReadPlan plan = plan_reading(absfn, mmi.total_bitrate(), might_get_remote_files);
+
+        if(plan.cache_kbytes != MP_cache_kbytes || plan.cache_min_percent != MP_cache_min_percent) {
+            MYDBG("\"%s\" wants %u KBytes of cache, %u%% before playing, mplayer has %u, %u%%, restarting it", qPrintable(absfn), plan.cache_kbytes, plan.cache_min_percent, MP_cache_kbytes, MP_cache_min_percent);
+            MP->setMplayerArgs(make_MP_args(plan));
+            MP_cache_kbytes = plan.cache_kbytes;
+            MP_cache_min_percent = plan.cache_min_percent;
+            MP->restart_process();
+        }
+    }
+
+    if(prepared != NULL) {
+        MP->load_prepared(absfn, mmi);
+        prepared->deleteLater();
+        prepared = NULL;
+    }
     else {
-        QString scropstring = QString::fromLocal8Bit(bcropstring.constData());
-        mmi.set_crop(scropstring);
+        MP->load(absfn, mmi);
     }
 
-    MP->load(absfn, mmi);
     MP_window_correct();
 }
 
+void PlayerWindow::prepare_next()
+{
+    if(prep != NULL || mfns.isEmpty() || MP == NULL) {
+        return;
+    }
+
+    prep = new NextItemPreparer(this, mfns.first(), MP->mplayerPath(), qgetenv("CROP").isEmpty());
+}
+
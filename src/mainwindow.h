@@ -15,6 +15,8 @@ QT_END_NAMESPACE
 
 class MpWidget;
 class CropDetector;
+class NextItemPreparer;
+struct ReadPlan;
 
 class PlayerWindow : public QMainWindow
 {
@@ -28,11 +30,16 @@ private:
     bool fullscreen;
     MpWidget *MP;
     CropDetector *cd;
+    // gets mfns.first() ready while the current file plays
+    NextItemPreparer *prep;
     QString currently_playing_mfn;
     QStringList falangs;
     QStringList palangs;
     QStringList pslangs;
     bool might_get_remote_files;
+    // -cache and -cache-min of the running mplayer
+    unsigned MP_cache_kbytes;
+    unsigned MP_cache_min_percent;
 private:
     // forbid
     PlayerWindow();
@@ -65,7 +72,9 @@ private:
     void init_MP_vars();
     void MP_finished(bool success, const QString &errstr = QString());
     void MP_window_correct();
+    QStringList make_MP_args(const ReadPlan &plan) const;
     void init_MP_object();
+    void prepare_next();
 
 };
 
@@ -0,0 +1,59 @@
+#include "monotime.h"
+
+#include "util.h"
+
+#include <QAtomicPointer>
+
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+
+// read by the MpPipeReader thread too, while set_clock() may run
+static_var QAtomicPointer<const MonoClock> monoclock;
+
+static qint64 clock_monotonic_nsecs()
+{
+    struct timespec ts;
+
+    if(0 != clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        PROGRAMMERERROR("clock_gettime(CLOCK_MONOTONIC): %s", strerror(errno));
+    }
+
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+MonoTime MonoTime::now()
+{
+    MonoClock const *const clock = monoclock.loadAcquire();
+
+    if(clock != NULL) {
+        return MonoTime(clock->now_nsecs());
+    }
+
+    return MonoTime(clock_monotonic_nsecs());
+}
+
+void MonoTime::set_clock(MonoClock const *clock)
+{
+    monoclock.storeRelease(clock);
+}
+
+QDateTime MonoTime::toDateTime() const
+{
+    if(isNull()) {
+        return QDateTime();
+    }
+
+    const MonoTime mnow = now();
+    const QDateTime wnow = QDateTime::currentDateTimeUtc();
+    return wnow.addMSecs(mnow.msecsTo(*this));
+}
+
+QString MonoTime::toHuman() const
+{
+    if(isNull()) {
+        return QStringLiteral("never");
+    }
+
+    return toDateTime().toLocalTime().toString(QStringLiteral("hh:mm:ss.zzz"));
+}
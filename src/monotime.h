@@ -0,0 +1,117 @@
+#ifndef MONOTIME_H
+#define MONOTIME_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QDateTime>
+
+// Where MonoTime::now() gets its ticks from. The default reads
+// CLOCK_MONOTONIC; tests can install their own clock and step it.
+class MonoClock
+{
+public:
+    virtual ~MonoClock() {}
+    virtual qint64 now_nsecs() const = 0;
+};
+
+// a clock that only moves when told to
+class MonoVirtualClock : public MonoClock
+{
+private:
+    qint64 m_nsecs;
+    // forbid
+    MonoVirtualClock(const MonoVirtualClock &);
+    MonoVirtualClock &operator=(const MonoVirtualClock &in);
+public:
+    explicit MonoVirtualClock(qint64 start_nsecs = 0)
+        : m_nsecs(start_nsecs)
+    {
+    }
+    virtual qint64 now_nsecs() const
+    {
+        return m_nsecs;
+    }
+    void advance_msecs(qint64 msecs)
+    {
+        m_nsecs += msecs * 1000000;
+    }
+    void advance_nsecs(qint64 nsecs)
+    {
+        m_nsecs += nsecs;
+    }
+};
+
+// A point in time on a monotonic nanosecond clock. Cheap to get, copy and
+// compare, and does not jump with the wall clock. Default constructed
+// values are null, like QDateTime().
+class MonoTime
+{
+private:
+    qint64 m_nsecs;
+
+    static const qint64 null_nsecs = Q_INT64_C(-9223372036854775807) - 1;
+
+    explicit MonoTime(qint64 nsecs)
+        : m_nsecs(nsecs)
+    {
+    }
+public:
+    MonoTime()
+        : m_nsecs(null_nsecs)
+    {
+    }
+
+    static MonoTime now();
+    // NULL goes back to CLOCK_MONOTONIC. The clock is not owned, and has to
+    // stay alive while any thread may still call now().
+    static void set_clock(MonoClock const *clock);
+
+    bool isNull() const
+    {
+        return m_nsecs == null_nsecs;
+    }
+    qint64 nsecs() const
+    {
+        return m_nsecs;
+    }
+    qint64 msecsTo(const MonoTime &other) const
+    {
+        return (other.m_nsecs - m_nsecs) / 1000000;
+    }
+    MonoTime addMSecs(qint64 msecs) const
+    {
+        return MonoTime(m_nsecs + msecs * 1000000);
+    }
+
+    bool operator==(const MonoTime &o) const
+    {
+        return m_nsecs == o.m_nsecs;
+    }
+    bool operator!=(const MonoTime &o) const
+    {
+        return m_nsecs != o.m_nsecs;
+    }
+    bool operator<(const MonoTime &o) const
+    {
+        return m_nsecs < o.m_nsecs;
+    }
+    bool operator>(const MonoTime &o) const
+    {
+        return m_nsecs > o.m_nsecs;
+    }
+    bool operator<=(const MonoTime &o) const
+    {
+        return m_nsecs <= o.m_nsecs;
+    }
+    bool operator>=(const MonoTime &o) const
+    {
+        return m_nsecs >= o.m_nsecs;
+    }
+
+    // wall clock time this probably was, only for humans
+    QDateTime toDateTime() const;
+    // "hh:mm:ss.zzz" local time
+    QString toHuman() const;
+};
+
+#endif // MONOTIME_H
@@ -0,0 +1,279 @@
+#include "mountthroughput.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QUrl>
+#include <QtMath>
+
+#include "util.h"
+
+#include <QLoggingCategory>
+#define THIS_SOURCE_FILE_LOG_CATEGORY "MNTT"
+static Q_LOGGING_CATEGORY(category, THIS_SOURCE_FILE_LOG_CATEGORY)
+#define MYDBG(msg, ...) qCDebug(category, msg, ##__VA_ARGS__)
+
+// mplayer cache when the bitrate or the mount is not known
+static_var const unsigned cache_kbytes_for_local = 8192;
+static_var const unsigned cache_kbytes_for_remote = 32768;
+static_var const unsigned cache_min_percent_default = 20;
+// never less or more cache than that
+static_var const unsigned cache_kbytes_min = 4096;
+static_var const unsigned cache_kbytes_max = 131072;
+
+// the probe before a load reads that much, and fails below that speed
+// when the bitrate is not known
+static_var const qint64 sustain_bytes_default = 16 * 1024 * 1024;
+static_var const double sustain_min_kBps_default = 3000;
+// on a mount that is known to be much faster than needed, only that much
+static_var const qint64 sustain_bytes_small = 4 * 1024 * 1024;
+// needs at least 4 times the bitrate, on a bad day, for the small probe
+static_var const double sustain_small_if_headroom = 4.;
+// with a known bitrate, fail below that multiple of it, but not below the floor
+static_var const double sustain_bitrate_margin = 2.;
+static_var const double sustain_min_kBps_floor = 256;
+
+// how much a new sample counts, against the ones before
+static_var const double ewma_weight = 0.25;
+// trust the history only with that many samples
+static_var const int samples_needed = 3;
+
+static QString unescape_mountinfo(const QByteArray &in)
+{
+    // spaces and such are written as \040
+    QByteArray out;
+    out.reserve(in.size());
+
+    for(int i = 0; i < in.size(); i++) {
+        if(in.at(i) == '\\' && i + 3 < in.size() && in.at(i + 1) >= '0' && in.at(i + 1) <= '7') {
+            out.append(char(((in.at(i + 1) - '0') << 6) | ((in.at(i + 2) - '0') << 3) | (in.at(i + 3) - '0')));
+            i += 3;
+        }
+        else {
+            out.append(in.at(i));
+        }
+    }
+
+    return QString::fromLocal8Bit(out);
+}
+
+// "source on mountpoint" of the mount path is on, empty if not found
+static QString mount_key_for(const QString &in_path)
+{
+    // the mount points are without symlinks, a symlinked library has to be too
+    QString path = in_path;
+
+    if(!in_path.isEmpty()) {
+        const QFileInfo fi(in_path);
+        path = fi.canonicalFilePath();
+
+        if(path.isEmpty()) {
+            path = fi.absoluteFilePath();
+        }
+    }
+
+    QFile f(QStringLiteral("/proc/self/mountinfo"));
+
+    if(!f.open(QIODevice::ReadOnly)) {
+        MYDBG("could not open /proc/self/mountinfo");
+        return QString();
+    }
+
+    QString best_mountpoint;
+    QString best_source;
+
+    // 36 35 98:0 /mnt1 /mnt/parent rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+    foreach(const QByteArray &line, f.readAll().split('\n')) {
+        const QList<QByteArray> fields = line.split(' ');
+        const int sep = fields.indexOf("-");
+
+        if(fields.size() < 5 || sep < 0 || sep + 2 >= fields.size()) {
+            continue;
+        }
+
+        const QString mountpoint = unescape_mountinfo(fields.at(4));
+
+        // a later mount on the same point hides the earlier one
+        if(mountpoint.size() < best_mountpoint.size()) {
+            continue;
+        }
+
+        if(mountpoint != QLatin1String("/") && path != mountpoint && !path.startsWith(mountpoint + QLatin1Char('/'))) {
+            continue;
+        }
+
+        best_mountpoint = mountpoint;
+        best_source = unescape_mountinfo(fields.at(sep + 2));
+    }
+
+    if(best_mountpoint.isEmpty()) {
+        return QString();
+    }
+
+    return best_source + QStringLiteral(" on ") + best_mountpoint;
+}
+
+// the settings group of the mount, empty if not found
+static QString settings_group_for(const QString &path)
+{
+    const QString key = mount_key_for(path);
+
+    if(key.isEmpty()) {
+        return QString();
+    }
+
+    // '/' would make subgroups
+    return QStringLiteral("mount_throughput/") + QString::fromLatin1(QUrl::toPercentEncoding(key));
+}
+
+MountThroughput mount_throughput_for(const QString &path)
+{
+    MountThroughput ret;
+    ret.samples = 0;
+    ret.latency_ms = (-1);
+    ret.kBps = 0;
+    ret.kBps_stddev = 0;
+
+    const QString group = settings_group_for(path);
+
+    if(group.isEmpty()) {
+        return ret;
+    }
+
+    QSettings settings;
+    settings.beginGroup(group);
+    ret.samples = settings.value(QStringLiteral("samples"), 0).toInt();
+    ret.latency_ms = settings.value(QStringLiteral("latency_ms"), -1.).toDouble();
+    ret.kBps = settings.value(QStringLiteral("kBps"), 0.).toDouble();
+    ret.kBps_stddev = qSqrt(qMax(0., settings.value(QStringLiteral("kBps_var"), 0.).toDouble()));
+    settings.endGroup();
+
+    return ret;
+}
+
+void mount_throughput_record_latency(const QString &path, bool from_page_cache, qint64 msec)
+{
+    if(from_page_cache) {
+        MYDBG("%s: %ld msec, from the page cache, ignored", qPrintable(path), (long int)msec);
+        return;
+    }
+
+    const QString group = settings_group_for(path);
+
+    if(group.isEmpty()) {
+        return;
+    }
+
+    QSettings settings;
+    settings.beginGroup(group);
+    const double old = settings.value(QStringLiteral("latency_ms"), -1.).toDouble();
+    const double now = (old < 0 ? double(msec) : old + ewma_weight * (double(msec) - old));
+    settings.setValue(QStringLiteral("latency_ms"), now);
+    settings.endGroup();
+
+    MYDBG("%s: latency %ld msec, now %f", qPrintable(group), (long int)msec, now);
+}
+
+void mount_throughput_record_speed(const QString &path, qint64 bytes, bool from_page_cache, qint64 msec)
+{
+    if(from_page_cache) {
+        MYDBG("%s: %ld bytes in %ld msec, from the page cache, ignored", qPrintable(path), (long int)bytes, (long int)msec);
+        return;
+    }
+
+    if(bytes <= 0 || msec <= 0) {
+        MYDBG("%s: %ld bytes in %ld msec, nothing to go by", qPrintable(path), (long int)bytes, (long int)msec);
+        return;
+    }
+
+    const QString group = settings_group_for(path);
+
+    if(group.isEmpty()) {
+        return;
+    }
+
+    const double sample = (double(bytes) / 1024.) * 1000. / double(msec);
+
+    QSettings settings;
+    settings.beginGroup(group);
+    const int samples = settings.value(QStringLiteral("samples"), 0).toInt();
+    double mean = settings.value(QStringLiteral("kBps"), 0.).toDouble();
+    double var = settings.value(QStringLiteral("kBps_var"), 0.).toDouble();
+
+    if(samples <= 0) {
+        mean = sample;
+        var = 0;
+    }
+    else {
+        const double diff = sample - mean;
+        mean += ewma_weight * diff;
+        var = (1. - ewma_weight) * (var + ewma_weight * diff * diff);
+    }
+
+    settings.setValue(QStringLiteral("samples"), samples + 1);
+    settings.setValue(QStringLiteral("kBps"), mean);
+    settings.setValue(QStringLiteral("kBps_var"), var);
+    settings.endGroup();
+
+    MYDBG("%s: %f kB/s, now %f +- %f kB/s over %d samples", qPrintable(group), sample, mean, qSqrt(var), samples + 1);
+}
+
+static unsigned round_up_to_power_of_2(unsigned v)
+{
+    unsigned ret = 1;
+
+    while(ret < v && ret < 0x80000000u) {
+        ret <<= 1;
+    }
+
+    return ret;
+}
+
+ReadPlan plan_reading(const QString &path, double bitrate_bps, bool remote)
+{
+    ReadPlan plan;
+    plan.cache_kbytes = (remote ? cache_kbytes_for_remote : cache_kbytes_for_local);
+    plan.cache_min_percent = cache_min_percent_default;
+    plan.sustain_bytes = sustain_bytes_default;
+
+    const double bitrate_kBps = bitrate_bps / 8. / 1024.;
+    const double need_kBps = (bitrate_kBps > 0 ? qMax(sustain_min_kBps_floor, sustain_bitrate_margin * bitrate_kBps) : sustain_min_kBps_default);
+
+    const MountThroughput mt = (path.isEmpty() ? MountThroughput() : mount_throughput_for(path));
+    const bool known = (!path.isEmpty() && mt.samples >= samples_needed && mt.kBps > 0);
+    // what the mount delivers on a bad day
+    const double worst_kBps = (known ? qMax(1., mt.kBps - 2. * mt.kBps_stddev) : 0.);
+
+    if(known && worst_kBps >= sustain_small_if_headroom * need_kBps) {
+        plan.sustain_bytes = sustain_bytes_small;
+    }
+
+    plan.sustain_timeout_msec = qint64((double(plan.sustain_bytes) / 1024.) * 1000. / need_kBps);
+
+    if(!path.isEmpty() && mt.latency_ms > 0) {
+        plan.sustain_timeout_msec += qint64(2. * mt.latency_ms);
+    }
+
+    if(known && bitrate_kBps > 0) {
+        // the closer the mount is to the bitrate, the more to buffer, and
+        // the fuller before playing
+        const double headroom = worst_kBps / bitrate_kBps;
+        double secs = 90;
+        plan.cache_min_percent = 50;
+
+        if(headroom >= 4.) {
+            secs = 10;
+            plan.cache_min_percent = 5;
+        }
+        else if(headroom >= 2.) {
+            secs = 30;
+            plan.cache_min_percent = cache_min_percent_default;
+        }
+
+        const unsigned want = unsigned(qMin(double(cache_kbytes_max), bitrate_kBps * secs));
+        plan.cache_kbytes = qBound(cache_kbytes_min, round_up_to_power_of_2(want), cache_kbytes_max);
+    }
+
+    MYDBG("plan for %s at %f kB/s: cache %u KB, min %u%%, probe %ld bytes in %ld msec", qPrintable(path), bitrate_kBps, plan.cache_kbytes, plan.cache_min_percent, (long int)plan.sustain_bytes, (long int)plan.sustain_timeout_msec);
+    return plan;
+}
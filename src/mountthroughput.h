@@ -0,0 +1,41 @@
+#ifndef MOUNTTHROUGHPUT_H
+#define MOUNTTHROUGHPUT_H
+
+#include <QString>
+
+// What the probes measured on the mount a file is on, kept across runs in
+// the settings. Mounts are told apart by source and mount point, as found
+// in /proc/self/mountinfo, so looking one up does not touch the file.
+struct MountThroughput {
+    // number of throughput samples, 0 if nothing is known
+    int samples;
+    // time to the first bytes, < 0 if unknown
+    double latency_ms;
+    // sustained reading speed, averaged over the recent samples
+    double kBps;
+    double kBps_stddev;
+};
+
+MountThroughput mount_throughput_for(const QString &path);
+// The probes tell from_page_cache if all they read was cached already,
+// that says nothing about the mount and is ignored.
+// from the probe that reads the first few KB
+void mount_throughput_record_latency(const QString &path, bool from_page_cache, qint64 msec);
+// from a probe that read a good chunk, bytes < 0 if it does not know how much
+void mount_throughput_record_speed(const QString &path, qint64 bytes, bool from_page_cache, qint64 msec);
+
+// How to read a file, from its bitrate and what is known about its mount.
+struct ReadPlan {
+    // mplayer -cache and -cache-min
+    unsigned cache_kbytes;
+    unsigned cache_min_percent;
+    // the probe before a load reads that much, and fails if it takes longer
+    qint64 sustain_bytes;
+    qint64 sustain_timeout_msec;
+};
+
+// bitrate_bps: of all streams, 0 if unknown
+// remote: only decides the cache size when nothing better is known
+ReadPlan plan_reading(const QString &path, double bitrate_bps, bool remote);
+
+#endif // MOUNTTHROUGHPUT_H
@@ -0,0 +1,327 @@
+#include "mplinedispatch.h"
+
+#include <cstring>
+#include <cstddef>
+
+struct MpLinePrefix {
+    char const *text;
+    int len;
+    MpLineKind kind;
+    // the whole line has to match, not just the start
+    bool exact;
+};
+
+#define MPLP(lit, kind, exact) { lit, int(sizeof(lit) - 1), MpLineKind::kind, exact }
+#define MPLP_END { NULL, 0, MpLineKind::Unknown, false }
+
+// Warning: first match wins. Within one table the order is the one
+// MpProcess::parseLine used to test them in.
+static_var const MpLinePrefix prefixes_C[] = {
+    MPLP("Cache fill:", Ignored, false),
+    MPLP("CPLAYER: Starting playback...", StartingPlayback, false),
+    MPLP_END
+};
+static_var const MpLinePrefix prefixes_D[] = {
+    // this can also happen if the cache is empty
+    MPLP("DEMUXER: ds_fill_buffer: EOF reached (stream: video)", Ignored, false),
+    MPLP_END
+};
+static_var const MpLinePrefix prefixes_E[] = {
+    MPLP("Exiting...", Exiting, false),
+    MPLP_END
+};
+static_var const MpLinePrefix prefixes_F[] = {
+    MPLP("File not found: ", FileNotFound, false),
+    MPLP("FATAL: Could not initialize video filters (-vf) or video output (-vo)", FatalVoInit, false),
+    MPLP("Fontconfig warning:", Ignored, false),
+    MPLP_END
+};
+static_var const MpLinePrefix prefixes_G[] = {
+    MPLP("GLOBAL: ANS_pause=no", AnsPauseNo, true),
+    MPLP("GLOBAL: ANS_pause=yes", AnsPauseYes, true),
+    MPLP("GLOBAL: ANS_mute=no", AnsMuteNo, true),
+    MPLP("GLOBAL: ANS_mute=yes", AnsMuteYes, true),
+    MPLP("GLOBAL: ANS_switch_audio=", AnsSwitchAudio, false),
+    MPLP("GLOBAL: ANS_speed=", AnsSpeed, false),
+    MPLP("GLOBAL: ANS_time_pos=", AnsTimePos, false),
+    MPLP("GLOBAL: ANS_TIME_POSITION=", AnsTimePosition, false),
+    MPLP("GLOBAL: EOF code:", EofCode, false),
+    MPLP("GLOBAL: ANS_metadata=", AnsMetadata, false),
+    MPLP_END
+};
+static_var const MpLinePrefix prefixes_I[] = {
+    MPLP("IDENTIFY: ID_SIGNAL", IdSignal, false),
+    MPLP("IDENTIFY: ID_EXIT", IdExit, false),
+    MPLP("IDENTIFY: ID_", Identify, false),
+    MPLP_END
+};
+static_var const MpLinePrefix prefixes_P[] = {
+    MPLP("Playing ", Ignored, false),
+    MPLP_END
+};
+static_var const MpLinePrefix prefixes_S[] = {
+    MPLP("STATUSLINE: A:", StatusLine, false),
+    MPLP("STATUSLINE: V:", StatusLine, false),
+    MPLP_END
+};
+
+#undef MPLP
+#undef MPLP_END
+
+static MpLinePrefix const *prefixes_for_first_byte(char c)
+{
+    switch(c) {
+        case 'C':
+            return prefixes_C;
+
+        case 'D':
+            return prefixes_D;
+
+        case 'E':
+            return prefixes_E;
+
+        case 'F':
+            return prefixes_F;
+
+        case 'G':
+            return prefixes_G;
+
+        case 'I':
+            return prefixes_I;
+
+        case 'P':
+            return prefixes_P;
+
+        case 'S':
+            return prefixes_S;
+
+        default:
+            return NULL;
+    }
+}
+
+static bool is_ascii_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+MpLineView mpline_trimmed(const MpLineView &in)
+{
+    MpLineView ret = in;
+
+    while(ret.len > 0 && is_ascii_space(ret.data[0])) {
+        ret.data++;
+        ret.len--;
+    }
+
+    while(ret.len > 0 && is_ascii_space(ret.data[ret.len - 1])) {
+        ret.len--;
+    }
+
+    return ret;
+}
+
+static bool ends_with(const MpLineView &line, char const *const latin1lit)
+{
+    const int l = ::strlen(latin1lit);
+
+    if(line.len < l) {
+        return false;
+    }
+
+    return 0 == ::memcmp(line.data + line.len - l, latin1lit, l);
+}
+
+bool mpline_contains(const MpLineView &line, char const *const latin1lit)
+{
+    return NULL != ::memmem(line.data, line.len, latin1lit, ::strlen(latin1lit));
+}
+
+MpLineKind mpline_classify(const MpLineView &tline, MpLineView *pvalue)
+{
+    pvalue->data = tline.data + tline.len;
+    pvalue->len = 0;
+
+    if(tline.len < 1) {
+        return MpLineKind::Unknown;
+    }
+
+    // mplayer appends it to whatever it printed last, e.g. a STATUSLINE
+    // without a newline, so it goes before the prefixes
+    if(ends_with(tline, "IDENTIFY: ID_PAUSED")) {
+        return MpLineKind::IdPaused;
+    }
+
+    MpLinePrefix const *p = prefixes_for_first_byte(tline.data[0]);
+
+    if(p != NULL) {
+        for(; p->text != NULL; p++) {
+            if(tline.len < p->len) {
+                continue;
+            }
+
+            if(p->exact && tline.len != p->len) {
+                continue;
+            }
+
+            if(0 != ::memcmp(tline.data, p->text, p->len)) {
+                continue;
+            }
+
+            pvalue->data = tline.data + p->len;
+            pvalue->len = tline.len - p->len;
+            return p->kind;
+        }
+    }
+
+    // can be anywhere in the line, only applies if no prefix matched
+    if(mpline_contains(tline, "No stream found")) {
+        return MpLineKind::NoStreamFound;
+    }
+
+    return MpLineKind::Unknown;
+}
+
+bool mpline_to_int(const MpLineView &v, int *pret)
+{
+    int i = 0;
+    bool neg = false;
+
+    if(i < v.len && (v.data[i] == '-' || v.data[i] == '+')) {
+        neg = (v.data[i] == '-');
+        i++;
+    }
+
+    if(i >= v.len) {
+        return false;
+    }
+
+    long long acc = 0;
+
+    for(; i < v.len; i++) {
+        const char c = v.data[i];
+
+        if(c < '0' || c > '9') {
+            return false;
+        }
+
+        acc = acc * 10 + (c - '0');
+
+        if(acc > 2147483648LL) {
+            return false;
+        }
+    }
+
+    if(neg) {
+        acc = -acc;
+    }
+
+    if(acc > 2147483647LL) {
+        return false;
+    }
+
+    *pret = int(acc);
+    return true;
+}
+
+static_var const double pow10_table[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// mplayer prints plain "%f" style numbers. Up to 19 significant digits
+// and 22 fractional digits the result is the correctly rounded value.
+bool mpline_to_double(const MpLineView &v, double *pret)
+{
+    int i = 0;
+    bool neg = false;
+
+    if(i < v.len && (v.data[i] == '-' || v.data[i] == '+')) {
+        neg = (v.data[i] == '-');
+        i++;
+    }
+
+    unsigned long long mantissa = 0;
+    int ndigits = 0;
+    int nfrac = 0;
+    bool seen_dot = false;
+    bool seen_digit = false;
+
+    for(; i < v.len; i++) {
+        const char c = v.data[i];
+
+        if(c == '.' && !seen_dot) {
+            seen_dot = true;
+            continue;
+        }
+
+        if(c < '0' || c > '9') {
+            break;
+        }
+
+        seen_digit = true;
+
+        if(ndigits >= 19) {
+            // ignore digits we can not represent anyway
+            if(!seen_dot) {
+                return false;
+            }
+
+            continue;
+        }
+
+        mantissa = mantissa * 10 + (c - '0');
+
+        if(mantissa != 0) {
+            ndigits++;
+        }
+
+        if(seen_dot) {
+            nfrac++;
+        }
+    }
+
+    if(!seen_digit) {
+        return false;
+    }
+
+    if(i < v.len) {
+        // we do not expect exponents, but accept them
+        if(v.data[i] != 'e' && v.data[i] != 'E') {
+            return false;
+        }
+
+        MpLineView ev;
+        ev.data = v.data + i + 1;
+        ev.len = v.len - i - 1;
+        int e;
+
+        if(!mpline_to_int(ev, &e)) {
+            return false;
+        }
+
+        nfrac -= e;
+    }
+
+    double ret = double(mantissa);
+
+    if(nfrac > 0) {
+        while(nfrac > 22) {
+            ret /= 1e22;
+            nfrac -= 22;
+        }
+
+        ret /= pow10_table[nfrac];
+    }
+    else if(nfrac < 0) {
+        while(nfrac < -22) {
+            ret *= 1e22;
+            nfrac += 22;
+        }
+
+        ret *= pow10_table[-nfrac];
+    }
+
+    *pret = (neg ? -ret : ret);
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef MPLINEDISPATCH_H
+#define MPLINEDISPATCH_H
+
+// a piece of mplayer output, pointing into someone else's buffer
+struct MpLineView {
+    char const *data;
+    int len;
+};
+
+// what MpProcess::parseLine has to do with a line
+enum class MpLineKind {
+    Unknown,
+    Ignored,
+    AnsPauseNo,
+    AnsPauseYes,
+    AnsMuteNo,
+    AnsMuteYes,
+    AnsSwitchAudio,
+    AnsSpeed,
+    AnsTimePos,
+    AnsTimePosition,
+    AnsMetadata,
+    StartingPlayback,
+    FileNotFound,
+    IdPaused,
+    IdSignal,
+    IdExit,
+    Identify,
+    FatalVoInit,
+    NoStreamFound,
+    StatusLine,
+    Exiting,
+    EofCode
+};
+
+// strips leading and trailing ASCII whitespace
+MpLineView mpline_trimmed(const MpLineView &in);
+
+// Classifies a trimmed line on its raw bytes. Lines are dispatched on their
+// first byte, then compared against a handful of prefixes. *pvalue is set to
+// the part of the line after the matched prefix. A line ending in
+// "IDENTIFY: ID_PAUSED" is IdPaused whatever it starts with.
+MpLineKind mpline_classify(const MpLineView &tline, MpLineView *pvalue);
+
+bool mpline_contains(const MpLineView &line, char const *const latin1lit);
+
+// locale independent, the whole view has to be a number
+bool mpline_to_int(const MpLineView &v, int *pret);
+bool mpline_to_double(const MpLineView &v, double *pret);
+
+#endif // MPLINEDISPATCH_H
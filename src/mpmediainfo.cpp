@@ -2,6 +2,8 @@
 
 #include "vregularexpression.h"
 
+#include <QStringList>
+
 #include <QLoggingCategory>
 #define THIS_SOURCE_FILE_LOG_CATEGORY "MPM"
 static Q_LOGGING_CATEGORY(category, THIS_SOURCE_FILE_LOG_CATEGORY)
@@ -95,6 +97,29 @@ double MpMediaInfo::DAR() const
     return ret;
 }
 
+static int QSToInt(const QString &s)
+{
+    bool ok = false;
+    int ret = s.toInt(&ok);
+
+    if(ok == false) {
+        PROGRAMMERERROR("could not convert \"%s\" to int", qPrintable(s));
+    }
+
+    return ret;
+}
+static double QSToDouble(const QString &s)
+{
+    bool ok = false;
+    double ret = s.toDouble(&ok);
+
+    if(ok == false) {
+        PROGRAMMERERROR("could not convert \"%s\" to double", qPrintable(s));
+    }
+
+    return ret;
+}
+
 static unsigned QSToUInt(const QString &s)
 {
     bool ok = false;
@@ -184,3 +209,140 @@ void  MpMediaInfo::set_crop(const QRect &rect)
     // FIXME this is a bit of a fudge...
     mc_crop.force_set(rect);
 }
+
+// Parses one line of MPlayer's -identify output
+void MpMediaInfo::parse_identify(const QString &tline, QString *pcurrenttag)
+{
+    QString key;
+    QString value;
+
+    if(split_identify(tline, &key, &value)) {
+        apply_identify(key, value, pcurrenttag);
+    }
+}
+
+bool MpMediaInfo::split_identify(const QString &tline, QString *pkey, QString *pvalue)
+{
+    QString line = tline.trimmed();
+    line.remove(QLatin1String("IDENTIFY:"));
+    line = line.trimmed();
+
+    const QStringList info = line.split(QLatin1Char('='));
+
+    if(info.count() < 2) {
+        return false;
+    }
+
+    *pkey = info[0];
+    *pvalue = info[1];
+    return true;
+}
+
+void MpMediaInfo::apply_identify(const QString &key, const QString &value, QString *pcurrenttag)
+{
+    static_var const VRegularExpression rx_alang("^ID_AID_(\\d+)_LANG$");
+    static_var const VRegularExpression rx_slang("^ID_SID_(\\d+)_LANG$");
+
+    QRegularExpressionMatch rxmatch;
+
+    if(key == QLatin1String("ID_VIDEO_FORMAT")) {
+        set_videoFormat(value);
+    }
+    else if(key == QLatin1String("ID_VIDEO_BITRATE")) {
+        set_videoBitrate(QSToInt(value));
+    }
+    else if(key == QLatin1String("ID_VIDEO_WIDTH")) {
+        set_width(QSToInt(value));
+    }
+    else if(key == QLatin1String("ID_VIDEO_HEIGHT")) {
+        set_height(QSToInt(value));
+    }
+    else if(key == QLatin1String("ID_VIDEO_FPS")) {
+        set_framesPerSecond(QSToDouble(value));
+
+    }
+    else if(key == QLatin1String("ID_AUDIO_FORMAT")) {
+        // this can still be output when switching tracks
+        if(!is_finalized()) {
+            set_audioFormat(value);
+        }
+    }
+    else if(key == QLatin1String("ID_AUDIO_BITRATE")) {
+        // this can still be output when switching tracks
+        if(!is_finalized()) {
+            set_audioBitrate(QSToInt(value));
+        }
+    }
+    else if(key == QLatin1String("ID_AUDIO_RATE")) {
+        // this can still be output when switching tracks
+        if(!is_finalized()) {
+            set_sampleRate(QSToInt(value));
+        }
+    }
+    else if(key == QLatin1String("ID_AUDIO_NCH")) {
+        // this can still be output when switching tracks
+        if(!is_finalized()) {
+            set_numChannels(QSToInt(value));
+        }
+
+    }
+    else if(key == QLatin1String("ID_LENGTH")) {
+        set_length(QSToDouble(value));
+    }
+    else if(key == QLatin1String("ID_SEEKABLE")) {
+        set_seekable((bool)QSToInt(value));
+    }
+    else if(key.startsWith(QLatin1String("ID_CLIP_INFO_NAME"))) {
+        (*pcurrenttag) = value;
+    }
+    else if(key.startsWith(QLatin1String("ID_CLIP_INFO_VALUE")) && !(*pcurrenttag).isEmpty()) {
+        add_tag((*pcurrenttag), value);
+    }
+    else if(key.startsWith(QLatin1String("ID_CHAPTER"))) {
+        add_tag((*pcurrenttag), value);
+    }
+    else if(key.indexOf(rx_alang, 0, &rxmatch) >= 0) {
+        const QString &aid = rxmatch.captured(1);
+        const QString &alang = value;
+        add_alang(QSToInt(aid), alang);
+    }
+    else if(key.indexOf(rx_slang, 0, &rxmatch) >= 0) {
+        const QString &sid = rxmatch.captured(1);
+        const QString &slang = value;
+        add_slang(QSToInt(sid), slang);
+    }
+    else if(key == QLatin1String("ID_START_TIME")) {
+    }
+    else if(key == QLatin1String("ID_DEMUXER")) {
+    }
+    else if(key == QLatin1String("ID_VIDEO_ASPECT")) {
+        QString sDAR = value;
+        double DAR = QSToDouble(sDAR);
+
+        if(DAR < 0.001 || DAR > 100) {
+            MPMMYDBG("ignoring bad DAR %s", qPrintable(value));
+        }
+        else {
+            set_DAR(DAR);
+        }
+    }
+    else if(key == QLatin1String("ID_VIDEO_ID")) {
+    }
+    else if(key == QLatin1String("ID_VIDEO_CODEC")) {
+    }
+    else if(key == QLatin1String("ID_AUDIO_CODEC")) {
+    }
+    else if(key == QLatin1String("ID_AUDIO_TRACK")) {
+    }
+    else if(key == QLatin1String("ID_AUDIO_ID")) {
+    }
+    else if(key == QLatin1String("ID_SUBTITLE_ID")) {
+    }
+    else if(key == QLatin1String("ID_CLIP_INFO_N")) {
+    }
+    else if(key == QLatin1String("ID_FILENAME")) {
+    }
+    else {
+        MPMMYDBG("unknown mediainfo %s=%s", qPrintable(key), qPrintable(value));
+    }
+}
@@ -232,6 +232,21 @@ public:
     {
         mc_videoBitrate.set(b);
     }
+    // ID_VIDEO_BITRATE + ID_AUDIO_BITRATE in bits/sec, 0 if mplayer did not say
+    double total_bitrate() const
+    {
+        double ret = 0;
+
+        if(mc_videoBitrate.isset()) {
+            ret += mc_videoBitrate.get();
+        }
+
+        if(mc_audioBitrate.isset()) {
+            ret += mc_audioBitrate.get();
+        }
+
+        return ret;
+    }
     void set_size(const QSize &s)
     {
         mc_width.set(s.width());
@@ -313,6 +328,13 @@ public:
         mc_numChannels.set(i);
     }
 
+    // *pcurrenttag carries ID_CLIP_INFO_NAME over to the next line
+    void parse_identify(const QString &line, QString *pcurrenttag);
+    // parse_identify() in two steps. The split touches nothing but its
+    // arguments, so it can run on another thread, see MpPipeReader.
+    // false if the line is no ID_...=value
+    static bool split_identify(const QString &line, QString *pkey, QString *pvalue);
+    void apply_identify(const QString &key, const QString &value, QString *pcurrenttag);
     void set_crop(const QString &str);
     void set_crop(const QRect &rect);
 
@@ -0,0 +1,200 @@
+#include "mpmetrics.h"
+
+#include "util.h"
+#include "mpnoiseclassifier.h"
+#include "safe_signals.h"
+
+#include <QList>
+#include <QSocketNotifier>
+#include <QCoreApplication>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <string.h>
+
+// every live MpMetrics, GUI thread only
+static_var QList<MpMetrics *> all_metrics;
+// the signal handler writes here
+static_var int dump_pipe_write_fd = (-1);
+
+static_var char const *const parse_category_names[MpMetrics::ParseCategoryCount] = {
+    "STATUSLINE",
+    "IDENTIFY",
+    "GLOBAL ANS_",
+    "noise",
+    "other",
+    "position"
+};
+
+char const *MpMetrics::parse_category_name(ParseCategory cat)
+{
+    return parse_category_names[cat];
+}
+
+MpMetrics::MpMetrics(const QString &name)
+    : m_name(name)
+{
+    memset(parse, 0, sizeof(parse));
+    all_metrics.append(this);
+}
+
+MpMetrics::ParseCategory MpMetrics::parse_category_of(MpLineKind kind, unsigned noise)
+{
+    switch(kind) {
+        case MpLineKind::StatusLine:
+            return ParseStatusline;
+
+        case MpLineKind::Identify:
+        case MpLineKind::IdPaused:
+        case MpLineKind::IdSignal:
+        case MpLineKind::IdExit:
+            return ParseIdentify;
+
+        case MpLineKind::AnsPauseNo:
+        case MpLineKind::AnsPauseYes:
+        case MpLineKind::AnsMuteNo:
+        case MpLineKind::AnsMuteYes:
+        case MpLineKind::AnsSwitchAudio:
+        case MpLineKind::AnsSpeed:
+        case MpLineKind::AnsTimePos:
+        case MpLineKind::AnsTimePosition:
+        case MpLineKind::AnsMetadata:
+            return ParseAnswer;
+
+        default:
+            break;
+    }
+
+    return (noise != MpNoiseNone ? ParseNoise : ParseOther);
+}
+
+MpMetrics::~MpMetrics()
+{
+    all_metrics.removeAll(this);
+}
+
+void MpMetrics::clear()
+{
+    queue_wait.clear();
+    reply.clear();
+    write_to_read.clear();
+
+    for(unsigned idx = 0; idx < MpState_maxidx; idx++) {
+        read_gap[idx].clear();
+    }
+
+    seek_to_position.clear();
+    memset(parse, 0, sizeof(parse));
+}
+
+QString MpMetrics::report() const
+{
+    QStringList lines;
+
+    if(queue_wait.count() > 0) {
+        lines += QStringLiteral("queue wait: ") + queue_wait.summary();
+    }
+
+    for(QMap<QByteArray, MyLatencyHistogram>::const_iterator it = reply.constBegin(); it != reply.constEnd(); ++it) {
+        lines += QStringLiteral("reply ") + QLatin1String(it.key()) + QStringLiteral(": ") + it.value().summary();
+    }
+
+    if(write_to_read.count() > 0) {
+        lines += QStringLiteral("write to read: ") + write_to_read.summary();
+    }
+
+    for(unsigned idx = 0; idx < MpState_maxidx; idx++) {
+        if(read_gap[idx].count() > 0) {
+            lines += QStringLiteral("read gap ") + QLatin1String(convert_MpStateidx_2_asciidesc(idx)) + QStringLiteral(": ") + read_gap[idx].summary();
+        }
+    }
+
+    if(seek_to_position.count() > 0) {
+        lines += QStringLiteral("seek to position: ") + seek_to_position.summary();
+    }
+
+    for(int cat = 0; cat < ParseCategoryCount; cat++) {
+        const MpParseCounter &pc = parse[cat];
+
+        if(pc.lines == 0) {
+            continue;
+        }
+
+        const double ns_per_line = double(pc.nsecs) / double(pc.lines);
+        const double lines_per_sec = (pc.nsecs > 0 ? double(pc.lines) * 1e9 / double(pc.nsecs) : 0.);
+        lines += QString(QStringLiteral("parse %1: %2 lines, %3 bytes, %4 ns/line, %5 lines/sec"))
+                 .arg(QLatin1String(parse_category_names[cat]))
+                 .arg(pc.lines)
+                 .arg(pc.bytes)
+                 .arg(ns_per_line, 0, 'f', 0)
+                 .arg(lines_per_sec, 0, 'f', 0);
+    }
+
+    return lines.join(QStringLiteral("\n"));
+}
+
+void mpmetrics_dump_all()
+{
+    for(int i = 0; i < all_metrics.size(); i++) {
+        const MpMetrics *m = all_metrics.at(i);
+        const QString rep = m->report();
+        qWarning("metrics of %s:\n%s", qPrintable(m->name()), rep.isEmpty() ? "nothing yet" : qPrintable(rep));
+    }
+}
+
+static void dump_signal_handler(int signo)
+{
+    (void)signo;
+    const int saved_errno = errno;
+    const char b = 0;
+    // if the pipe is full, a dump is pending anyway
+    (void)::write(dump_pipe_write_fd, &b, 1);
+    errno = saved_errno;
+}
+
+MpMetricsDumper::MpMetricsDumper(QObject *parent)
+    : super(parent)
+{
+    setObjectName(QStringLiteral("MpMetricsDumper"));
+}
+
+void MpMetricsDumper::slot_dump(int fd)
+{
+    char junk[64];
+
+    while(::read(fd, junk, sizeof(junk)) > 0) {
+    }
+
+    mpmetrics_dump_all();
+}
+
+void mpmetrics_install_dump_signal(int signo)
+{
+    if(dump_pipe_write_fd >= 0) {
+        PROGRAMMERERROR("mpmetrics_install_dump_signal() called twice");
+    }
+
+    int fds[2];
+
+    if(::pipe2(fds, O_CLOEXEC | O_NONBLOCK) != 0) {
+        qWarning("could not create pipe for metrics dump: %s", strerror(errno));
+        return;
+    }
+
+    dump_pipe_write_fd = fds[1];
+
+    MpMetricsDumper *dumper = new MpMetricsDumper(QCoreApplication::instance());
+    QSocketNotifier *notifier = new QSocketNotifier(fds[0], QSocketNotifier::Read, dumper);
+    XCONNECT(notifier, SIGNAL(activated(int)), dumper, SLOT(slot_dump(int)));
+
+    struct sigaction new_action;
+    new_action.sa_handler = dump_signal_handler;
+    sigemptyset(&new_action.sa_mask);
+    new_action.sa_flags = SA_RESTART;
+
+    if(0 != sigaction(signo, &new_action, NULL)) {
+        qWarning("could not install metrics dump handler for %s: %s", strsignal(signo), strerror(errno));
+    }
+}
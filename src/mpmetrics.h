@@ -0,0 +1,98 @@
+#ifndef MPMETRICS_H
+#define MPMETRICS_H
+
+#include <QObject>
+#include <QMap>
+#include <QByteArray>
+#include <QString>
+
+#include "latencyhistogram.h"
+#include "mpstate.h"
+#include "mplinedispatch.h"
+
+// what parsing one kind of mplayer output costs
+struct MpParseCounter {
+    quint64 lines;
+    quint64 bytes;
+    qint64 nsecs;
+};
+
+// Latencies of talking to one mplayer, for the lifetime of an MpProcess.
+// Histograms instead of maxima, so tails can be seen on production boxes:
+// the application logs every live MpMetrics on SIGUSR1, see
+// mpmetrics_install_dump_signal().
+class MpMetrics
+{
+private:
+    QString m_name;
+    // forbid
+    MpMetrics();
+    MpMetrics(const MpMetrics &);
+    MpMetrics &operator=(const MpMetrics &in);
+public:
+    explicit MpMetrics(const QString &name);
+    ~MpMetrics();
+
+    enum ParseCategory {
+        ParseStatusline,
+        ParseIdentify,
+        ParseAnswer,
+        ParseNoise,
+        ParseOther,
+        // parsePosition(), once per read
+        ParsePosition,
+        ParseCategoryCount
+    };
+    static ParseCategory parse_category_of(MpLineKind kind, unsigned noise);
+    // as in report()
+    static char const *parse_category_name(ParseCategory cat);
+
+    // from queueing a command to writing it
+    MyLatencyHistogram queue_wait;
+    // from writing a query to its reply, by the reply, e.g. "ANS_TIME_POSITION"
+    QMap<QByteArray, MyLatencyHistogram> reply;
+    // from a write to the next valid read
+    MyLatencyHistogram write_to_read;
+    // between two valid reads, by the state we were in
+    MyLatencyHistogram read_gap[MpState_maxidx];
+    // from writing a seek to the first position trusted after it
+    MyLatencyHistogram seek_to_position;
+    // parsing a line read, on the reader thread, and parseLine() acting on
+    // it, by what it was. Noise is counted as
+    // other unless debug output or the accumulator needed it classified
+    MpParseCounter parse[ParseCategoryCount];
+
+    void count_parse(ParseCategory cat, int bytes, qint64 nsecs)
+    {
+        MpParseCounter &pc = parse[cat];
+        pc.lines++;
+        pc.bytes += bytes;
+        pc.nsecs += nsecs;
+    }
+
+    const QString &name() const
+    {
+        return m_name;
+    }
+    void clear();
+    // one line per non-empty histogram
+    QString report() const;
+};
+
+// logs the report() of every live MpMetrics when signo arrives
+void mpmetrics_install_dump_signal(int signo);
+// same, right now
+void mpmetrics_dump_all();
+
+// gets the dump out of the signal handler and into the event loop
+class MpMetricsDumper : public QObject
+{
+    Q_OBJECT
+public:
+    typedef QObject super;
+    explicit MpMetricsDumper(QObject *parent);
+public slots:
+    void slot_dump(int fd);
+};
+
+#endif // MPMETRICS_H
@@ -0,0 +1,217 @@
+#include "mpnoiseclassifier.h"
+
+#include <cstring>
+
+#define LIT(lit) lit, int(sizeof(lit) - 1)
+
+// does the literal start at pos? returns the position after it, or -1
+static int lit_at(const MpLineView &line, int pos, char const *const lit, int litlen)
+{
+    if(pos < 0 || line.len - pos < litlen) {
+        return (-1);
+    }
+
+    if(0 != ::memcmp(line.data + pos, lit, litlen)) {
+        return (-1);
+    }
+
+    return pos + litlen;
+}
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// [\d\w]
+static bool is_word(char c)
+{
+    return is_digit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+// one or more characters of the class, returns the position after them, or -1
+static int span_at(const MpLineView &line, int pos, bool (*pred)(char))
+{
+    if(pos < 0) {
+        return (-1);
+    }
+
+    const int start = pos;
+
+    while(pos < line.len && pred(line.data[pos])) {
+        pos++;
+    }
+
+    return (pos > start ? pos : (-1));
+}
+
+// \[matroska,webm \@ 0x[\d\w]+\]Unknown entry 0x[\d\w]+
+// \[matroska,webm \@ 0x[\d\w]+\]first_dts 0
+static bool crap_at_bracket(const MpLineView &line, int pos)
+{
+    int p = lit_at(line, pos, LIT("[matroska,webm @ 0x"));
+    p = span_at(line, p, is_word);
+    p = lit_at(line, p, LIT("]"));
+
+    if(p < 0) {
+        return false;
+    }
+
+    const int q = lit_at(line, p, LIT("Unknown entry 0x"));
+
+    if(span_at(line, q, is_word) >= 0) {
+        return true;
+    }
+
+    return lit_at(line, p, LIT("first_dts 0 ")) >= 0;
+}
+
+static bool crap_at_A(const MpLineView &line, int pos)
+{
+    // ASS: \[ass\] shifting from \d+ to \d
+    // ASS: \[ass\] forced line break at \d+
+    const int p = lit_at(line, pos, LIT("ASS: [ass] "));
+
+    if(p < 0) {
+        return false;
+    }
+
+    int q = lit_at(line, p, LIT("shifting from "));
+    q = span_at(line, q, is_digit);
+    q = lit_at(line, q, LIT(" to "));
+
+    if(span_at(line, q, is_digit) >= 0) {
+        return true;
+    }
+
+    q = lit_at(line, p, LIT("forced line break at "));
+    return span_at(line, q, is_digit) >= 0;
+}
+
+static bool crap_at_D(const MpLineView &line, int pos)
+{
+    // DECAUDIO: \[.+\]DTS-ExSS: unknown marker =
+    const int p = lit_at(line, pos, LIT("DECAUDIO: ["));
+
+    if(p < 0 || p + 1 >= line.len) {
+        return false;
+    }
+
+    static_var char const tail[] = "]DTS-ExSS: unknown marker = ";
+    return NULL != ::memmem(line.data + p + 1, line.len - p - 1, tail, sizeof(tail) - 1);
+}
+
+static bool crap_at_F(const MpLineView &line, int pos)
+{
+    if(lit_at(line, pos, LIT("Fontconfig warning")) >= 0) {
+        return true;
+    }
+
+    // FLIP_PAGE VID:\d+
+    const int p = lit_at(line, pos, LIT("FLIP_PAGE VID:"));
+    return span_at(line, p, is_digit) >= 0;
+}
+
+static bool crap_at_V(const MpLineView &line, int pos)
+{
+    int p = lit_at(line, pos, LIT("VFILTER: "));
+
+    if(p >= 0) {
+        return lit_at(line, p, LIT("Suspicious mp_image usage count")) >= 0
+               || lit_at(line, p, LIT("scale: query(Planar")) >= 0;
+    }
+
+    p = lit_at(line, pos, LIT("VIDEOOUT: "));
+
+    if(p < 0) {
+        return false;
+    }
+
+    // VIDEOOUT: $
+    if(p == line.len) {
+        return true;
+    }
+
+    if(lit_at(line, p, LIT("DRAW_OSD")) >= 0) {
+        return true;
+    }
+
+    // VIDEOOUT: VID_CREATE: \d+
+    // VIDEOOUT: VID CREATE: \d+
+    p = lit_at(line, p, LIT("VID"));
+
+    if(p < 0 || p >= line.len || (line.data[p] != '_' && line.data[p] != ' ')) {
+        return false;
+    }
+
+    p = lit_at(line, p + 1, LIT("CREATE: "));
+    return span_at(line, p, is_digit) >= 0;
+}
+
+unsigned mpnoise_classify(const MpLineView &line)
+{
+    unsigned ret = MpNoiseNone;
+
+    for(int pos = 0; pos < line.len; pos++) {
+        switch(line.data[pos]) {
+            case 'A':
+                if(!(ret & MpNoiseStatus) && pos + 1 < line.len && line.data[pos + 1] == ':') {
+                    ret |= MpNoiseStatus;
+                }
+                else if(!(ret & MpNoiseCrap) && crap_at_A(line, pos)) {
+                    ret |= MpNoiseCrap;
+                }
+
+                break;
+
+            case 'V':
+                if(!(ret & MpNoiseStatus) && pos + 1 < line.len && line.data[pos + 1] == ':') {
+                    ret |= MpNoiseStatus;
+                }
+                else if(!(ret & MpNoiseCrap) && crap_at_V(line, pos)) {
+                    ret |= MpNoiseCrap;
+                }
+
+                break;
+
+            case 'B':
+                if(!(ret & MpNoiseCrap) && lit_at(line, pos, LIT("BUG in FFmpeg, draw_slice called with NULL pointer")) >= 0) {
+                    ret |= MpNoiseCrap;
+                }
+
+                break;
+
+            case 'D':
+                if(!(ret & MpNoiseCrap) && crap_at_D(line, pos)) {
+                    ret |= MpNoiseCrap;
+                }
+
+                break;
+
+            case 'F':
+                if(!(ret & MpNoiseCrap) && crap_at_F(line, pos)) {
+                    ret |= MpNoiseCrap;
+                }
+
+                break;
+
+            case '[':
+                if(!(ret & MpNoiseCrap) && crap_at_bracket(line, pos)) {
+                    ret |= MpNoiseCrap;
+                }
+
+                break;
+
+            default:
+                break;
+        }
+
+        if(ret == (MpNoiseCrap | MpNoiseStatus)) {
+            break;
+        }
+    }
+
+    return ret;
+}
+
+#undef LIT
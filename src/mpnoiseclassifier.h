@@ -0,0 +1,21 @@
+#ifndef MPNOISECLASSIFIER_H
+#define MPNOISECLASSIFIER_H
+
+#include "mplinedispatch.h"
+
+// what kind of uninteresting mplayer output a line is, can be both
+enum MpNoiseClass {
+    MpNoiseNone = 0,
+    // known harmless warnings and debug spam from codecs and filters
+    MpNoiseCrap = 1,
+    // contains "A:" or "V:", i.e. looks like a status line
+    MpNoiseStatus = 2
+};
+
+// Finds all noise patterns in one scan over the line. Every byte is looked
+// up once by its value, and only the few patterns starting with that byte
+// are verified at that position. Matches the same lines as the crap_rxlit
+// and statusline_rxlit regular expressions in mpprocess.cpp.
+unsigned mpnoise_classify(const MpLineView &line);
+
+#endif // MPNOISECLASSIFIER_H
@@ -0,0 +1,422 @@
+#include "mppipereader.h"
+
+#include "event_desc.h"
+#include "encoding.h"
+#include "mpmediainfo.h"
+#include "util.h"
+
+#include <QElapsedTimer>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+
+#include <QLoggingCategory>
+#define THIS_SOURCE_FILE_LOG_CATEGORY "MPR"
+static Q_LOGGING_CATEGORY(category, THIS_SOURCE_FILE_LOG_CATEGORY)
+#define MYDBG(msg, ...) qCDebug(category, msg, ##__VA_ARGS__)
+
+#define PIPE_READ 0
+#define PIPE_WRITE 1
+
+// lines in flight between the reader thread and the consumer
+static_var const int ring_capacity_lines = 4096;
+// bytes per read()
+static_var const int read_chunk_bytes = 65536;
+
+MpPipeReader::MpPipeReader(char const *const oName_latin1, QObject *parent)
+    : super(parent)
+    , m_ring(ring_capacity_lines)
+    , m_readbuf(read_chunk_bytes, '\0')
+    , m_lastpushed(NULL)
+    , m_notify_pending(0)
+    , m_space_wanted(0)
+    , m_stop(0)
+    , m_partial_request(PartialNothing)
+{
+    setObjectName(QLatin1String(oName_latin1));
+
+    for(int c = 0; c < 2; c++) {
+        m_fds[c][PIPE_READ] = (-1);
+        m_fds[c][PIPE_WRITE] = (-1);
+    }
+
+    m_wakefds[PIPE_READ] = (-1);
+    m_wakefds[PIPE_WRITE] = (-1);
+}
+
+MpPipeReader::~MpPipeReader()
+{
+    stop_and_wait();
+
+    for(int c = 0; c < 2; c++) {
+        close_fd(m_fds[c][PIPE_READ]);
+        close_fd(m_fds[c][PIPE_WRITE]);
+    }
+
+    close_fd(m_wakefds[PIPE_READ]);
+    close_fd(m_wakefds[PIPE_WRITE]);
+}
+
+bool MpPipeReader::event(QEvent *event)
+{
+    log_qevent(category(), this, event);
+
+    return super::event(event);
+}
+
+void MpPipeReader::close_fd(int &fd)
+{
+    if(fd < 0) {
+        return;
+    }
+
+    const int orifd = fd;
+    fd = (-1);
+
+    if(::close(orifd) != 0) {
+        MYDBG("close(%d): %s", orifd, strerror(errno));
+    }
+}
+
+bool MpPipeReader::open_pipes(QString *errmsg)
+{
+    if(isRunning()) {
+        PROGRAMMERERROR("open_pipes() while running");
+    }
+
+    // from the previous child, if any
+    for(int c = 0; c < 2; c++) {
+        close_fd(m_fds[c][PIPE_READ]);
+        close_fd(m_fds[c][PIPE_WRITE]);
+        m_splitter[c].clear();
+    }
+
+    close_fd(m_wakefds[PIPE_READ]);
+    close_fd(m_wakefds[PIPE_WRITE]);
+    m_stop.storeRelease(0);
+    m_partial_request.storeRelease(PartialNothing);
+
+    for(int c = 0; c < 2; c++) {
+        // the child's end has to stay blocking, mplayer does not expect EAGAIN
+        if(::pipe2(m_fds[c], O_CLOEXEC) != 0) {
+            *errmsg = QStringLiteral("could not create pipe: ") + QLatin1String(strerror(errno));
+            return false;
+        }
+
+        if(::fcntl(m_fds[c][PIPE_READ], F_SETFL, O_NONBLOCK) != 0) {
+            *errmsg = QStringLiteral("could not make pipe nonblocking: ") + QLatin1String(strerror(errno));
+            return false;
+        }
+    }
+
+    if(::pipe2(m_wakefds, O_CLOEXEC | O_NONBLOCK) != 0) {
+        *errmsg = QStringLiteral("could not create pipe: ") + QLatin1String(strerror(errno));
+        return false;
+    }
+
+    MYDBG("pipes: out %d/%d err %d/%d wake %d/%d"
+          , m_fds[Out][PIPE_READ], m_fds[Out][PIPE_WRITE]
+          , m_fds[Err][PIPE_READ], m_fds[Err][PIPE_WRITE]
+          , m_wakefds[PIPE_READ], m_wakefds[PIPE_WRITE]);
+    return true;
+}
+
+void MpPipeReader::close_child_fds()
+{
+    // otherwise we never see EOF
+    close_fd(m_fds[Out][PIPE_WRITE]);
+    close_fd(m_fds[Err][PIPE_WRITE]);
+}
+
+void MpPipeReader::wake()
+{
+    if(m_wakefds[PIPE_WRITE] < 0) {
+        return;
+    }
+
+    const char b = 0;
+
+    // a full pipe means it is awake anyway
+    while(::write(m_wakefds[PIPE_WRITE], &b, 1) < 0 && errno == EINTR) {
+    }
+}
+
+void MpPipeReader::drain_wake()
+{
+    char junk[64];
+
+    while(::read(m_wakefds[PIPE_READ], junk, sizeof(junk)) > 0) {
+    }
+}
+
+void MpPipeReader::stop_and_wait()
+{
+    MYDBG("stop_and_wait");
+    m_stop.storeRelease(1);
+    wake();
+    wait();
+}
+
+void MpPipeReader::terminate_partial_lines()
+{
+    m_partial_request.storeRelease(PartialTerminate);
+    wake();
+}
+
+void MpPipeReader::drop_partial_lines()
+{
+    m_partial_request.storeRelease(PartialDrop);
+    wake();
+}
+
+void MpPipeReader::publish_and_notify()
+{
+    m_lastpushed = NULL;
+
+    if(m_ring.unpublished() <= 0) {
+        return;
+    }
+
+    m_ring.publish();
+
+    if(m_notify_pending.testAndSetOrdered(0, 1)) {
+        emit sig_lines_ready();
+    }
+}
+
+// The part of MpProcess::parseLine() and parsePosition() that only needs
+// the line itself. Whatever does not convert is left to MpProcess to
+// complain about, it knows whether the line matters.
+void MpPipeReader::parse_line(MpPipeLine *pl)
+{
+    const MonoTime start = MonoTime::now();
+    MpParsedLine &p = pl->parsed;
+
+    MpLineView bline;
+    bline.data = pl->line.constData();
+    bline.len = pl->line.size();
+    const MpLineView tline = mpline_trimmed(bline);
+
+    MpLineView value;
+    p.kind = mpline_classify(tline, &value);
+    p.ok = true;
+    p.id_key.clear();
+    p.id_value.clear();
+
+    switch(p.kind) {
+        case MpLineKind::AnsSwitchAudio:
+            p.ok = mpline_to_int(value, &p.ivalue);
+            break;
+
+        case MpLineKind::AnsSpeed:
+        case MpLineKind::AnsTimePos:
+        case MpLineKind::AnsTimePosition:
+            p.ok = mpline_to_double(value, &p.dvalue);
+            break;
+
+        case MpLineKind::StatusLine:
+            p.ok = mpstatusline_parse(tline, &p.status);
+            break;
+
+        case MpLineKind::Identify:
+            p.ok = MpMediaInfo::split_identify(warn_xbin_2_local_qstring(QByteArray::fromRawData(tline.data, tline.len)), &p.id_key, &p.id_value);
+            break;
+
+        default:
+            break;
+    }
+
+    p.nsecs = MonoTime::now().nsecs() - start.nsecs();
+}
+
+// The consumer is behind: lets it see what we have and waits for it to pop
+// something. false if we are to stop meanwhile.
+bool MpPipeReader::wait_for_space()
+{
+    publish_and_notify();
+
+    while(!m_stop.loadAcquire()) {
+        // see pop()
+        m_space_wanted.fetchAndStoreOrdered(1);
+
+        if(m_ring.push_slot() != NULL) {
+            m_space_wanted.fetchAndStoreOrdered(0);
+            return true;
+        }
+
+        struct pollfd pfd;
+        pfd.fd = m_wakefds[PIPE_READ];
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        if(::poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+            qWarning("poll() on the wake pipe: %s", strerror(errno));
+            return false;
+        }
+
+        // a partial line request stays in m_partial_request for run()
+        drain_wake();
+    }
+
+    return false;
+}
+
+void MpPipeReader::push_lines(Channel c, const MonoTime &readtime)
+{
+    char const *data;
+    int len;
+
+    while(m_splitter[c].next_line(&data, &len)) {
+        if(len < 1) {
+            continue;
+        }
+
+        MpPipeLine *pl = m_ring.push_slot();
+
+        if(pl == NULL) {
+            if(!wait_for_space()) {
+                MYDBG("ring full while stopping, dropping \"%.*s\"", len, data);
+                continue;
+            }
+
+            pl = m_ring.push_slot();
+        }
+
+        pl->line.resize(len);
+        memcpy(pl->line.data(), data, len);
+        pl->c = c;
+        pl->t = readtime;
+        pl->last_of_read = false;
+        parse_line(pl);
+        m_ring.push_done();
+        m_lastpushed = pl;
+    }
+}
+
+void MpPipeReader::read_channel(Channel c, const MonoTime &readtime)
+{
+    int &fd = m_fds[c][PIPE_READ];
+
+    QElapsedTimer busytimer;
+    busytimer.start();
+
+    while(fd >= 0) {
+        const ssize_t got = ::read(fd, m_readbuf.data(), m_readbuf.size());
+
+        if(got > 0) {
+            m_splitter[c].append(QByteArray::fromRawData(m_readbuf.constData(), int(got)));
+            push_lines(c, readtime);
+
+            if(got < m_readbuf.size()) {
+                break;
+            }
+        }
+        else if(got == 0) {
+            MYDBG("EOF on %s", c == Out ? "stdout" : "stderr");
+            close_fd(fd);
+        }
+        else if(errno == EINTR) {
+            continue;
+        }
+        else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        else {
+            qWarning("reading mplayer %s: %s", c == Out ? "stdout" : "stderr", strerror(errno));
+            close_fd(fd);
+        }
+    }
+
+    if(m_lastpushed != NULL) {
+        m_lastpushed->last_of_read = true;
+    }
+
+    m_splitter[c].add_busy_nsecs(busytimer.nsecsElapsed());
+}
+
+void MpPipeReader::handle_partial_request(const MonoTime &now)
+{
+    const int req = m_partial_request.fetchAndStoreOrdered(PartialNothing);
+
+    for(int c = 0; c < 2; c++) {
+        if(req == PartialDrop) {
+            m_splitter[c].clear();
+        }
+        else if(req == PartialTerminate && m_splitter[c].has_partial_line()) {
+            m_splitter[c].append(QByteArray(1, '\n'));
+            push_lines(Channel(c), now);
+
+            if(m_lastpushed != NULL) {
+                m_lastpushed->last_of_read = true;
+            }
+        }
+    }
+
+    publish_and_notify();
+}
+
+void MpPipeReader::run()
+{
+    MYDBG("run()");
+
+    struct pollfd pfds[3];
+    Channel pfdchannel[3];
+
+    while(!m_stop.loadAcquire()) {
+        handle_partial_request(MonoTime::now());
+
+        int npfds = 0;
+
+        for(int c = 0; c < 2; c++) {
+            if(m_fds[c][PIPE_READ] >= 0) {
+                pfds[npfds].fd = m_fds[c][PIPE_READ];
+                pfds[npfds].events = POLLIN;
+                pfds[npfds].revents = 0;
+                pfdchannel[npfds] = Channel(c);
+                npfds++;
+            }
+        }
+
+        if(npfds == 0) {
+            MYDBG("both pipes closed");
+            break;
+        }
+
+        pfds[npfds].fd = m_wakefds[PIPE_READ];
+        pfds[npfds].events = POLLIN;
+        pfds[npfds].revents = 0;
+
+        const int ret = ::poll(pfds, npfds + 1, -1);
+        // as close to mplayer writing as we get
+        const MonoTime readtime = MonoTime::now();
+
+        if(ret < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+
+            qWarning("poll() on mplayer pipes: %s", strerror(errno));
+            break;
+        }
+
+        if(pfds[npfds].revents != 0) {
+            drain_wake();
+        }
+
+        for(int i = 0; i < npfds; i++) {
+            if(pfds[i].revents != 0) {
+                read_channel(pfdchannel[i], readtime);
+            }
+        }
+
+        publish_and_notify();
+    }
+
+    // nothing gets lost
+    m_partial_request.storeRelease(PartialTerminate);
+    handle_partial_request(MonoTime::now());
+    MYDBG("run() done");
+}
@@ -0,0 +1,163 @@
+#ifndef MPPIPEREADER_H
+#define MPPIPEREADER_H
+
+#include <QObject>
+#include <QThread>
+#include <QByteArray>
+#include <QString>
+#include <QAtomicInt>
+
+#include "linesplitter.h"
+#include "spscring.h"
+#include "monotime.h"
+#include "mplinedispatch.h"
+#include "mpstatusline.h"
+
+// What the reader thread made of a line, so MpProcess only has to act on it.
+// Only the fields for kind are set.
+struct MpParsedLine {
+    MpLineKind kind;
+    // false if the value after the prefix is not what kind needs
+    bool ok;
+    // AnsSwitchAudio
+    int ivalue;
+    // AnsSpeed, AnsTimePos, AnsTimePosition
+    double dvalue;
+    // StatusLine
+    MpStatusLine status;
+    // Identify, see MpMediaInfo::split_identify(). Empty if it was none
+    QString id_key;
+    QString id_value;
+    // what all of this took
+    qint64 nsecs;
+};
+
+// one line of mplayer output, without its terminator and never empty
+struct MpPipeLine {
+    QByteArray line;
+    // MpPipeReader::Channel
+    int c;
+    // when the read() that brought the end of the line returned
+    MonoTime t;
+    // the last line of that read()
+    bool last_of_read;
+    MpParsedLine parsed;
+};
+
+// Reads mplayer's stdout and stderr on its own thread, so a busy GUI thread
+// neither delays the reads nor falsifies their timestamps. The pipes are
+// ours, not QProcess's: the child gets them dup2()ed onto fd 1 and 2.
+// Complete lines are parsed right here and go through a lock-free ring to
+// the thread that owns this object, which is told about them by
+// sig_lines_ready().
+class MpPipeReader : public QThread
+{
+    Q_OBJECT
+
+public:
+    typedef QThread super;
+    enum Channel {
+        Out = 0,
+        Err = 1
+    };
+
+private:
+    // [channel][PIPE_READ / PIPE_WRITE]
+    int m_fds[2][2];
+    // wakes up poll() for stop and partial line requests
+    int m_wakefds[2];
+
+    MySpscRing<MpPipeLine> m_ring;
+    // only touched by the reader thread while it runs
+    MyLineSplitter m_splitter[2];
+    QByteArray m_readbuf;
+    // last slot pushed but not published yet, gets last_of_read
+    MpPipeLine *m_lastpushed;
+
+    // sig_lines_ready() was emitted, and the consumer did not look yet
+    QAtomicInt m_notify_pending;
+    // the ring is full and the reader thread waits for pop() to wake it
+    QAtomicInt m_space_wanted;
+    QAtomicInt m_stop;
+    // PartialRequest
+    QAtomicInt m_partial_request;
+
+    enum PartialRequest {
+        PartialNothing = 0,
+        PartialTerminate = 1,
+        PartialDrop = 2
+    };
+
+    // forbid
+    MpPipeReader();
+    MpPipeReader(const MpPipeReader &);
+    MpPipeReader &operator=(const MpPipeReader &in);
+
+public:
+    MpPipeReader(char const *const oName_latin1, QObject *parent);
+    virtual ~MpPipeReader();
+
+    // before the child is started, again for every new child
+    bool open_pipes(QString *errmsg);
+    // the write ends, for the child
+    int child_fd(Channel c) const
+    {
+        return m_fds[c][1];
+    }
+    // after the child is started
+    void close_child_fds();
+    // returns once the thread is gone. Whatever partial lines are left are
+    // terminated and published first.
+    void stop_and_wait();
+
+    // asynchronous, handled by the reader thread before its next read
+    void terminate_partial_lines();
+    void drop_partial_lines();
+
+    // consumer side, only on the thread owning this object
+    MpPipeLine *front()
+    {
+        return m_ring.front();
+    }
+    void pop()
+    {
+        m_ring.pop();
+
+        // an exchange, not a load: it has to be ordered against the one in
+        // wait_for_space(), or both sides could miss each other
+        if(m_space_wanted.fetchAndStoreOrdered(0) != 0) {
+            wake();
+        }
+    }
+    // call before draining, so new lines emit sig_lines_ready() again
+    void consumer_notified()
+    {
+        m_notify_pending.storeRelease(0);
+    }
+    // statistics, only valid once the thread is gone
+    const MyLineSplitter &splitter(Channel c) const
+    {
+        return m_splitter[c];
+    }
+    // fills pl->parsed from pl->line, done on the reader thread
+    static void parse_line(MpPipeLine *pl);
+
+signals:
+    void sig_lines_ready();
+
+protected:
+    virtual void run();
+    virtual bool event(QEvent *event);
+
+private:
+    void wake();
+    void drain_wake();
+    void handle_partial_request(const MonoTime &now);
+    void read_channel(Channel c, const MonoTime &readtime);
+    void push_lines(Channel c, const MonoTime &readtime);
+    bool wait_for_space();
+    void publish_and_notify();
+    void close_fd(int &fd);
+};
+
+#endif // MPPIPEREADER_H
@@ -0,0 +1,151 @@
+#include "mppositionestimator.h"
+
+#include "util.h"
+
+#include <QtGlobal>
+
+// how much of the prediction error a sample corrects
+// status lines are an average of A: and V:, and jitter
+static_var const double alpha_statusline = 0.25;
+// get_time_pos answers are what mplayer thinks
+static_var const double alpha_precise = 0.8;
+// how much of the error per second goes into the rate
+static_var const double beta = 0.02;
+// farther off than that is a jump, not jitter
+static_var const double jump_if_error_larger_than_sec = 1.5;
+// the rate stays within that factor of the playback speed
+static_var const double max_rate_deviation = 0.05;
+// weight of a new error in the running average
+static_var const double err_smoothing = 0.1;
+// uncertainty right after a jump
+static_var const double err_after_jump_sec = 0.5;
+// uncertainty grows that much per second without a sample
+static_var const double err_growth_per_sec = 0.02;
+
+MpPositionEstimator::MpPositionEstimator()
+{
+    reset();
+}
+
+void MpPositionEstimator::reset()
+{
+    m_valid = false;
+    m_running = false;
+    m_pos = (-1);
+    m_t = MonoTime();
+    m_rate = 1.;
+    m_speed = 1.;
+    m_err = err_after_jump_sec;
+}
+
+void MpPositionEstimator::jump_to(double pos, const MonoTime &t)
+{
+    m_valid = true;
+    m_pos = pos;
+    m_t = t;
+    m_rate = m_speed;
+    m_err = err_after_jump_sec;
+}
+
+void MpPositionEstimator::sample(double pos, const MonoTime &t, bool precise)
+{
+    if(!m_valid || t.isNull() || m_t.isNull()) {
+        jump_to(pos, t);
+        m_err = (precise ? 0. : err_after_jump_sec);
+        return;
+    }
+
+    const double predicted = position_at(t);
+    const double error = pos - predicted;
+
+    if(qAbs(error) > jump_if_error_larger_than_sec) {
+        jump_to(pos, t);
+        m_err = (precise ? 0. : err_after_jump_sec);
+        return;
+    }
+
+    // samples can be older than the last jump, do not learn the rate from them
+    const double dt = double(m_t.msecsTo(t)) / 1000.;
+
+    const double alpha = (precise ? alpha_precise : alpha_statusline);
+    m_pos = predicted + alpha * error;
+
+    if(m_running && dt > 0.05) {
+        m_rate += beta * error / dt;
+        const double lo = m_speed * (1. - max_rate_deviation);
+        const double hi = m_speed * (1. + max_rate_deviation);
+        m_rate = qBound(lo, m_rate, hi);
+    }
+
+    if(t > m_t) {
+        m_t = t;
+    }
+    else {
+        // keep the time, move the position back to it
+        m_pos += (m_running ? m_rate * double(t.msecsTo(m_t)) / 1000. : 0.);
+    }
+
+    m_err = (1. - err_smoothing) * m_err + err_smoothing * qAbs(error);
+
+    if(precise && m_err > qAbs(error)) {
+        m_err = qAbs(error);
+    }
+}
+
+void MpPositionEstimator::set_speed(double speed, const MonoTime &now)
+{
+    if(speed <= 0) {
+        PROGRAMMERERROR("speed %f", speed);
+    }
+
+    if(m_valid && !now.isNull()) {
+        m_pos = position_at(now);
+        m_t = now;
+    }
+
+    m_rate = m_rate * speed / m_speed;
+    m_speed = speed;
+}
+
+void MpPositionEstimator::set_running(bool running, const MonoTime &now)
+{
+    if(running == m_running) {
+        return;
+    }
+
+    if(m_valid && !now.isNull()) {
+        m_pos = position_at(now);
+        m_t = now;
+    }
+
+    m_running = running;
+}
+
+double MpPositionEstimator::position_at(const MonoTime &t) const
+{
+    if(!m_valid) {
+        return (-1);
+    }
+
+    if(!m_running || t.isNull() || m_t.isNull()) {
+        return m_pos;
+    }
+
+    const double pos = m_pos + m_rate * double(m_t.msecsTo(t)) / 1000.;
+    return (pos < 0 ? 0. : pos);
+}
+
+double MpPositionEstimator::uncertainty_secs(const MonoTime &t) const
+{
+    if(!m_valid) {
+        return 1e9;
+    }
+
+    double since = 0;
+
+    if(m_running && !t.isNull() && !m_t.isNull() && m_t < t) {
+        since = double(m_t.msecsTo(t)) / 1000.;
+    }
+
+    return m_err + err_growth_per_sec * since;
+}
@@ -0,0 +1,55 @@
+#ifndef MPPOSITIONESTIMATOR_H
+#define MPPOSITIONESTIMATOR_H
+
+#include "monotime.h"
+
+// Smooths the stream positions read from mplayer with an alpha-beta filter.
+// Keeps a position at a point in time and a rate (stream seconds per
+// second, nominally the playback speed). Every sample pulls both towards
+// what was read, precise samples (ANS_TIME_POSITION) harder than status
+// lines. Samples too far off the prediction are taken as a jump.
+//
+// uncertainty_secs() says how far off the estimate might be: the running
+// average of the prediction errors, growing with the time since the last
+// sample.
+class MpPositionEstimator
+{
+private:
+    bool m_valid;
+    bool m_running;
+    // position m_pos at time m_t
+    double m_pos;
+    MonoTime m_t;
+    double m_rate;
+    // what m_rate should be
+    double m_speed;
+    // running average of |prediction error|
+    double m_err;
+public:
+    MpPositionEstimator();
+
+    void reset();
+    bool has_estimate() const
+    {
+        return m_valid;
+    }
+
+    // a position read from mplayer, at the time it was read
+    void sample(double pos, const MonoTime &t, bool precise);
+    // we know the position changed, e.g. by a seek
+    void jump_to(double pos, const MonoTime &t);
+    // the playback speed changed
+    void set_speed(double speed, const MonoTime &now);
+    // paused or stopped: the position does not move
+    void set_running(bool running, const MonoTime &now);
+
+    // -1 if there is no estimate yet
+    double position_at(const MonoTime &t) const;
+    double uncertainty_secs(const MonoTime &t) const;
+    double rate() const
+    {
+        return m_rate;
+    }
+};
+
+#endif // MPPOSITIONESTIMATOR_H
@@ -2,23 +2,26 @@
 #include <QDebug>
 #include <QFile>
 #include <QScopedArrayPointer>
-#include <QElapsedTimer>
-#include <QCoreApplication>
 
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <string.h>
 
 #include "mpmediainfo.h"
 #include "qprocess_meta.h"
 #include "vregularexpression.h"
-#include "asyncreadfile.h"
+#include "asyncprobe.h"
+#include "mountthroughput.h"
+#include "probecache.h"
 #include "asynckillproc.h"
 #include "safe_signals.h"
 #include "encoding.h"
 #include "event_desc.h"
+#include "mpstatusline.h"
+#include "mpnoiseclassifier.h"
 
 #include <QLoggingCategory>
 
@@ -46,10 +49,8 @@ static Q_LOGGING_CATEGORY(categorycrap, THIS_SOURCE_FILE_LOG_CATEGORY_CRAP)
 // first access just starts the HD, mounts the directory, ...
 static_var const qint64 preloading_file_KBytes = 4;
 static_var const qint64 preloading_file_timeout_sec = 10;
-// second access tries to read a good chunk and tests the speed
-static_var const qint64 sustain_file_KBytes = 16 * 1024;
-// fail if we could not load that much of the file at this speed
-static_var const qint64 sustain_read_file_min_speed_kB_per_sec = 3000;
+// second access tries to read a good chunk and tests the speed, how much
+// and how fast comes from plan_reading()
 
 // after a seek, we will get statuslines for a while which do not yet show the new position
 static_var const qint64 ignore_statusline_after_seek_ms = 400;
@@ -71,6 +72,8 @@ static_var const qint64 allow_writes_even_if_no_read_ms = 300;
 static_var const int output_queue_max_size = 16;
 // if the output queue is larger, reduce min times
 static_var const int output_queue_large_size = 8;
+// at most that many commands are sent to mplayer in one write
+static_var const int max_commands_per_write = 4;
 // fail if we get a position that is that much bigger than the movie length
 static_var const double max_overflow_position_to_length_sec = 1.;
 // we expect to read something that many msec after a write
@@ -91,22 +94,21 @@ static_var const double minimum_allowed_negative_position_from_statusline = -1.;
 static_var const double ignore_seeks_from_slider_closer_than_sec = 5.;
 // if we detect that position force a stop
 static_var const double force_stop_sec_before_end = 1.;
-// after submitting a "stop" command, sleep that long
-static_var const int sleep_after_stop_command_msec = 800;
-// then, force a buffer flush and possibly wait even longer
-static_var const int waitforreadyread_after_stop_command_msec = 500;
+// after submitting a "stop" command, wait until mplayer was quiet that long
+static_var const int stop_quiet_msec = 250;
+// but not longer than that
+static_var const int stop_max_msec = 1300;
 // when trying to get out of mplayer, wait that long after issuing a "quit" command
 static_var const int wait_for_mplayer_quit_command_msec = 1000;
 // if the "quit" command did not work, call terminate() and wait that long before calling kill()
 static_var const int wait_after_terminate_call_msec = 300;
-// before loading a new file, try to clear the I/O buffers.
-// wait for readyRead so long
-static_var const int beforeload_waitForReadyRead_1_msec = 500;
-// sleep after that first wait...
-static_var const int beforeload_sleep_msec = 10;
-// wait for readyRead again so long
-static_var const int beforeload_waitForReadyRead_2_msec = 500;
-// after issuing a seek command, sleep that long
+// before loading a new file, drop mplayer output until it was quiet that long
+static_var const int beforeload_quiet_msec = 100;
+// but not longer than that
+static_var const int beforeload_max_msec = 1000;
+// on pause and play, only ask mplayer for the position if we might be that far off
+static_var const double ask_position_if_uncertainty_above_sec = 0.3;
+// after issuing a seek command, wait that long before asking for the position
 static_var const int sleep_after_seeking_msec = 100;
 
 static_var const char *const crap_rxlit =
@@ -162,16 +164,22 @@ static bool predicate_screensaver_should_be_active(void *data)
     return proc->screensaver_should_be_active();
 }
 
-MpProcess::MpProcess(QObject *parent, MpMediaInfo *mip)
+MpProcess::MpProcess(QObject *parent, MpMediaInfo *mip, bool manage_screensaver)
     : super(),
       m_proc(NULL)
     , m_curr_state(MpState::NotStartedState)
     , m_cfg_mplayerPath(QStringLiteral("mplayer"))
+    , m_trace(NULL)
     , m_mediaInfo(mip)
     , m_lastread_streamPosition(-1)
     , m_cfg_rx_output_accumulator_ignore(NULL)
+    , m_probe(NULL)
+    , m_probestage(ProbeStage::None)
+    , m_probe_last_stage(ProbeStage::None)
     , m_current_aid(0)
+    , m_cfg_manage_screensaver(manage_screensaver)
     , m_ssmanager(this, &predicate_screensaver_should_be_active, this)
+    , m_metrics(QStringLiteral("MPProcess"))
 {
     setObjectName(QStringLiteral("MPProcess"));
     setParent(parent);
@@ -180,6 +188,7 @@ MpProcess::MpProcess(QObject *parent, MpMediaInfo *mip)
     m_heartbeattimer.setParent(this);
 
     m_proc = new DeathSigProcess("MPProcess_proc", this);
+    m_pipereader = new MpPipeReader("MPProcess_pipereader", this);
 
     MYDBG("MpProcess::MpProcess");
 
@@ -189,6 +198,7 @@ MpProcess::MpProcess(QObject *parent, MpMediaInfo *mip)
     resetValues();
 
     m_cfg_acc_maxlines = 0;
+    m_cfg_acc_ignore_noise = false;
 
     m_stopped_because_of_long_seek = false;
 
@@ -199,8 +209,7 @@ MpProcess::MpProcess(QObject *parent, MpMediaInfo *mip)
     qRegisterMetaType<QProcess::ExitStatus>();
     qRegisterMetaType<QProcess::ProcessError>();
 
-    XCONNECT(m_proc, SIGNAL(readyReadStandardOutput()), this, SLOT(slot_readStdout()), QUEUEDCONN);
-    XCONNECT(m_proc, SIGNAL(readyReadStandardError()), this, SLOT(slot_readStderr()), QUEUEDCONN);
+    XCONNECT(m_pipereader, SIGNAL(sig_lines_ready()), this, SLOT(slot_pipe_lines_ready()), QUEUEDCONN);
     XCONNECT(m_proc, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(slot_finished(int, QProcess::ExitStatus)), QUEUEDCONN);
     XCONNECT(m_proc, SIGNAL(error(QProcess::ProcessError)), this, SLOT(slot_error_received(QProcess::ProcessError)), QUEUEDCONN);
     XCONNECT(m_proc, SIGNAL(started()), this, SLOT(slot_started()), QUEUEDCONN);
@@ -210,6 +219,21 @@ MpProcess::MpProcess(QObject *parent, MpMediaInfo *mip)
     m_heartbeattimer.setSingleShot(false);
     XCONNECT(&m_heartbeattimer, SIGNAL(timeout()), this, SLOT(slot_heartbeat()), QUEUEDCONN);
     make_heartbeat_active_or_not();
+
+    m_transition = Transition::None;
+    m_transition_quiettimer.setObjectName(QStringLiteral("QMPP_trans_quiet"));
+    m_transition_quiettimer.setParent(this);
+    m_transition_quiettimer.setSingleShot(true);
+    XCONNECT(&m_transition_quiettimer, SIGNAL(timeout()), this, SLOT(slot_transition_settled()), QUEUEDCONN);
+    m_transition_maxtimer.setObjectName(QStringLiteral("QMPP_trans_max"));
+    m_transition_maxtimer.setParent(this);
+    m_transition_maxtimer.setSingleShot(true);
+    XCONNECT(&m_transition_maxtimer, SIGNAL(timeout()), this, SLOT(slot_transition_settled()), QUEUEDCONN);
+
+    m_flushtimer.setObjectName(QStringLiteral("QMPP_flush"));
+    m_flushtimer.setParent(this);
+    m_flushtimer.setSingleShot(false);
+    XCONNECT(&m_flushtimer, SIGNAL(timeout()), this, SLOT(slot_flush_output_queue()), QUEUEDCONN);
 }
 
 void MpProcess::slot_started()
@@ -223,6 +247,11 @@ void MpProcess::quit()
     MYDBG("MpProcess::quit");
 
     m_heartbeattimer.stop();
+    m_flushtimer.stop();
+    m_transition_quiettimer.stop();
+    m_transition_maxtimer.stop();
+    m_transition = Transition::None;
+    cancel_probe();
 
     if(m_proc == NULL) {
         MYDBG("m_proc is already NULL");
@@ -250,13 +279,22 @@ void MpProcess::quit()
             async_kill_process(qpid, "making sure it is dead", qPrintable(QString::number(qpid)));
         }
 
-        clear_out_incremental_stdouterr();
+    }
 
+    if(m_pipereader != NULL) {
+        // publishes the partial lines on its way out
+        m_pipereader->stop_and_wait();
+        slot_pipe_lines_ready();
     }
 
     m_outputq.clear();
     resetValues();
-    m_ssmanager.enable();
+
+    if(m_cfg_manage_screensaver) {
+        m_ssmanager.enable();
+    }
+
+    trace_close();
 
 }
 
@@ -270,28 +308,37 @@ MpProcess::~MpProcess()
         m_cfg_rx_output_accumulator_ignore = NULL;
     }
 
-    for(unsigned idx = 0; idx < MpState_maxidx; idx++) {
-        const qint64 maxlat = expect_read_every_ms[idx];
-        const qint64 lat = m_max_encountered_readlatency_ms[idx];
-        m_max_encountered_readlatency_ms[idx] = (-1);
+    if(category().isDebugEnabled()) {
+        const QString rep = m_metrics.report();
 
-        if(lat >= 0 && maxlat > 0) {
-            MYDBG("%s: max latency encountered %lu ms", convert_MpStateidx_2_asciidesc(idx), (unsigned long)lat);
+        if(!rep.isEmpty()) {
+            MYDBG("latencies:\n%s", qPrintable(rep));
         }
     }
 
-    if(m_max_encountered_writelatency_ms >= 0) {
-        MYDBG("max write latency encountered %lu ms", (unsigned long)m_max_encountered_writelatency_ms);
-        m_max_encountered_writelatency_ms = (-1);
+    const MyLineSplitter &splitter_out = m_pipereader->splitter(MpPipeReader::Out);
+    const MyLineSplitter &splitter_err = m_pipereader->splitter(MpPipeReader::Err);
+
+    if(splitter_out.stat_lines() > 0) {
+        MYDBG("stdout: split %llu lines / %llu bytes in %f ms: %.0f lines/sec, %.0f bytes/sec"
+              , (unsigned long long)splitter_out.stat_lines(), (unsigned long long)splitter_out.stat_bytes()
+              , double(splitter_out.stat_busy_nsecs()) / 1e6, splitter_out.stat_lines_per_sec(), splitter_out.stat_bytes_per_sec());
     }
 
-    if(m_max_encountered_writequeuelatency_ms > 0) {
-        MYDBG("max time commands stayed in write queue: %lu ms", (unsigned long)m_max_encountered_writequeuelatency_ms);
-        m_max_encountered_writequeuelatency_ms = (-1);
+    if(splitter_err.stat_lines() > 0) {
+        MYDBG("stderr: split %llu lines / %llu bytes in %f ms: %.0f lines/sec, %.0f bytes/sec"
+              , (unsigned long long)splitter_err.stat_lines(), (unsigned long long)splitter_err.stat_bytes()
+              , double(splitter_err.stat_busy_nsecs()) / 1e6, splitter_err.stat_lines_per_sec(), splitter_err.stat_bytes_per_sec());
     }
 
     resetValues();
 
+    if(m_pipereader != NULL) {
+        MpPipeReader *copy = m_pipereader;
+        m_pipereader = NULL;
+        delete copy;
+    }
+
     if(m_proc != NULL) {
         MYDBG("deleting m_proc");
         DeathSigProcess *copy = m_proc;
@@ -360,9 +407,22 @@ void MpProcess::start_process(int xwinid, const QStringList &args)
 
     resetValues();
 
+    QString pipeerr;
+
+    if(!m_pipereader->open_pipes(&pipeerr)) {
+        changeToErrorState(pipeerr, MonoTime::now());
+        return;
+    }
+
+    m_proc->set_child_output_fds(m_pipereader->child_fd(MpPipeReader::Out), m_pipereader->child_fd(MpPipeReader::Err));
+    m_proc->setStandardOutputFile(QProcess::nullDevice());
+    m_proc->setStandardErrorFile(QProcess::nullDevice());
+    trace_open();
     m_proc->start(m_cfg_mplayerPath, myargs, QIODevice::Unbuffered | QIODevice::ReadWrite);
+    m_pipereader->close_child_fds();
+    m_pipereader->start();
     m_saved_mplayer_args = myargs;
-    QDateTime started = QDateTime::currentDateTimeUtc();
+    MonoTime started = MonoTime::now();
     TIMEMYDBG("start");
     changeState(MpState::IdleState, started);
 
@@ -374,86 +434,247 @@ void MpProcess::resetValues()
     set_screensaver_by_state();
     m_acc.clear();
     m_lastread_streamPosition = -1;
-    m_streamposition_readt = QDateTime();
+    m_estimator.reset();
     m_last_emited_streampos = (-1);
     m_curr_speed = 1;
     m_currently_muted = false;
     m_stopped_because_of_long_seek = false;
 
-    for(unsigned idx = 0; idx < MpState_maxidx; idx++) {
-        m_max_encountered_readlatency_ms[idx] = (-1);
-    }
-
-    m_max_encountered_writelatency_ms = (-1);
-    m_max_encountered_writequeuelatency_ms = (-1);
+    m_seek_writtent = MonoTime();
     m_previous_seek_direction_is_fwd = true;
 
     m_cfg_currently_parsing_mplayer_text = false;
     m_current_aid = 0;
+    m_ack_expected.clear();
+    m_ack_received = false;
+
+}
+
+// The reply mplayer sends for a command, as the start of a line.
+// Empty if the command is not answered.
+static QByteArray expected_reply_for(const QString &command)
+{
+    static_var char const *const pausing_prefixes[] = {
+        "pausing_keep_force ",
+        "pausing_keep ",
+        "pausing_toggle ",
+        "pausing ",
+        NULL
+    };
+
+    QByteArray cmd = command.toLatin1();
+
+    for(int i = 0; pausing_prefixes[i] != NULL; i++) {
+        if(cmd.startsWith(pausing_prefixes[i])) {
+            cmd.remove(0, int(strlen(pausing_prefixes[i])));
+            break;
+        }
+    }
+
+    if(cmd.startsWith("get_property ")) {
+        return QByteArray("GLOBAL: ANS_") + cmd.mid(13).trimmed() + '=';
+    }
+
+    if(cmd == "get_time_pos") {
+        return QByteArray("GLOBAL: ANS_TIME_POSITION=");
+    }
+
+    if(cmd == "get_time_length") {
+        return QByteArray("GLOBAL: ANS_LENGTH=");
+    }
+
+    if(cmd == "get_percent_pos") {
+        return QByteArray("GLOBAL: ANS_PERCENT_POSITION=");
+    }
+
+    if(cmd == "get_vo_fullscreen") {
+        return QByteArray("GLOBAL: ANS_VO_FULLSCREEN=");
+    }
 
+    return QByteArray();
+}
+
+void MpProcess::check_for_ack(const MpLineView &bline, const MonoTime &readtime)
+{
+    static_var char const ans_error[] = "GLOBAL: ANS_ERROR=";
+    const MpLineView tline = mpline_trimmed(bline);
+
+    const bool is_reply = (tline.len >= m_ack_expected.size() && 0 == memcmp(tline.data, m_ack_expected.constData(), m_ack_expected.size()));
+    const bool is_error = (tline.len >= int(sizeof(ans_error) - 1) && 0 == memcmp(tline.data, ans_error, sizeof(ans_error) - 1));
+
+    if(!is_reply && !is_error) {
+        return;
+    }
+
+    MYDBG("got acknowledgement \"%.*s\" after %lld msec", tline.len, tline.data, (long long)m_lastwritet.msecsTo(readtime));
+
+    if(is_reply && m_lastwritet <= readtime) {
+        // "GLOBAL: ANS_TIME_POSITION=" -> "ANS_TIME_POSITION"
+        static_var char const global[] = "GLOBAL: ";
+        QByteArray key = m_ack_expected;
+
+        if(key.startsWith(global)) {
+            key.remove(0, sizeof(global) - 1);
+        }
+
+        if(key.endsWith('=')) {
+            key.chop(1);
+        }
+
+        m_metrics.reply[key].record(m_lastwritet, readtime);
+    }
+
+    m_ack_expected.clear();
+    m_ack_received = true;
 }
 
 void MpProcess::force_cmd(const QString &cmd)
 {
-    QDateTime now = QDateTime::currentDateTimeUtc();
+    MonoTime now = MonoTime::now();
     MYDBG("force_cmd %s", qPrintable(cmd));
     MpProcessCmd mpc(mpctag_string(), cmd, now);
     m_outputq.prepend(mpc);
-    write_one_cmd(now, "forcing");
+    write_cmds(now, "forcing", 1);
 }
 
-void MpProcess::write_one_cmd(const QDateTime &now, const char *reason)
+// Writes the next queued command, and as long as nobody has to wait for it,
+// the plain commands queued after it, all in one write().
+// Seeks and queries end a batch: what follows them has to see their effect.
+void MpProcess::write_cmds(const MonoTime &now, const char *reason, int maxcmds)
 {
-    if(m_outputq.isEmpty()) {
-        return;
+    QByteArray batch;
+    QString lastcommand;
+    int ncmds = 0;
+    bool seeked = false;
+    double seektarget = (-1);
+
+    while(!m_outputq.isEmpty() && ncmds < maxcmds) {
+        if(ncmds > 0 && m_outputq.first().type() != String) {
+            break;
+        }
+
+        MpProcessCmd mpc = m_outputq.dequeue();
+        const QString command = mpc.command(*this);
+
+        if(command.isEmpty()) {
+            // allowed_to_write_now() said the delay is over, go on with what follows it
+            if(mpc.type() == Delay && ncmds == 0) {
+                continue;
+            }
+
+            break;
+        }
+
+        const qint64 writequeuelatency_ms = mpc.created().msecsTo(now);
+
+        if(writequeuelatency_ms < 0) {
+            PROGRAMMERERROR("WTF");
+        }
+
+        m_metrics.queue_wait.record(mpc.created(), now);
+
+        MYDBG("in: \"%s\" [%s] (%lu msec in Q of depth %u)", qPrintable(command), reason, (unsigned long)writequeuelatency_ms, (unsigned)m_outputq.size());
+
+        const QByteArray bcommand = command.toLocal8Bit();
+        batch += bcommand;
+        batch += '\n';
+
+        if(m_trace != NULL) {
+            trace_append(Input, now, bcommand.constData(), bcommand.size());
+        }
+
+        if(m_cfg_output_accumulator_mode & Input) {
+            if(m_cfg_acc_maxlines > 0) {
+                acc_append(Input, bcommand.constData(), bcommand.size());
+            }
+        }
+
+        lastcommand = command;
+        ncmds++;
+
+        if(mpc.type() == Seek) {
+            seeked = true;
+            seektarget = mpc.seektarget(*this);
+            break;
+        }
+
+        if(mpc.type() != String || !expected_reply_for(command).isEmpty()) {
+            break;
+        }
     }
 
-    MpProcessCmd mpc = m_outputq.dequeue();
     make_heartbeat_active_or_not();
-    const QString command = mpc.command(*this);
 
-    if(command.isEmpty()) {
+    if(ncmds == 0) {
         return;
     }
 
-    const qint64 writequeuelatency_ms = mpc.created().msecsTo(now);
-
-    if(writequeuelatency_ms < 0) {
-        PROGRAMMERERROR("WTF");
+    if(ncmds > 1) {
+        MYDBG("writing %d commands at once", ncmds);
     }
 
-    if(writequeuelatency_ms > m_max_encountered_writequeuelatency_ms) {
-        m_max_encountered_writequeuelatency_ms = writequeuelatency_ms;
+    m_lastwritet = now;
+    TIMEMYDBG("write_cmds: m_lastwritet set to now");
+
+    m_proc->write(batch);
+
+    m_ack_expected = expected_reply_for(lastcommand);
+    m_ack_received = false;
+
+    if(seeked) {
+        m_seek_writtent = now;
+        MYDBG("EMIT sig_seekedTo(%f)", seektarget);
+        emit sig_seekedTo(seektarget);
     }
+}
 
-    MYDBG("in: \"%s\" [%s] (%lu msec in Q of depth %u)", qPrintable(command), reason, (unsigned long)writequeuelatency_ms, (unsigned)m_outputq.size());
-    m_lastwritet = now;
-    TIMEMYDBG("write_one_cmd: m_lastwritet set to now");
+bool MpProcess::MpProcessCmd::is_query() const
+{
+    return m_type == String && !expected_reply_for(m_command).isEmpty();
+}
 
-    m_proc->write(command.toLocal8Bit() + '\n');
+// Folds mpc into what is already queued, returns false if it has to be queued.
+// Only looks back as far as nothing but queries come in between, so
+// everything still happens in the order it was asked for.
+bool MpProcess::coalesce_into_queue(const MpProcessCmd &mpc)
+{
+    if(mpc.type() == Seek) {
+        for(int i = m_outputq.size() - 1; i >= 0; i--) {
+            MpProcessCmd &qcmd = m_outputq[i];
 
-    if(m_cfg_output_accumulator_mode & Input) {
-        if(m_cfg_acc_maxlines > 0) {
-            MpProcessIolog iolog;
-            iolog.line = command;
-            iolog.dt = now;
-            iolog.c = Input;
-            m_acc.append(iolog);
+            if(qcmd.type() == Seek) {
+                if(qcmd.absorb_seek(mpc)) {
+                    MYDBG("merged seek into the one already queued");
+                    return true;
+                }
 
-            while(size_t(m_acc.size()) > m_cfg_acc_maxlines) {
-                m_acc.removeFirst();
+                return false;
+            }
+
+            if(!qcmd.is_query()) {
+                return false;
             }
         }
     }
+    else if(mpc.is_query()) {
+        for(int i = m_outputq.size() - 1; i >= 0; i--) {
+            const MpProcessCmd &qcmd = m_outputq[i];
 
-    if(mpc.type() == Seek) {
-        const double target = mpc.seektarget(*this);
-        MYDBG("EMIT sig_seekedTo(%f)", target);
-        emit sig_seekedTo(target);
+            if(!qcmd.is_query()) {
+                return false;
+            }
+
+            if(qcmd.string_command() == mpc.string_command()) {
+                MYDBG("not queueing \"%s\" twice", qPrintable(mpc.string_command()));
+                return true;
+            }
+        }
     }
+
+    return false;
 }
 
-bool MpProcess::allowed_to_write_now(const QDateTime &now, char const **reason)
+bool MpProcess::allowed_to_write_now(const MonoTime &now, char const **reason)
 {
     if(m_lastwritet.isNull()) {
         *reason = "first command";
@@ -484,6 +705,24 @@ bool MpProcess::allowed_to_write_now(const QDateTime &now, char const **reason)
         }
     }
 
+    // the previous command was answered, mplayer is ready for the next one
+    if(m_ack_received) {
+        *reason = "previous command acknowledged";
+        return true;
+    }
+
+    // an answer is on its way, do not second guess it with the read timing
+    if(!m_ack_expected.isEmpty()) {
+        if(ms_since_last_write > allow_writes_even_if_no_read_ms) {
+            *reason = "no acknowledgement within allow_writes_even_if_no_read_ms";
+            return true;
+        }
+
+        *reason = "waiting for acknowledgement";
+        return false;
+    }
+
+    // the timing heuristics below are for commands mplayer does not answer
     if(m_outputq.size() >= output_queue_large_size && ms_since_last_write > allow_writes_even_if_no_read_ms / 2) {
         *reason = "large queue and last write more than allow_writes_even_if_no_read_ms/2 ago";
         return true;
@@ -518,7 +757,7 @@ bool MpProcess::allowed_to_write_now(const QDateTime &now, char const **reason)
     return false;
 }
 
-void MpProcess::try_to_write(const QDateTime &now)
+void MpProcess::try_to_write(const MonoTime &now)
 {
 
     unsigned i = 0;
@@ -531,17 +770,17 @@ void MpProcess::try_to_write(const QDateTime &now)
 
         char const *reason;
 
-        QDateTime writetime;
+        MonoTime writetime;
 
         if(i == 0) {
             writetime = now;
         }
         else {
-            writetime = QDateTime::currentDateTimeUtc();
+            writetime = MonoTime::now();
         }
 
         if(allowed_to_write_now(writetime, &reason)) {
-            write_one_cmd(writetime, reason);
+            write_cmds(writetime, reason, max_commands_per_write);
         }
         else {
             TIMEMYDBG("try_to_write: %s", reason);
@@ -555,34 +794,18 @@ void MpProcess::try_to_write(const QDateTime &now)
 void MpProcess::slot_try_to_write_now()
 {
     MYDBG("slot_try_to_write_now");
-    QDateTime now = QDateTime::currentDateTimeUtc();
+    MonoTime now = MonoTime::now();
     //TIMEMYDBG("try_to_write_now");
     try_to_write(now);
 }
 
-void MpProcess::slot_submit_write(const MpProcessCmd &mpc, const QDateTime &submittime)
+void MpProcess::slot_submit_write(const MpProcessCmd &mpc, const MonoTime &submittime)
 {
     MYDBG("slot_submit_write(MpProcessCmd)");
     Q_UNUSED(submittime);
 
-    // if this is a Seek, and there are already seeks in here, do not submit a duplicate
-    if(0 && mpc.type() == Seek) {
-        double thistarget = mpc.seektarget(*this);
-
-        // if such a target already exists, do not put it in
-        foreach(const MpProcessCmd &qcmd, m_outputq) {
-            if(qcmd.type() != Seek) {
-                continue;
-            }
-
-            double qtarget = qcmd.seektarget(*this);
-
-            if(qAbs(qtarget - thistarget) < 0.1) {
-                QDateTime now = QDateTime::currentDateTimeUtc();
-                MYDBG("not submitting duplicate seek to %f", thistarget);
-                return;
-            }
-        }
+    if(coalesce_into_queue(mpc)) {
+        return;
     }
 
     m_outputq.enqueue(mpc);
@@ -597,33 +820,33 @@ void MpProcess::slot_submit_write(const MpProcessCmd &mpc, const QDateTime &subm
         return;
     }
 
-    qWarning() << "output queue size is " << m_outputq.size() << "! Will try to empty it";
+    if(m_flushtimer.isActive()) {
+        return;
+    }
 
-    unsigned i = 0;
+    qWarning() << "output queue size is " << m_outputq.size() << "! Will try to empty it";
 
     // try to empty within one second, but not slower than one per min_time_between_writes_ms / 3
-    const useconds_t sleeptime = qMin(useconds_t(1000000 / m_outputq.size()), useconds_t(min_time_between_writes_ms / 3));
-
-    while(!m_outputq.isEmpty()) {
-        QDateTime now = QDateTime::currentDateTimeUtc();
-        write_one_cmd(now, "too large output queue");
-        usleep(sleeptime);
-        // might have accumulated output in the meantime
-        MYDBG("call direct slot_readStdout");
-        slot_readStdout();
-        MYDBG("call direct slot_readStderr");
-        slot_readStderr();
-        i++;
-
-        if(i > 2 * output_queue_max_size) {
-            PROGRAMMERERROR("WTF");
-        }
+    const int interval_msec = qMax(1, qMin(int(1000 / m_outputq.size()), int(min_time_between_writes_ms / 3)));
+    m_flushtimer.start(interval_msec);
+}
+
+void MpProcess::slot_flush_output_queue()
+{
+    if(m_outputq.isEmpty()) {
+        MYDBG("output queue is flushed");
+        m_flushtimer.stop();
+        return;
     }
+
+    MonoTime now = MonoTime::now();
+    write_cmds(now, "too large output queue", max_commands_per_write);
+
 }
 void MpProcess::slot_submit_write(const QString &command)
 {
     MYDBG("slot_submit_write(%s)", qPrintable(command));
-    QDateTime submitted = QDateTime::currentDateTimeUtc();
+    MonoTime submitted = MonoTime::now();
 
     MpProcessCmd mpc(mpctag_string(), command, submitted);
     slot_submit_write(mpc, submitted);
@@ -636,7 +859,7 @@ void MpProcess::slot_submit_write_latin1(char const *const latin1lit)
 void MpProcess::slot_osd_show_location()
 {
     MYDBG("slot_osd_show_location");
-    QDateTime now = QDateTime::currentDateTimeUtc();
+    MonoTime now = MonoTime::now();
     MpProcessCmd mpc(mpctag_osdsl(), now);
     slot_submit_write(mpc, now);
 }
@@ -650,7 +873,7 @@ void MpProcess::slot_osd_show_location()
  */
 void MpProcess::slot_seek_from_slider(int position)
 {
-    QDateTime now = QDateTime::currentDateTimeUtc();
+    MonoTime now = MonoTime::now();
     MYDBG("slot_seek_from_slider(%d)", position);
 
     const double pos = expectedPositionAt(now, false);
@@ -687,7 +910,7 @@ void MpProcess::slot_abs_seek_from_keyboard(double position)
  */
 void MpProcess::core_seek(double offset, SeekMode whence)
 {
-    QDateTime now = QDateTime::currentDateTimeUtc();
+    MonoTime now = MonoTime::now();
 
     MpProcessCmd mpc(mpctag_seek(), whence, offset, now);
     slot_submit_write(mpc, now);
@@ -713,6 +936,10 @@ void MpProcess::foundReadSpeed(double rspeed)
     }
 
     m_curr_speed = rspeed;
+
+    if(rspeed > 0) {
+        m_estimator.set_speed(rspeed, MonoTime::now());
+    }
 }
 
 void MpProcess::slot_speed_up()
@@ -789,12 +1016,12 @@ void MpProcess::slot_pause()
 
     if(m_curr_state == MpState::PlayingState) {
         slot_submit_write_latin1("pause");
-        QDateTime now = QDateTime::currentDateTimeUtc();
+        MonoTime now = MonoTime::now();
         changeState(MpState::PausedState, now);
     }
 
     slot_submit_write_latin1("pausing_keep_force get_property pause");
-    slot_submit_write_latin1("pausing_keep_force get_time_pos");
+    ask_position_unless_confident();
 }
 
 void MpProcess::slot_play()
@@ -803,195 +1030,326 @@ void MpProcess::slot_play()
 
     if(m_curr_state == MpState::PausedState) {
         slot_submit_write_latin1("pause");
-        QDateTime now = QDateTime::currentDateTimeUtc();
+        MonoTime now = MonoTime::now();
         changeState(MpState::PlayingState, now);
     }
 
     slot_submit_write_latin1("pausing_keep_force get_property pause");
+    ask_position_unless_confident();
+}
+
+// the estimate is good enough most of the time, save the round trip
+void MpProcess::ask_position_unless_confident()
+{
+    const double uncertainty = m_estimator.uncertainty_secs(MonoTime::now());
+
+    if(uncertainty <= ask_position_if_uncertainty_above_sec) {
+        MYDBG("position known to within %f secs, not asking", uncertainty);
+        return;
+    }
+
     slot_submit_write_latin1("pausing_keep_force get_time_pos");
 }
 
 void MpProcess::slot_stop()
 {
     MYDBG("slot_stop");
+    cancel_transition();
     m_outputq.clear();
     force_cmd(QStringLiteral("stop"));
     m_cfg_currently_parsing_mplayer_text = false;
-    usleep(sleep_after_stop_command_msec * 1000);
-    m_proc->waitForReadyRead(waitforreadyread_after_stop_command_msec); // force a buffer flush and wait even longer
-    QCoreApplication::processEvents();
+    // the rest happens in finish_stop(), once mplayer is done talking
+    begin_transition(Transition::Stopping, stop_quiet_msec, stop_max_msec);
+}
+
+void MpProcess::finish_stop()
+{
     clear_out_incremental_stdouterr();
-    QDateTime now = QDateTime::currentDateTimeUtc();
+    MonoTime now = MonoTime::now();
     TIMEMYDBG("stop");
     changeState(MpState::StoppedState, now);
 }
 
-void MpProcess::clear_out_incremental_stdouterr()
+// Waits for mplayer output to settle without blocking: every read restarts
+// the quiet timer, and slot_transition_settled() is called once it fires
+// or max_msec have passed.
+void MpProcess::begin_transition(Transition t, int quiet_msec, int max_msec)
+{
+    m_transition = t;
+    m_transition_quiettimer.start(quiet_msec);
+    m_transition_maxtimer.start(max_msec);
+}
+
+// A new stop or load does not wait for the previous one. A pending stop is
+// finished right away, a pending load is dropped.
+void MpProcess::cancel_transition()
+{
+    if(m_probe != NULL) {
+        MYDBG("dropping the pending load of %s", qPrintable(m_pending_loadcmd));
+        cancel_probe();
+        m_pending_loadcmd.clear();
+        m_pending_aftercmds.clear();
+    }
+
+    if(m_transition == Transition::None) {
+        return;
+    }
+
+    if(m_transition == Transition::Stopping) {
+        MYDBG("finishing the pending stop right away");
+        slot_transition_settled();
+        return;
+    }
+
+    MYDBG("dropping the pending load of %s", qPrintable(m_pending_loadcmd));
+    m_transition_quiettimer.stop();
+    m_transition_maxtimer.stop();
+    m_transition = Transition::None;
+    m_pending_loadcmd.clear();
+    m_pending_aftercmds.clear();
+}
+
+void MpProcess::slot_transition_settled()
+{
+    m_transition_quiettimer.stop();
+    m_transition_maxtimer.stop();
+
+    const Transition t = m_transition;
+    m_transition = Transition::None;
+
+    switch(t) {
+        case Transition::Stopping:
+            finish_stop();
+            break;
+
+        case Transition::DrainingBeforeLoad:
+            finish_load();
+            break;
+
+        case Transition::None:
+            break;
+    }
+}
+
+static QString MLVToQString(const MpLineView &v)
 {
-    slot_readStdout();
-    slot_readStderr();
+    return warn_xbin_2_local_qstring(QByteArray::fromRawData(v.data, v.len));
+}
 
-    if(m_not_yet_processed_out.size() > 0) {
-        proc_incremental_std(m_not_yet_processed_out, Output);
-        m_not_yet_processed_out.clear();
+// reuses the oldest slot and its buffer once the ring is full
+void MpProcess::acc_append(IOChannel c, char const *data, int len)
+{
+    MpProcessIolog &iolog = m_acc.append_slot();
+    iolog.line.resize(len);
+    memcpy(iolog.line.data(), data, len);
+    iolog.c = c;
+    iolog.t = MonoTime::now();
+}
+
+void MpProcess::trace_open()
+{
+    if(m_cfg_tracefile.isEmpty() || m_trace != NULL) {
+        return;
     }
 
+    // every mplayer started gets a trace of its own
+    m_trace = fopen(QFile::encodeName(m_cfg_tracefile).constData(), "w");
 
-    if(m_not_yet_processed_err.size() > 0) {
-        proc_incremental_std(m_not_yet_processed_err, Error);
-        m_not_yet_processed_err.clear();
+    if(m_trace == NULL) {
+        qWarning("could not open trace file %s: %s", qPrintable(m_cfg_tracefile), strerror(errno));
+        return;
     }
+
+    m_trace_start = MonoTime::now();
+    MYDBG("tracing mplayer I/O to %s", qPrintable(m_cfg_tracefile));
 }
 
-void MpProcess::clear_out_iobuffer_before_load()
+void MpProcess::trace_close()
 {
-    m_proc->waitForReadyRead(beforeload_waitForReadyRead_1_msec);
-    usleep(beforeload_sleep_msec * 1000);
-    QCoreApplication::processEvents();
-    QByteArray b;
-    b = m_proc->readAllStandardOutput();
-    b = m_proc->readAllStandardError();
-    m_proc->waitForReadyRead(beforeload_waitForReadyRead_2_msec);
-    QCoreApplication::processEvents();
-    b = m_proc->readAllStandardOutput();
-    b = m_proc->readAllStandardError();
+    if(m_trace == NULL) {
+        return;
+    }
+
+    fclose(m_trace);
+    m_trace = NULL;
 }
 
-void MpProcess::dbg_out(char const *pref, const QString &line)
+void MpProcess::trace_append(IOChannel c, const MonoTime &t, char const *data, int len)
+{
+    // reads can be stamped before the trace was opened
+    const qint64 msecs = qMax(Q_INT64_C(0), m_trace_start.msecsTo(t));
+    const char cc = (c == Input ? 'I' : (c == Output ? 'O' : 'E'));
+    fprintf(m_trace, "%lld %c %.*s\n", (long long)msecs, cc, len, data);
+}
+
+void MpProcess::clear_out_incremental_stdouterr()
+{
+    slot_pipe_lines_ready();
+
+    // whatever partial line is left over arrives as a line of its own later
+    m_pipereader->terminate_partial_lines();
+}
+
+#ifdef CAUTION
+// the classifier has to agree with the regular expressions it replaces
+static void check_noise_against_regex(const QString &line, unsigned noise)
 {
     static_var const VRegularExpression rx_statusline((QLatin1String("(") + QLatin1String(statusline_rxlit) + QLatin1String(")")));
     static_var const VRegularExpression rx_crap((QLatin1String("(") + QLatin1String(crap_rxlit) + QLatin1String(")")));
 
-    if(line.indexOf(rx_crap) >= 0) {
-        MYDBGCRAP("%s: \"%s\"", pref, qPrintable(line));
+    const bool is_crap = (line.indexOf(rx_crap) >= 0);
+    const bool is_status = (line.indexOf(rx_statusline) >= 0);
+
+    if(is_crap != bool(noise & MpNoiseCrap) || is_status != bool(noise & MpNoiseStatus)) {
+        PROGRAMMERERROR("noise classifier says %u for \"%s\"", noise, qPrintable(line));
     }
-    else if(line.indexOf(rx_statusline) >= 0) {
-        //MYDBGSTATUS("%s: \"%s\"", pref, qPrintable(line));
+}
+#endif
+
+void MpProcess::dbg_out(char const *pref, const MpLineView &bline, unsigned noise)
+{
+#ifdef CAUTION
+    check_noise_against_regex(MLVToQString(bline), noise);
+#endif
+
+    if(noise & MpNoiseCrap) {
+        if(categorycrap().isDebugEnabled()) {
+            MYDBGCRAP("%s: \"%s\"", pref, qPrintable(MLVToQString(bline)));
+        }
+    }
+    else if(noise & MpNoiseStatus) {
+        //MYDBGSTATUS("%s: \"%s\"", pref, qPrintable(MLVToQString(bline)));
     }
     else {
-        MYDBG("%s: \"%s\"", pref, qPrintable(line));
+        if(category().isDebugEnabled()) {
+            MYDBG("%s: \"%s\"", pref, qPrintable(MLVToQString(bline)));
+        }
     }
 }
 
 void MpProcess::set_output_accumulator_ignore_default()
 {
-    const size_t pattlen = 1 + strlen(statusline_rxlit) + 1 + strlen(crap_rxlit) + 1 + 1;
-    char *patt = new char[pattlen];
-    strcpy(patt, "(");
-    strcat(patt, statusline_rxlit);
-    strcat(patt, "|");
-    strcat(patt, crap_rxlit);
-    strcat(patt, ")");
-    MYDBG("ignoring all MP output matching \"%s\"", patt);
-    set_output_accumulator_ignore(patt);
-    delete[] patt;
+    MYDBG("ignoring all MP output matching \"(%s|%s)\"", statusline_rxlit, crap_rxlit);
+    set_output_accumulator_ignore((char const *)NULL);
+    m_cfg_acc_ignore_noise = true;
 }
 
-void MpProcess::proc_incremental_std(const QByteArray &bytes, IOChannel c)
+// the lines of one read() by the pipe reader
+void MpProcess::proc_read_lines()
 {
-    if(bytes.isEmpty()) {
+    MpPipeLine *pl = m_pipereader->front();
+
+    if(pl == NULL) {
         return;
     }
 
-    //MYDBG("START proc_incremental_std");
+    //MYDBG("START proc_read_lines");
 
-    QDateTime readtime = QDateTime::currentDateTimeUtc();
-    //TIMEMYDBG("proc_incremental_std");
+    const int rawc = pl->c;
+    const IOChannel c = (rawc == MpPipeReader::Out ? Output : Error);
+    const MonoTime readtime = pl->t;
+    //TIMEMYDBG("proc_read_lines");
 
-    QByteArray *arr = (c == Output ? &m_not_yet_processed_out : &m_not_yet_processed_err);
-    arr->append(bytes);
+    if(note_read_during_transition()) {
+        for(; pl != NULL && pl->c == rawc && pl->t == readtime; pl = m_pipereader->front()) {
+            const bool last = pl->last_of_read;
+            m_pipereader->pop();
 
-    QStringList lines;
-    bool found_valid = false;
+            if(last) {
+                break;
+            }
+        }
 
-    //MYDBG("START accumulate loop");
+        return;
+    }
 
-    while(true) {
-        const int idxn = arr->indexOf('\n');
-        const int idxr = arr->indexOf('\r');
+    bool found_valid = false;
 
-        if(idxn < 0 && idxr < 0) {
-            break;
-        }
+    QByteArray positionline;
+    MpParsedLine positionparsed;
+    QList<MpState> newstates;
+    QStringList errorreasons;
+    QList<double> foundspeeds;
 
-        int idx;
+    //MYDBG("START accumulate loop");
 
-        if(idxn < 0) {
-            idx = idxr;
-        }
-        else if(idxr < 0) {
-            idx = idxn;
-        }
-        else {
-            idx = (idxr < idxn ? idxr : idxn);
-        }
+    // nobody looks at the noise class if all of these are off
+    const bool want_dbg = category().isDebugEnabled() || categorycrap().isDebugEnabled();
+    const bool want_acc = (m_cfg_acc_maxlines > 0 && (m_cfg_output_accumulator_mode & c));
+    const bool want_noise = want_dbg || (want_acc && m_cfg_acc_ignore_noise);
 
-        const QByteArray bline = arr->left(idx);
-        arr->remove(0, idx + 1);
+    // a read() that filled the ring might come in several pieces
+    for(; pl != NULL && pl->c == rawc && pl->t == readtime; pl = m_pipereader->front()) {
+        MpLineView bline;
+        bline.data = pl->line.constData();
+        bline.len = pl->line.size();
 
-        QString line = warn_xbin_2_local_qstring(bline);
-        line.remove(QLatin1String("\r"));
+        if(m_trace != NULL) {
+            trace_append(c, readtime, bline.data, bline.len);
+        }
 
-        if(line.size() < 1) {
-            continue;
+        if(!m_ack_expected.isEmpty()) {
+            check_for_ack(bline, readtime);
         }
 
-        dbg_out(c == Output ? "out" : "err", line);
+        const unsigned noise = (want_noise ? mpnoise_classify(bline) : unsigned(MpNoiseNone));
 
-        if(m_cfg_acc_maxlines > 0) {
-            if(m_cfg_output_accumulator_mode & c) {
-                if(m_cfg_rx_output_accumulator_ignore == NULL || line.indexOf(*m_cfg_rx_output_accumulator_ignore) < 0) {
-                    MpProcessIolog iolog;
-                    iolog.line = line;
-                    iolog.c = c;
-                    iolog.dt = readtime;
-                    m_acc.append(iolog);
+        if(want_dbg) {
+            dbg_out(c == Output ? "out" : "err", bline, noise);
+        }
 
-                    while(size_t(m_acc.size()) > m_cfg_acc_maxlines) {
-                        m_acc.removeFirst();
-                    }
-                }
+        if(want_acc && !(m_cfg_acc_ignore_noise && noise != MpNoiseNone)) {
+            if(m_cfg_rx_output_accumulator_ignore == NULL) {
+                acc_append(c, bline.data, bline.len);
+            }
+            else if(MLVToQString(bline).indexOf(*m_cfg_rx_output_accumulator_ignore) < 0) {
+                // only decoded if there is a custom pattern to match
+                acc_append(c, bline.data, bline.len);
             }
         }
 
-        lines.append(line);
-
-        if(!line.contains(QLatin1String(": ["))) {
+        if(!found_valid && !mpline_contains(bline, ": [")) {
             found_valid = true;
+            update_lastreadt(readtime);
         }
 
-    }
-
-    //MYDBG("END accumulate loop");
-
-    if(found_valid) {
-        update_lastreadt(readtime);
-    }
-
-    QStringList positionlines;
-    QList<MpState> newstates;
-    QStringList errorreasons;
-    QList<double> foundspeeds;
-
-    foreach(const QString &line, lines) {
         /* might
             * slot_submit_write()
             * go to error state and emit error string
             * emit loaddone
             * change m_mediainfo
         */
-        parseLine(line, positionlines, newstates, errorreasons, foundspeeds);
+        const MonoTime parsestart = MonoTime::now();
+        const MpLineKind kind = parseLine(bline, pl->parsed, positionline, positionparsed, newstates, errorreasons, foundspeeds);
+        // the reader thread did the parsing, this is acting on it
+        const qint64 parse_nsecs = pl->parsed.nsecs + (MonoTime::now().nsecs() - parsestart.nsecs());
+
+        // noise is only told apart if it was classified anyway, see above
+        m_metrics.count_parse(MpMetrics::parse_category_of(kind, noise), bline.len, parse_nsecs);
+
+        // bline is gone after this
+        const bool last = pl->last_of_read;
+        m_pipereader->pop();
 
+        if(last) {
+            break;
+        }
     }
 
+    //MYDBG("END accumulate loop");
+
     if(!newstates.isEmpty()) {
         MpState newstate = newstates.last();
         changeState(newstate, readtime);
     }
 
-    if(!positionlines.isEmpty()) {
-        QString lastpositionline = positionlines.last();
-        parsePosition(lastpositionline, readtime);
+    if(!positionline.isEmpty()) {
+        MpLineView pline;
+        pline.data = positionline.constData();
+        pline.len = positionline.size();
+        const MonoTime posstart = MonoTime::now();
+        parsePosition(pline, positionparsed, readtime);
+        m_metrics.count_parse(MpMetrics::ParsePosition, pline.len, MonoTime::now().nsecs() - posstart.nsecs());
     }
 
     if(!errorreasons.isEmpty()) {
@@ -1011,29 +1369,45 @@ void MpProcess::proc_incremental_std(const QByteArray &bytes, IOChannel c)
         }
     }
 
-    //MYDBG("END proc_incremental_std");
+    //MYDBG("END proc_read_lines");
 }
 
-void MpProcess::slot_readStdout()
+// true if the lines should not be looked at
+bool MpProcess::note_read_during_transition()
 {
-    //MYDBG("slot_readStdout");
-    const QByteArray bytes = m_proc->readAllStandardOutput();
-    proc_incremental_std(bytes, Output);
-    //MYDBG("DONE slot_readStdout");
+    if(m_transition == Transition::None) {
+        return false;
+    }
+
+    // not quiet yet
+    m_transition_quiettimer.start();
+
+    if(m_transition == Transition::DrainingBeforeLoad) {
+        MYDBG("dropping output before load");
+        return true;
+    }
+
+    return false;
 }
 
-void MpProcess::slot_readStderr()
+void MpProcess::slot_pipe_lines_ready()
 {
-    MYDBG("slot_readStderr");
-    const QByteArray bytes = m_proc->readAllStandardError();
-    proc_incremental_std(bytes, Error);
-    MYDBG("DONE slot_readStderr");
+    if(m_pipereader == NULL) {
+        return;
+    }
+
+    // lines published from now on get a new signal
+    m_pipereader->consumer_notified();
+
+    while(m_pipereader->front() != NULL) {
+        proc_read_lines();
+    }
 }
 
 void MpProcess::slot_error_received(QProcess::ProcessError e)
 {
     const QString err = QLatin1String(ProcessError_2_latin1str(e));
-    QDateTime now = QDateTime::currentDateTimeUtc();
+    MonoTime now = MonoTime::now();
     TIMEMYDBG("slot_error_received(%s) - letting slot_finished handle it", qPrintable(err));
     return;
     m_proc->disconnect(this);
@@ -1044,7 +1418,7 @@ void MpProcess::slot_error_received(QProcess::ProcessError e)
 
 void MpProcess::slot_finished(int exitcode, QProcess::ExitStatus exitStatus)
 {
-    QDateTime now = QDateTime::currentDateTimeUtc();
+    MonoTime now = MonoTime::now();
     MYDBG("slot_finished(exitcode %d status %s)", exitcode, (exitStatus == QProcess::NormalExit ? "normal" : "crash"));
 
     m_proc->disconnect(this);
@@ -1102,7 +1476,7 @@ void MpProcess::slot_quit_if_we_are_not_playing_yet()
         return;
     }
 
-    const QDateTime now = QDateTime::currentDateTimeUtc();
+    const MonoTime now = MonoTime::now();
     MYDBG("quit_if_we_are_not_playing_yet");
     const QString msg = QString(QStringLiteral("playback did not start, waited %1 msecs")).arg(m_loadingtimer.elapsed());
     changeToErrorState(msg, now);
@@ -1114,15 +1488,52 @@ static inline T MIN(const T a, const T b)
     if(a < b) {
         return a;
     }
-    else {
-        return b;
+    else {
+        return b;
+    }
+}
+void MpProcess::slot_load(const QString &url)
+{
+    MYDBG("slot_load(%s)", qPrintable(url));
+    begin_load(url, QStringList(), ProbeStage::Sustain);
+}
+
+void MpProcess::slot_load_prepared(const QString &url)
+{
+    MYDBG("slot_load_prepared(%s)", qPrintable(url));
+    begin_load(url, QStringList(), ProbeStage::Access);
+}
+
+void MpProcess::slot_resume(const QString &url, double startpos, int aid, int sid)
+{
+    MYDBG("slot_resume(%s, %f, %d, %d)", qPrintable(url), startpos, aid, sid);
+
+    QStringList aftercmds;
+
+    if(startpos > 0) {
+        aftercmds += QString(QStringLiteral("seek %1 2")).arg(startpos, 0, 'f', 3);
+    }
+
+    if(aid >= 0) {
+        aftercmds += QString(QStringLiteral("switch_audio %1")).arg(aid);
+        // resetValues() forgets the aid, read it back
+        aftercmds += QStringLiteral("get_property switch_audio");
     }
+
+    if(sid >= 0) {
+        aftercmds += QString(QStringLiteral("sub_demux %1")).arg(sid);
+    }
+
+    // the file was readable a moment ago, but a mount that hung meanwhile
+    // may be why mplayer died: only the quick access probe then
+    begin_load(url, aftercmds, ProbeStage::Access);
 }
-void MpProcess::slot_load(const QString &url)
+
+void MpProcess::begin_load(const QString &url, const QStringList &aftercmds, ProbeStage probe_upto)
 {
-    MYDBG("slot_load(%s)", qPrintable(url));
     Q_ASSERT_X(m_proc->state() != QProcess::NotRunning, "QMPProcess::load()", "MPlayer process not started yet");
 
+    cancel_transition();
     m_outputq.clear();
 
     // From the MPlayer slave interface documentation:
@@ -1146,49 +1557,180 @@ void MpProcess::slot_load(const QString &url)
         }
     }
 
-    if(preloading_file_KBytes > 0) {
-        const QString load_start_error = try_load_start_of_file(url
-                                         , preloading_file_KBytes * 1024
-                                         , 1000 * preloading_file_timeout_sec
-                                         , 10 * preloading_file_timeout_sec
-                                                               );
+    m_pending_loadcmd = QString(QStringLiteral("loadfile %1%2%1")).arg(sep).arg(url);
+    m_pending_aftercmds = aftercmds;
 
-        if(!load_start_error.isEmpty()) {
-            QDateTime now = QDateTime::currentDateTimeUtc();
-            changeToErrorState(load_start_error, now);
-            return;
+    if(probe_upto != ProbeStage::None) {
+        // continue_load() follows once the file turned out to be readable
+        m_probe_url = url;
+        m_probe_last_stage = probe_upto;
+        start_probe(ProbeStage::Access);
+        return;
+    }
+
+    continue_load();
+}
+
+MpProcess::ProbeStage MpProcess::next_probe_stage(ProbeStage stage) const
+{
+    if(stage == m_probe_last_stage) {
+        return ProbeStage::None;
+    }
+
+    return (stage == ProbeStage::Access ? ProbeStage::Sustain : ProbeStage::None);
+}
+
+// Starts reading the start of m_probe_url for the given stage, or the next
+// stage if this one is switched off. Without a stage left, continues the load.
+void MpProcess::start_probe(ProbeStage stage)
+{
+    off_t readsize = 0;
+    qint64 timeout_msec = 0;
+
+    switch(stage) {
+        case ProbeStage::Access:
+            readsize = preloading_file_KBytes * 1024;
+            timeout_msec = 1000 * preloading_file_timeout_sec;
+            break;
+
+        case ProbeStage::Sustain: {
+            const ReadPlan plan = plan_reading(m_probe_url, m_mediaInfo->total_bitrate(), false);
+            readsize = plan.sustain_bytes;
+            timeout_msec = plan.sustain_timeout_msec;
+            break;
         }
+
+        case ProbeStage::None:
+            break;
+    }
+
+    if(stage == ProbeStage::None) {
+        m_probestage = ProbeStage::None;
+        m_probe_url.clear();
+        m_probe_identity = FileIdentity();
+        continue_load();
+        return;
+    }
+
+    m_probestage = stage;
+
+    if(readsize <= 0) {
+        start_probe(next_probe_stage(stage));
+        return;
+    }
+
+    m_probe = new AsyncProbe(this, m_probe_url, false, readsize, timeout_msec);
+    XCONNECT(m_probe, SIGNAL(sig_done()), this, SLOT(slot_probe_done()), QUEUEDCONN);
+}
+
+void MpProcess::cancel_probe()
+{
+    if(m_probe != NULL) {
+        m_probe->disconnect(this);
+        m_probe->deleteLater();
+        m_probe = NULL;
     }
 
-    QCoreApplication::processEvents();
+    m_probestage = ProbeStage::None;
+    m_probe_url.clear();
+    m_probe_identity = FileIdentity();
+}
+
+void MpProcess::slot_probe_done()
+{
+    // a cancelled probe can still have its signal queued
+    if(m_probe == NULL || sender() != m_probe || !m_probe->is_done()) {
+        MYDBG("slot_probe_done: stale, ignored");
+        return;
+    }
+
+    const QStringList errors = m_probe->errors();
+    const ProbeStage stage = m_probestage;
+    const qint64 elapsed_msec = m_probe->elapsed_msec();
+    const FileIdentity identity = m_probe->identity();
+    // unknown when it was not the probe helper reading
+    const qint64 bytes_read = m_probe->bytes_read();
+    const bool was_cached = m_probe->was_cached();
+    m_probe->deleteLater();
+    m_probe = NULL;
 
-    if(sustain_file_KBytes > 0) {
-        const qint64 failafter_msec = (1000 * sustain_file_KBytes) / sustain_read_file_min_speed_kB_per_sec;
+    if(errors.isEmpty()) {
+        if(stage == ProbeStage::Access) {
+            mount_throughput_record_latency(m_probe_url, was_cached, elapsed_msec);
+        }
+        else {
+            mount_throughput_record_speed(m_probe_url, bytes_read, was_cached, elapsed_msec);
+        }
+    }
 
-        const qint64 sleep_usec = failafter_msec * 10;
+    if(!errors.isEmpty()) {
+        const QString load_start_error = errors.join(QStringLiteral("; "));
+        probe_cache_forget(identity.is_known() ? identity : m_probe_identity);
+        cancel_probe();
+        m_pending_loadcmd.clear();
+        m_pending_aftercmds.clear();
+        MonoTime now = MonoTime::now();
+        changeToErrorState(load_start_error, now);
+        return;
+    }
 
-        const QString load_start_error = try_load_start_of_file(url, sustain_file_KBytes * 1024, failafter_msec, sleep_usec);
+    if(stage == ProbeStage::Access) {
+        m_probe_identity = identity;
 
-        if(!load_start_error.isEmpty()) {
-            QDateTime now = QDateTime::currentDateTimeUtc();
-            changeToErrorState(load_start_error, now);
+        if(probe_cache_has_sustained(m_probe_identity)) {
+            MYDBG("%s read fine recently, not probing it again", qPrintable(m_probe_url));
+            start_probe(ProbeStage::None);
             return;
         }
     }
+    else if(stage == ProbeStage::Sustain) {
+        probe_cache_record_sustained(m_probe_url, (identity.is_known() ? identity : m_probe_identity));
+    }
+
+    start_probe(next_probe_stage(stage));
+}
+
+void MpProcess::continue_load()
+{
+    if(m_proc->state() == QProcess::NotRunning) {
+        MYDBG("mplayer went away while probing, not loading %s", qPrintable(m_pending_loadcmd));
+        m_pending_loadcmd.clear();
+        m_pending_aftercmds.clear();
+        return;
+    }
+
+    // drop what mplayer still has to say about the previous file,
+    // finish_load() continues once it is quiet
+    m_pipereader->drop_partial_lines();
+    begin_transition(Transition::DrainingBeforeLoad, beforeload_quiet_msec, beforeload_max_msec);
+}
+
+void MpProcess::finish_load()
+{
+    const QString loadcmd = m_pending_loadcmd;
+    const QStringList aftercmds = m_pending_aftercmds;
+    m_pending_loadcmd.clear();
+    m_pending_aftercmds.clear();
 
-    QCoreApplication::processEvents();
+    if(loadcmd.isEmpty()) {
+        PROGRAMMERERROR("WTF");
+    }
 
-    clear_out_iobuffer_before_load();
     resetValues();
 
-    changeState(MpState::LoadingState, QDateTime::currentDateTimeUtc());
+    changeState(MpState::LoadingState, MonoTime::now());
 
     resetValues();
     m_cfg_currently_parsing_mplayer_text = true;
-    slot_submit_write(QString(QStringLiteral("loadfile %1%2%1")).arg(sep).arg(url));
+    slot_submit_write(loadcmd);
+
+    foreach(const QString &cmd, aftercmds) {
+        slot_submit_write(cmd);
+    }
+
     m_loadingtimer.start();
 
-    QDateTime now = QDateTime::currentDateTimeUtc();
+    MonoTime now = MonoTime::now();
     TIMEMYDBG("load");
     m_dont_trust_time_from_statusline_till = now.addMSecs(ignore_statusline_after_load_ms);
     m_previous_seek_direction_is_fwd = true;
@@ -1198,29 +1740,6 @@ void MpProcess::slot_load(const QString &url)
 
 }
 
-static int QSToInt(const QString &s)
-{
-    bool ok = false;
-    int ret = s.toInt(&ok);
-
-    if(ok == false) {
-        PROGRAMMERERROR("could not convert \"%s\" to int", qPrintable(s));
-    }
-
-    return ret;
-}
-static double QSToDouble(const QString &s)
-{
-    bool ok = false;
-    double ret = s.toDouble(&ok);
-
-    if(ok == false) {
-        PROGRAMMERERROR("could not convert \"%s\" to double", qPrintable(s));
-    }
-
-    return ret;
-}
-
 void MpProcess::slot_mute()
 {
     MYDBG("slot_mute");
@@ -1236,255 +1755,213 @@ void MpProcess::slot_unmute()
     slot_submit_write_latin1("get_property mute");
 }
 
-void MpProcess::parseLine(const QString &line, QStringList &positionlines, QList<MpState> &newstates, QStringList &errorreasons, QList<double> &foundspeeds)
+static int parsed_int(const MpLineView &tline, const MpParsedLine &parsed)
 {
-    const QString tline = line.trimmed();
+    if(!parsed.ok) {
+        PROGRAMMERERROR("could not convert \"%.*s\" to int", tline.len, tline.data);
+    }
 
-    if(!m_cfg_currently_parsing_mplayer_text) {
-        MYDBG("ignoring \"%s\" from mplayer", qPrintable(line));
-        return;
+    return parsed.ivalue;
+}
+static double parsed_double(const MpLineView &tline, const MpParsedLine &parsed)
+{
+    if(!parsed.ok) {
+        PROGRAMMERERROR("could not convert \"%.*s\" to double", tline.len, tline.data);
     }
 
+    return parsed.dvalue;
+}
 
-    if(tline.startsWith(QLatin1String("Playing "))) {
+MpLineKind MpProcess::parseLine(const MpLineView &line, const MpParsedLine &parsed, QByteArray &positionline, MpParsedLine &positionparsed, QList<MpState> &newstates, QStringList &errorreasons, QList<double> &foundspeeds)
+{
+    if(!m_cfg_currently_parsing_mplayer_text) {
+        MYDBG("ignoring \"%.*s\" from mplayer", line.len, line.data);
+        return MpLineKind::Ignored;
     }
 
-    else if(tline == QLatin1String("GLOBAL: ANS_pause=no")) {
-        if(m_curr_state == MpState::PausedState) {
-            newstates.append(MpState::PlayingState);
-            MYDBG("got ANS_pause=no, guessing on PlayingState");
-        }
-    }
-    else if(tline == QLatin1String("GLOBAL: ANS_pause=yes")) {
-        if(m_curr_state == MpState::PlayingState) {
-            newstates.append(MpState::PausedState);
-            MYDBG("got ANS_pause=yes, guessing on PausedState");
-        }
-    }
-    else if(tline == QLatin1String("GLOBAL: ANS_mute=no")) {
-        m_currently_muted = false;
-    }
-    else if(tline == QLatin1String("GLOBAL: ANS_mute=yes")) {
-        m_currently_muted = true;
-    }
-    else if(tline.startsWith(QLatin1String("GLOBAL: ANS_switch_audio="))) {
-        const QString aids = tline.mid(25);
-        int aid = QSToInt(aids);
+    const MpLineView tline = mpline_trimmed(line);
+    const MpLineKind kind = parsed.kind;
 
-        if(aid == m_current_aid) {
-            MYDBG("current AID %d (%s). Same read back from %s", m_current_aid, qPrintable(m_mediaInfo->aid_2_alang(m_current_aid)), qPrintable(aids));
-        }
-        else {
-            MYDBG("current AID %d (%s). read AID %d from %s \"%s\"", m_current_aid, qPrintable(m_mediaInfo->aid_2_alang(m_current_aid)), aid,  qPrintable(aids), qPrintable(m_mediaInfo->aid_2_alang(aid)));
-            m_current_aid = aid;
+    switch(kind) {
+        case MpLineKind::AnsPauseNo:
+            if(m_curr_state == MpState::PausedState) {
+                newstates.append(MpState::PlayingState);
+                MYDBG("got ANS_pause=no, guessing on PlayingState");
+            }
+
+            break;
+
+        case MpLineKind::AnsPauseYes:
+            if(m_curr_state == MpState::PlayingState) {
+                newstates.append(MpState::PausedState);
+                MYDBG("got ANS_pause=yes, guessing on PausedState");
+            }
+
+            break;
+
+        case MpLineKind::AnsMuteNo:
+            m_currently_muted = false;
+            break;
+
+        case MpLineKind::AnsMuteYes:
+            m_currently_muted = true;
+            break;
+
+        case MpLineKind::AnsSwitchAudio: {
+            const int aid = parsed_int(tline, parsed);
+
+            if(aid == m_current_aid) {
+                MYDBG("current AID %d (%s). Same read back from %.*s", m_current_aid, qPrintable(m_mediaInfo->aid_2_alang(m_current_aid)), tline.len, tline.data);
+            }
+            else {
+                MYDBG("current AID %d (%s). read AID %d from %.*s \"%s\"", m_current_aid, qPrintable(m_mediaInfo->aid_2_alang(m_current_aid)), aid, tline.len, tline.data, qPrintable(m_mediaInfo->aid_2_alang(aid)));
+                m_current_aid = aid;
+            }
+
+            break;
         }
-    }
-    else if(tline.startsWith(QLatin1String("GLOBAL: ANS_speed="))) {
-        const QString sps = tline.mid(18);
-        double readspeed = QSToDouble(sps);
-        MYDBG("read speed %f from %s", readspeed, qPrintable(sps));
-        foundspeeds.append(readspeed);
-    }
-    else if(tline.startsWith(QLatin1String("GLOBAL: ANS_time_pos="))) {
-        positionlines.append(tline);
-    }
-    else if(tline.startsWith(QLatin1String("GLOBAL: ANS_TIME_POSITION="))) {
-        positionlines.append(tline);
-    }
 
-    else if(tline.startsWith(QLatin1String("Cache fill:"))) {
-    }
-    else if(tline.startsWith(QLatin1String("CPLAYER: Starting playback..."))) {
-        MYDBG("got Starting playback, submitting the metadata request. INVOKE_DELAY slot_ask_for_metadata");
-        INVOKE_DELAY(slot_ask_for_metadata());
-        // do not trigger state on this - it will still output ID_... info after encountering this line
-    }
-    else if(tline.startsWith(QLatin1String("File not found: "))) {
-        MYDBG("got File not found, error!");
-        errorreasons.append(tline);
-    }
-    else if(tline.endsWith(QLatin1String("IDENTIFY: ID_PAUSED"))) {
-        MYDBG("got ID_PAUSED, guessing on PausedState");
-        newstates.append(MpState::PausedState);
-    }
-    else if(tline.startsWith(QLatin1String("IDENTIFY: ID_SIGNAL"))) {
-        MYDBG("got ID_SIGNAL, error!");
-        errorreasons.append(tline);
-    }
-    else if(tline.startsWith(QLatin1String("FATAL: Could not initialize video filters (-vf) or video output (-vo)"))) {
-        MYDBG("got Could not initialize video filters, error!");
-        errorreasons.append(tline);
-    }
-    else if(tline.startsWith(QLatin1String("IDENTIFY: ID_EXIT"))) {
-        MYDBG("got ID_EXIT, going to StoppedState");
-        newstates.append(MpState::StoppedState);
-    }
-    else if(tline.startsWith(QLatin1String("IDENTIFY: ID_"))) {
-        parseMediaInfo(tline);
-    }
-    else if(tline.contains(QLatin1String("No stream found"))) {
-        MYDBG("got No stream found, error!");
-        errorreasons.append(tline);
-    }
-    else if((tline.startsWith(QLatin1String("STATUSLINE: A:")) || tline.startsWith(QLatin1String("STATUSLINE: V:")))) {
-        positionlines.append(tline);
-    }
-    else if(tline.startsWith(QLatin1String("Exiting..."))) {
-        MYDBG("got Exiting, going to StoppedState");
-        newstates.append(MpState::StoppedState);
-    }
-    else if(tline.startsWith(QLatin1String("GLOBAL: EOF code:"))) {
-        MYDBG("got EOF code, going to StoppedState");
-        newstates.append(MpState::StoppedState);
-    }
-    else if(tline.startsWith(QLatin1String("DEMUXER: ds_fill_buffer: EOF reached (stream: video)"))) {
-        // this can also happen if the cache is empty
-        //newstates.append(MpState::StoppedState);
-    }
-    else if(tline.startsWith(QLatin1String("GLOBAL: ANS_metadata="))) {
-        if(!m_mediaInfo->is_finalized()) {
-            m_mediaInfo->set_finalized(); // No more info here
-            MYDBG("got ANS_metadata=, loading is done and going to PlayingState. EMIT sig_loadDone");
-            newstates.append(MpState::PlayingState);
-            emit sig_loadDone();
+        case MpLineKind::AnsSpeed: {
+            const double readspeed = parsed_double(tline, parsed);
+            MYDBG("read speed %f from %.*s", readspeed, tline.len, tline.data);
+            foundspeeds.append(readspeed);
+            break;
         }
+
+        case MpLineKind::AnsTimePos:
+        case MpLineKind::AnsTimePosition:
+        case MpLineKind::StatusLine:
+            // only the last one is acted on, keep it until then
+            positionline.resize(0);
+            positionline.append(tline.data, tline.len);
+            positionparsed = parsed;
+            break;
+
+        case MpLineKind::StartingPlayback:
+            MYDBG("got Starting playback, submitting the metadata request. INVOKE_DELAY slot_ask_for_metadata");
+            INVOKE_DELAY(slot_ask_for_metadata());
+            // do not trigger state on this - it will still output ID_... info after encountering this line
+            break;
+
+        case MpLineKind::FileNotFound:
+            MYDBG("got File not found, error!");
+            errorreasons.append(MLVToQString(tline));
+            break;
+
+        case MpLineKind::IdPaused:
+            MYDBG("got ID_PAUSED, guessing on PausedState");
+            newstates.append(MpState::PausedState);
+            break;
+
+        case MpLineKind::IdSignal:
+            MYDBG("got ID_SIGNAL, error!");
+            errorreasons.append(MLVToQString(tline));
+            break;
+
+        case MpLineKind::FatalVoInit:
+            MYDBG("got Could not initialize video filters, error!");
+            errorreasons.append(MLVToQString(tline));
+            break;
+
+        case MpLineKind::IdExit:
+            MYDBG("got ID_EXIT, going to StoppedState");
+            newstates.append(MpState::StoppedState);
+            break;
+
+        case MpLineKind::Identify:
+            if(parsed.ok) {
+                parseMediaInfo(parsed.id_key, parsed.id_value);
+            }
+
+            break;
+
+        case MpLineKind::NoStreamFound:
+            MYDBG("got No stream found, error!");
+            errorreasons.append(MLVToQString(tline));
+            break;
+
+        case MpLineKind::Exiting:
+            MYDBG("got Exiting, going to StoppedState");
+            newstates.append(MpState::StoppedState);
+            break;
+
+        case MpLineKind::EofCode:
+            MYDBG("got EOF code, going to StoppedState");
+            newstates.append(MpState::StoppedState);
+            break;
+
+        case MpLineKind::AnsMetadata:
+            if(!m_mediaInfo->is_finalized()) {
+                m_mediaInfo->set_finalized(); // No more info here
+                MYDBG("got ANS_metadata=, loading is done and going to PlayingState. EMIT sig_loadDone");
+                newstates.append(MpState::PlayingState);
+                emit sig_loadDone();
+            }
+
+            break;
+
+        case MpLineKind::Ignored:
+            break;
+
+        case MpLineKind::Unknown:
+            //MYDBG("did not understand line %.*s", tline.len, tline.data);
+            break;
     }
-    else if(tline.startsWith(QLatin1String("Fontconfig warning:"))) {
-    }
-    else {
-        //MYDBG("did not understand line %s", qPrintable(tline));
-    }
+
+    return kind;
 }
 
 // Parses MPlayer's media identification output
-void MpProcess::parseMediaInfo(const QString &tline)
+void MpProcess::parseMediaInfo(const QString &key, const QString &value)
 {
-    static_var const VRegularExpression rx_alang("^ID_AID_(\\d+)_LANG$");
-    static_var const VRegularExpression rx_slang("^ID_SID_(\\d+)_LANG$");
-
-    QString line = tline.trimmed();
-    line.remove(QLatin1String("IDENTIFY:"));
-    line = line.trimmed();
-
-    QStringList info = line.split(QLatin1Char('='));
+    m_mediaInfo->apply_identify(key, value, &m_currentTag);
+}
 
-    QRegularExpressionMatch rxmatch;
+#ifdef CAUTION
+// the byte parser has to agree with the old way of splitting status lines
+static void check_statusline_against_split(const MpLineView &tline, const MpStatusLine &st)
+{
+    static_var const VRegularExpression rx_split("[ :]");
 
-    if(info.count() < 2) {
-        return;
-    }
+    const QString line = QString::fromLatin1(tline.data, tline.len);
+    const QStringList info = line.split(rx_split, QString::SkipEmptyParts);
 
-    if(info[0] == QLatin1String("ID_VIDEO_FORMAT")) {
-        m_mediaInfo->set_videoFormat(info[1]);
-    }
-    else if(info[0] == QLatin1String("ID_VIDEO_BITRATE")) {
-        m_mediaInfo->set_videoBitrate(QSToInt(info[1]));
-    }
-    else if(info[0] == QLatin1String("ID_VIDEO_WIDTH")) {
-        m_mediaInfo->set_width(QSToInt(info[1]));
-    }
-    else if(info[0] == QLatin1String("ID_VIDEO_HEIGHT")) {
-        m_mediaInfo->set_height(QSToInt(info[1]));
-    }
-    else if(info[0] == QLatin1String("ID_VIDEO_FPS")) {
-        m_mediaInfo->set_framesPerSecond(QSToDouble(info[1]));
+    for(int i = 0; i + 1 < info.count(); i++) {
+        bool has;
+        double val;
 
-    }
-    else if(info[0] == QLatin1String("ID_AUDIO_FORMAT")) {
-        // this can still be output when switching tracks
-        if(!m_mediaInfo->is_finalized()) {
-            m_mediaInfo->set_audioFormat(info[1]);
+        if(info[i] == QLatin1String("A")) {
+            has = st.has_a;
+            val = st.a;
         }
-    }
-    else if(info[0] == QLatin1String("ID_AUDIO_BITRATE")) {
-        // this can still be output when switching tracks
-        if(!m_mediaInfo->is_finalized()) {
-            m_mediaInfo->set_audioBitrate(QSToInt(info[1]));
+        else if(info[i] == QLatin1String("V")) {
+            has = st.has_v;
+            val = st.v;
         }
-    }
-    else if(info[0] == QLatin1String("ID_AUDIO_RATE")) {
-        // this can still be output when switching tracks
-        if(!m_mediaInfo->is_finalized()) {
-            m_mediaInfo->set_sampleRate(QSToInt(info[1]));
+        else if(info[i] == QLatin1String("A-V")) {
+            has = st.has_av;
+            val = st.av;
         }
-    }
-    else if(info[0] == QLatin1String("ID_AUDIO_NCH")) {
-        // this can still be output when switching tracks
-        if(!m_mediaInfo->is_finalized()) {
-            m_mediaInfo->set_numChannels(QSToInt(info[1]));
+        else {
+            continue;
         }
 
-    }
-    else if(info[0] == QLatin1String("ID_LENGTH")) {
-        m_mediaInfo->set_length(QSToDouble(info[1]));
-    }
-    else if(info[0] == QLatin1String("ID_SEEKABLE")) {
-        m_mediaInfo->set_seekable((bool)QSToInt(info[1]));
-    }
-    else if(info[0].startsWith(QLatin1String("ID_CLIP_INFO_NAME"))) {
-        m_currentTag = info[1];
-    }
-    else if(info[0].startsWith(QLatin1String("ID_CLIP_INFO_VALUE")) && !m_currentTag.isEmpty()) {
-        m_mediaInfo->add_tag(m_currentTag, info[1]);
-    }
-    else if(info[0].startsWith(QLatin1String("ID_CHAPTER"))) {
-        m_mediaInfo->add_tag(m_currentTag, info[1]);
-    }
-    else if(info[0].indexOf(rx_alang, 0, &rxmatch) >= 0) {
-        const QString &aid = rxmatch.captured(1);
-        const QString &alang = info[1];
-        m_mediaInfo->add_alang(QSToInt(aid), alang);
-    }
-    else if(info[0].indexOf(rx_slang, 0, &rxmatch) >= 0) {
-        const QString &sid = rxmatch.captured(1);
-        const QString &slang = info[1];
-        m_mediaInfo->add_slang(QSToInt(sid), slang);
-    }
-    else if(info[0] == QLatin1String("ID_START_TIME")) {
-    }
-    else if(info[0] == QLatin1String("ID_DEMUXER")) {
-    }
-    else if(info[0] == QLatin1String("ID_VIDEO_ASPECT")) {
-        QString sDAR = info[1];
-        double DAR = QSToDouble(sDAR);
+        bool ok = false;
+        const double res = info[i + 1].toDouble(&ok);
 
-        if(DAR < 0.001 || DAR > 100) {
-            MYDBG("ignoring bad DAR in \"%s\"", qPrintable(tline));
-        }
-        else {
-            m_mediaInfo->set_DAR(DAR);
+        if(!ok || !has || qAbs(res - val) > 1e-9) {
+            PROGRAMMERERROR("status line parsers disagree on %s in \"%s\"", qPrintable(info[i]), qPrintable(line));
         }
     }
-    else if(info[0] == QLatin1String("ID_VIDEO_ID")) {
-    }
-    else if(info[0] == QLatin1String("ID_VIDEO_CODEC")) {
-    }
-    else if(info[0] == QLatin1String("ID_AUDIO_CODEC")) {
-    }
-    else if(info[0] == QLatin1String("ID_AUDIO_TRACK")) {
-    }
-    else if(info[0] == QLatin1String("ID_AUDIO_ID")) {
-    }
-    else if(info[0] == QLatin1String("ID_SUBTITLE_ID")) {
-    }
-    else if(info[0] == QLatin1String("ID_CLIP_INFO_N")) {
-    }
-    else if(info[0] == QLatin1String("ID_FILENAME")) {
-    }
-    else {
-#ifdef NOW_BEHAVIOR
-        const QDateTime &now = readtime;
-#endif
-        MYDBG("unknown mediainfo %s=%s", qPrintable(info[0]), qPrintable(info[1]));
-    }
 }
+#endif
 
 // Parses MPlayer's position output
 // possible outcomes:
 //    * nothing
 //    * new position
 //    * seek to a specific position to fix AV mis-sync
-void MpProcess::parsePosition(const QString &tline, const QDateTime &readtime)
+void MpProcess::parsePosition(const MpLineView &tline, const MpParsedLine &parsed, const MonoTime &readtime)
 {
 
     switch(m_curr_state) {
@@ -1501,108 +1978,85 @@ void MpProcess::parsePosition(const QString &tline, const QDateTime &readtime)
     }
 
     const double oldpos = currentExpectedPosition(false);
-    QList<double> contenders;
+    double contenders[2];
+    int ncontenders = 0;
     bool trust_this_after_seek = false;
     double seektarget = (-1);
 
-    static_var const QString atp1 = QStringLiteral("GLOBAL: ANS_time_pos=");
-    static_var const QString atp2 = QStringLiteral("GLOBAL: ANS_TIME_POSITION=");
-
-    if(tline.startsWith(atp1)) {
-        QString ps = tline.mid(atp1.length());
-        bool ok = false;
-        double res = ps.toDouble(&ok);
-
-        if(!ok) {
-            PROGRAMMERERROR("could not convert \"%s\" to double", qPrintable(ps));
-        }
+    const MpLineKind kind = parsed.kind;
 
-        contenders.append(res);
+    if(kind == MpLineKind::AnsTimePos) {
+        contenders[ncontenders++] = parsed_double(tline, parsed);
     }
-    else if(tline.startsWith(atp2)) {
-        QString ps = tline.mid(atp2.length());
-        bool ok = false;
-        double res = ps.toDouble(&ok);
-
-        if(!ok) {
-            PROGRAMMERERROR("could not convert \"%s\" to double", qPrintable(ps));
-        }
-
-        contenders.append(res);
+    else if(kind == MpLineKind::AnsTimePosition) {
+        contenders[ncontenders++] = parsed_double(tline, parsed);
         trust_this_after_seek = true;
     }
     else {
         // STATUSLINE: A: 913.6 V: 897.9 A-V: 15.733 ct:  3.697   0/  0 28%  3%  1.2% 465 0 50%
-        static_var const VRegularExpression rx_split("[ :]");
-
-        QStringList info = tline.split(rx_split, QString::SkipEmptyParts);
-
-        for(int i = 0; i < info.count(); i++) {
-            if((info[i] == QLatin1String("V") || info[i] == QLatin1String("A")) && info.count() > i) {
-                bool ok = false;
-                const QString &ps = info[i + 1];
-                double res = ps.toDouble(&ok);
+        if(!parsed.ok) {
+            PROGRAMMERERROR("could not parse status line \"%.*s\"", tline.len, tline.data);
+        }
 
-                if(!ok) {
-                    PROGRAMMERERROR("could not convert \"%s\" to double", qPrintable(ps));
-                }
+        const MpStatusLine &st = parsed.status;
 
-                contenders.append(res);
-            }
-            else if(info[i] == QLatin1String("A-V")) {
-                bool ok = false;
-                const QString &amvs = info[i + 1];
-                double amv = amvs.toDouble(&ok);
+#ifdef CAUTION
+        check_statusline_against_split(tline, st);
+#endif
 
-                if(!ok) {
-                    PROGRAMMERERROR("could not convert \"%s\" to double",  qPrintable(amvs));
-                }
+        if(st.has_a) {
+            contenders[ncontenders++] = st.a;
+        }
 
-                const bool normalspeed = qAbs(m_curr_speed - 1.) < 0.01;
-                const double max_avmissynax = (normalspeed ? max_avmissync_before_explicit_seek_normal_speed_secs : max_avmissync_before_explicit_seek_unnormal_speed_secs);
+        if(st.has_v) {
+            contenders[ncontenders++] = st.v;
+        }
 
-                if(max_avmissynax > 0. && qAbs(amv) > max_avmissynax) {
-                    double min = contenders.first();
-                    double max = contenders.first();
+        if(st.has_av && ncontenders > 0) {
+            const bool normalspeed = qAbs(m_curr_speed - 1.) < 0.01;
+            const double max_avmissynax = (normalspeed ? max_avmissync_before_explicit_seek_normal_speed_secs : max_avmissync_before_explicit_seek_unnormal_speed_secs);
 
-                    foreach(const double &v, contenders) {
-                        if(v < min) {
-                            min = v;
-                        }
+            if(max_avmissynax > 0. && qAbs(st.av) > max_avmissynax) {
+                double min = contenders[0];
+                double max = contenders[0];
 
-                        if(v > min) {
-                            max = v;
-                        }
+                for(int i = 1; i < ncontenders; i++) {
+                    if(contenders[i] < min) {
+                        min = contenders[i];
                     }
 
-                    min = int(min);
-                    max = ceil(max);
-                    seektarget = (normalspeed ? min : max);
+                    if(contenders[i] > max) {
+                        max = contenders[i];
+                    }
                 }
+
+                min = int(min);
+                max = ceil(max);
+                seektarget = (normalspeed ? min : max);
             }
         }
     }
 
-    if(contenders.isEmpty()) {
-        qWarning("could not get position from \"%s\"", qPrintable(tline));
+    if(ncontenders == 0) {
+        qWarning("could not get position from \"%.*s\"", tline.len, tline.data);
         return;
     }
 
     double sum = 0;
 
-    foreach(double v, contenders) {
-        sum += v;
+    for(int i = 0; i < ncontenders; i++) {
+        sum += contenders[i];
     }
 
-    double parsedpos = sum / contenders.size();
+    double parsedpos = sum / ncontenders;
 
     if(parsedpos < 0) {
         if(parsedpos < minimum_allowed_negative_position_from_statusline) {
-            MYDBG("parsed negative position %f from \"%s\"? ignoring", parsedpos, qPrintable(tline));
+            MYDBG("parsed negative position %f from \"%.*s\"? ignoring", parsedpos, tline.len, tline.data);
             return;
         }
         else {
-            MYDBG("parsed negative position %f from \"%s\"? assuming 0", parsedpos, qPrintable(tline));
+            MYDBG("parsed negative position %f from \"%.*s\"? assuming 0", parsedpos, tline.len, tline.data);
             parsedpos = 0.;
         }
     }
@@ -1631,9 +2085,11 @@ void MpProcess::parsePosition(const QString &tline, const QDateTime &readtime)
             const MpProcessCmd seekcmd(mpctag_seek(), MpProcess::AbsoluteSeek, seektarget, readtime);
             const QString cmd = seekcmd.command(*this);
             force_cmd(cmd);
-            usleep(sleep_after_seeking_msec * 100);
-            const QString gettimecmd(QStringLiteral("pausing_keep_force get_time_pos"));
-            force_cmd(gettimecmd);
+            // ask for the new position once the seek had time to happen
+            const MonoTime now = MonoTime::now();
+            m_outputq.prepend(MpProcessCmd(mpctag_string(), QStringLiteral("pausing_keep_force get_time_pos"), now));
+            m_outputq.prepend(MpProcessCmd(mpctag_delay(), sleep_after_seeking_msec, now));
+            QTimer::singleShot(sleep_after_seeking_msec, this, SLOT(slot_try_to_write_now()));
             return;
         }
     }
@@ -1642,31 +2098,36 @@ void MpProcess::parsePosition(const QString &tline, const QDateTime &readtime)
         if(m_dont_trust_time_from_statusline_till > readtime) {
             if(trust_this_after_seek) {
                 // do not reset m_dont_trust_time_from_statusline_till here!
-                TIMEMYDBG("not ignoring read position - I trust this input \"%s\"",  qPrintable(tline));
+                TIMEMYDBG("not ignoring read position - I trust this input \"%.*s\"", tline.len, tline.data);
             }
             else if(m_previous_seek_direction_is_fwd && oldpos >= 0 && oldpos < parsedpos) {
-                m_dont_trust_time_from_statusline_till = QDateTime();
-                TIMEMYDBG("not ignoring read position - going forward from %f [%s]", oldpos, qPrintable(tline));
+                m_dont_trust_time_from_statusline_till = MonoTime();
+                TIMEMYDBG("not ignoring read position - going forward from %f [%.*s]", oldpos, tline.len, tline.data);
             }
             else if(!m_previous_seek_direction_is_fwd && oldpos >= 0 && oldpos > parsedpos) {
-                m_dont_trust_time_from_statusline_till = QDateTime();
-                TIMEMYDBG("not ignoring read position - going backwards from %f [%s]", oldpos, qPrintable(tline));
+                m_dont_trust_time_from_statusline_till = MonoTime();
+                TIMEMYDBG("not ignoring read position - going backwards from %f [%.*s]", oldpos, tline.len, tline.data);
             }
             else if(oldpos >= 0 && qAbs(parsedpos - oldpos) < no_not_ignore_parsed_position_if_closer_than_sec) {
-                m_dont_trust_time_from_statusline_till = QDateTime();
-                TIMEMYDBG("not ignoring read position - assuming more true than %f [%s]", oldpos, qPrintable(tline));
+                m_dont_trust_time_from_statusline_till = MonoTime();
+                TIMEMYDBG("not ignoring read position - assuming more true than %f [%.*s]", oldpos, tline.len, tline.data);
             }
             else {
-                TIMEMYDBG("ignoring read position - assuming %f is more true [%s]", currentExpectedPosition(false), qPrintable(tline));
+                TIMEMYDBG("ignoring read position - assuming %f is more true [%.*s]", currentExpectedPosition(false), tline.len, tline.data);
                 return;
             }
         }
         else {
-            m_dont_trust_time_from_statusline_till = QDateTime();
+            m_dont_trust_time_from_statusline_till = MonoTime();
         }
     }
 
-    streamPositionReadAt(parsedpos, readtime);
+    if(!m_seek_writtent.isNull() && m_seek_writtent <= readtime) {
+        m_metrics.seek_to_position.record(m_seek_writtent, readtime);
+        m_seek_writtent = MonoTime();
+    }
+
+    streamPositionReadAt(parsedpos, readtime, (kind == MpLineKind::AnsTimePos || kind == MpLineKind::AnsTimePosition) ? PositionFromQuery : PositionFromStatusline);
 
 }
 
@@ -1683,7 +2144,7 @@ double MpProcess::lastPositionRead() const
     return m_lastread_streamPosition;
 }
 
-double MpProcess::expectedPositionAt(const QDateTime &now, bool maskinbadstates) const
+double MpProcess::expectedPositionAt(const MonoTime &now, bool maskinbadstates) const
 {
 
     if(maskinbadstates) {
@@ -1706,29 +2167,9 @@ double MpProcess::expectedPositionAt(const QDateTime &now, bool maskinbadstates)
         return lrp;
     }
 
-    if(m_curr_state == MpState::PlayingState && !now.isNull() && !m_streamposition_readt.isNull()) {
-        //TIMEMYDBG("streamPosition()");
-        const qint64 offset_ms = m_streamposition_readt.msecsTo(now);
-
-        if(offset_ms != 0) {
-            if(offset_ms < 0) {
-                PROGRAMMERERROR("WTF");
-            }
-
-            const double offset_secs = double(offset_ms) / 1000.0;
-
-            //TIMEMYDBG("streamPosition(): adding %lu*%f msec to last marker %f", (unsigned long)offset_ms, m_speed, lrp);
-            if(m_curr_speed < 0.00001 || m_curr_speed > 100) {
-                PROGRAMMERERROR("WTF");
-            }
-
-            if(offset_secs > 1.) {
-                qWarning("adjusting position from %f: no position read in %f seconds? thats a lot...", lrp, offset_secs);
-            }
-
-            const double change = m_curr_speed * offset_secs;
-            lrp += change;
-        }
+    // only moves while playing
+    if(m_estimator.has_estimate()) {
+        lrp = m_estimator.position_at(now);
     }
 
     if(m_mediaInfo->has_length()) {
@@ -1753,15 +2194,15 @@ double MpProcess::currentExpectedPosition(bool maskinbadstates) const
 {
 
     if(m_curr_state == MpState::PlayingState) {
-        QDateTime now = QDateTime::currentDateTimeUtc();
+        MonoTime now = MonoTime::now();
         return expectedPositionAt(now, maskinbadstates);
     }
     else {
-        return expectedPositionAt(QDateTime(), maskinbadstates);
+        return expectedPositionAt(MonoTime(), maskinbadstates);
     }
 }
 
-void MpProcess::streamPositionReadAt(double newpos, const QDateTime &now)
+void MpProcess::streamPositionReadAt(double newpos, const MonoTime &now, PositionSource src)
 {
 
     if(newpos < 0) {
@@ -1777,10 +2218,16 @@ void MpProcess::streamPositionReadAt(double newpos, const QDateTime &now)
     double diff_to_last = qAbs(m_last_emited_streampos - newpos);
 
     m_lastread_streamPosition = newpos;
-    m_streamposition_readt = now;
+
+    if(src == PositionFromSeek) {
+        m_estimator.jump_to(newpos, now);
+    }
+    else {
+        m_estimator.sample(newpos, now, src == PositionFromQuery);
+    }
 
     if(diff_to_expected > emit_position_change_if_change_larger_than_sec || m_last_emited_streampos == (-1) || diff_to_last > emit_position_change_if_change_larger_than_sec) {
-        m_last_emited_streampos = m_lastread_streamPosition;
+        m_last_emited_streampos = m_estimator.position_at(now);
         TIMEMYDBG("EMIT sig_streamPositionChanged(%f), old position %f", m_last_emited_streampos, expectedpos);
         emit sig_streamPositionChanged(m_last_emited_streampos);
     }
@@ -1791,7 +2238,7 @@ void MpProcess::streamPositionReadAt(double newpos, const QDateTime &now)
 }
 
 // Changes the current state, possibly emitting multiple signals
-void MpProcess::changeState(MpState newstate, const QDateTime &now)
+void MpProcess::changeState(MpState newstate, const MonoTime &now)
 {
 
     const MpState oldstate = m_curr_state;
@@ -1827,8 +2274,8 @@ void MpProcess::changeState(MpState newstate, const QDateTime &now)
     }
 
     if(oldstate == MpState::PlayingState || newstate == MpState::PlayingState) {
-        MYDBG("oldstate or newstate is PlayingState - setting m_streamposition_readt to null");
-        m_streamposition_readt = QDateTime();
+        MYDBG("oldstate or newstate is PlayingState - position estimate %s", newstate == MpState::PlayingState ? "moves" : "holds");
+        m_estimator.set_running(newstate == MpState::PlayingState, now);
     }
 
     MYDBG("EMIT sig_stateChanged(%s, %s)", convert_MpState_2_asciidesc(oldstate), convert_MpState_2_asciidesc(newstate));
@@ -1837,7 +2284,7 @@ void MpProcess::changeState(MpState newstate, const QDateTime &now)
 }
 
 // Changes the current state, possibly emitting multiple signals
-void MpProcess::changeToErrorState(const QString &comment, const QDateTime &now)
+void MpProcess::changeToErrorState(const QString &comment, const MonoTime &now)
 {
     const MpState oldstate = m_curr_state;
     const MpState newstate = MpState::ErrorState;
@@ -1861,48 +2308,35 @@ void MpProcess::changeToErrorState(const QString &comment, const QDateTime &now)
     emit sig_stateChanged(oldstate, newstate);
     MYDBG("EMIT sig_error(%s)", qPrintable(comment));
     emit sig_error(comment);
-    MYDBG("EMIT sig_error_at_pos(%s, %f)", qPrintable(comment), m_lastread_streamPosition);
-    emit sig_error_at_pos(comment, m_lastread_streamPosition);
+    MYDBG("EMIT sig_error_at_pos(%s, %f, %d)", qPrintable(comment), m_lastread_streamPosition, m_current_aid);
+    emit sig_error_at_pos(comment, m_lastread_streamPosition, m_current_aid);
     resetValues();
 
 }
 
-void MpProcess::update_lastreadt(const QDateTime &readtime)
+void MpProcess::update_lastreadt(const MonoTime &readtime)
 {
     if(!m_lastreadt.isNull()) {
-        qint64 msecs = m_lastreadt.msecsTo(readtime);
-
-        if(msecs < 0) {
-            PROGRAMMERERROR("WTF: last read at %s; readtime %s"
-                            , qPrintable(m_lastreadt.toLocalTime().toString(QStringLiteral("hh:mm:ss.zzz")))
-                            , qPrintable(readtime.toLocalTime().toString(QStringLiteral("hh:mm:ss.zzz")))
-                           );
+        // reads are stamped by the pipe reader thread, while m_lastreadt is
+        // also set to "now" on state changes - the read might be older
+        if(readtime < m_lastreadt) {
+            TIMEMYDBG("read at %s is older than the last one at %s"
+                      , qPrintable(readtime.toHuman())
+                      , qPrintable(m_lastreadt.toHuman()));
+            return;
         }
 
         const unsigned stateidx = MpState_2_idx(m_curr_state);
+        m_metrics.read_gap[stateidx].record(m_lastreadt, readtime);
 
-        if(m_max_encountered_readlatency_ms[stateidx] < 0 || msecs > m_max_encountered_readlatency_ms[stateidx]) {
-            m_max_encountered_readlatency_ms[stateidx] = msecs;
-        }
-
-        if((!m_lastwritet.isNull()) && m_lastwritet > m_lastreadt) {
-            qint64 msecs_since_write = m_lastwritet.msecsTo(readtime);
-
-            if(msecs_since_write < 0) {
-                PROGRAMMERERROR("WTF? last write at %s; readtime %s"
-                                , qPrintable(m_lastwritet.toLocalTime().toString(QStringLiteral("hh:mm:ss.zzz")))
-                                , qPrintable(readtime.toLocalTime().toString(QStringLiteral("hh:mm:ss.zzz")))
-                               );
-            }
-
-            if(m_max_encountered_writelatency_ms < 0 || msecs_since_write > m_max_encountered_writelatency_ms) {
-                m_max_encountered_writelatency_ms = msecs_since_write;
-            }
+        // and we might have written after mplayer wrote this
+        if((!m_lastwritet.isNull()) && m_lastwritet > m_lastreadt && m_lastwritet <= readtime) {
+            m_metrics.write_to_read.record(m_lastwritet, readtime);
         }
     }
 
     m_lastreadt = readtime;
-    // const QDateTime&now=readtime;
+    // const MonoTime&now=readtime;
     //TIMEMYDBG("update_lastreadt: m_lastreadt set to readtime");
 }
 
@@ -1956,7 +2390,7 @@ void MpProcess::slot_heartbeat()
       * write queue is not empty
     */
 
-    const QDateTime now = QDateTime::currentDateTimeUtc();
+    const MonoTime now = MonoTime::now();
     // TIMEMYDBG("slot_heartbeat");
 
     try_to_write(now);
@@ -2078,11 +2512,11 @@ QString MpProcess::MpProcessCmd::command(MpProcess &proc) const
             return QString();
         }
 
-        const QDateTime now = QDateTime::currentDateTimeUtc();
+        const MonoTime now = MonoTime::now();
         const double m_lastread_streamPosition = proc.m_lastread_streamPosition;
         TIMEMYDBG("MpProcessCmd::command(seek)");
         QString cmd = QString(QStringLiteral("seek %1 2")).arg(newpos);
-        proc.streamPositionReadAt(newpos, now);
+        proc.streamPositionReadAt(newpos, now, PositionFromSeek);
         proc.m_dont_trust_time_from_statusline_till = now.addMSecs(ignore_statusline_after_seek_ms);
         proc.m_previous_seek_direction_is_fwd = (newpos > oldpos ? true : false);
         return cmd;
@@ -2217,6 +2651,10 @@ bool MpProcess::screensaver_should_be_active() const
 
 void MpProcess::set_screensaver_by_state()
 {
+    if(!m_cfg_manage_screensaver) {
+        return;
+    }
+
     if(screensaver_should_be_active()) {
         m_ssmanager.enable();
     }
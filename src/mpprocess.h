@@ -11,16 +11,27 @@
 #include <QQueue>
 #include <QProcess>
 
+#include <stdio.h>
+
 #include "util.h"
 #include "mpmediainfo.h"
 #include "mpstate.h"
 #include "vregularexpression.h"
 #include "deathsigprocess.h"
+#include "mppipereader.h"
+#include "mpmetrics.h"
+#include "mppositionestimator.h"
+#include "mplinedispatch.h"
+#include "objectring.h"
+#include "monotime.h"
+#include "probecache.h"
 
 const unsigned osd_default_duration_ms = 2000;
 
 #include "screensavermanager.h"
 
+class AsyncProbe;
+
 // A custom QProcess designed for the MPlayer slave interface
 class MpProcess : public QObject
 {
@@ -43,12 +54,32 @@ public:
         AbsoluteSeek
     };
     struct MpProcessIolog {
-        QString line;
+        // raw bytes as read from / written to mplayer
+        QByteArray line;
         IOChannel c;
-        QDateTime dt;
+        // see accumulated_output_datetime()
+        MonoTime t;
     };
 
 private:
+    // where a position passed to streamPositionReadAt() comes from
+    enum PositionSource {
+        PositionFromStatusline,
+        PositionFromQuery,
+        PositionFromSeek
+    };
+    // stop and load wait for mplayer in these, see begin_transition()
+    enum class Transition {
+        None,
+        Stopping,
+        DrainingBeforeLoad
+    };
+    // a load first checks the file can be read, in these steps
+    enum class ProbeStage {
+        None,
+        Access,
+        Sustain
+    };
     enum MpCommandType {
         String,
         Seek,
@@ -77,27 +108,58 @@ private:
         SeekMode m_seekmode;
         double m_seektarget;
         double m_delay;
-        QDateTime m_created;
+        MonoTime m_created;
         MpProcessCmd();
     public:
-        MpProcessCmd(mpctag_string /*tag*/, const QString &in_cmd, const QDateTime &in_dt):
+        MpProcessCmd(mpctag_string /*tag*/, const QString &in_cmd, const MonoTime &in_dt):
             m_type(String),
             m_command(in_cmd),
             m_created(in_dt) {}
-        MpProcessCmd(mpctag_seek /*tag*/, const SeekMode &in_smode, double in_starget, const QDateTime &in_dt):
+        MpProcessCmd(mpctag_seek /*tag*/, const SeekMode &in_smode, double in_starget, const MonoTime &in_dt):
             m_type(Seek),
             m_seekmode(in_smode),
             m_seektarget(in_starget),
             m_created(in_dt) {}
-        MpProcessCmd(mpctag_osdsl /*tag*/, const QDateTime &in_dt):
+        MpProcessCmd(mpctag_osdsl /*tag*/, const MonoTime &in_dt):
             m_type(OSDShowLocation),
             m_created(in_dt) {}
-        MpProcessCmd(mpctag_delay /*tag*/, const double delay, const QDateTime &in_dt):
+        MpProcessCmd(mpctag_delay /*tag*/, const double delay, const MonoTime &in_dt):
             m_type(Delay),
             m_delay(delay),
             m_created(in_dt) {}
         QString command(MpProcess &proc) const;
-        const QDateTime &created() const
+        // a command mplayer answers, without changing anything
+        bool is_query() const;
+        const QString &string_command() const
+        {
+            if(m_type != String) {
+                PROGRAMMERERROR("WTF");
+            }
+
+            return m_command;
+        }
+        // folds a seek queued after this one into it, false if they do not combine
+        bool absorb_seek(const MpProcessCmd &later)
+        {
+            if(m_type != Seek || later.m_type != Seek) {
+                PROGRAMMERERROR("WTF");
+            }
+
+            if(later.m_seekmode != RelativeSeek) {
+                m_seekmode = later.m_seekmode;
+                m_seektarget = later.m_seektarget;
+                return true;
+            }
+
+            // relative targets are only resolved when written, so they add up
+            if(m_seekmode == RelativeSeek || m_seekmode == AbsoluteSeek) {
+                m_seektarget += later.m_seektarget;
+                return true;
+            }
+
+            return false;
+        }
+        const MonoTime &created() const
         {
             return m_created;
         }
@@ -124,13 +186,20 @@ private:
     };
 
     DeathSigProcess *m_proc;
+    // mplayer's stdout and stderr
+    MpPipeReader *m_pipereader;
     MpState m_curr_state;
 
     QString m_cfg_mplayerPath;
+    // all I/O with mplayer goes there if not empty, see mpreplay.h
+    QString m_cfg_tracefile;
+    FILE *m_trace;
+    MonoTime m_trace_start;
     QString m_cfg_videoOutput;
 
     MpMediaInfo *m_mediaInfo;
-    QDateTime m_streamposition_readt; // this is the time when the streamposition was read
+    // smoothed stream position, extrapolated while playing
+    MpPositionEstimator m_estimator;
     QElapsedTimer m_loadingtimer;
 
     double m_lastread_streamPosition; // This is the video position
@@ -141,7 +210,7 @@ private:
     //    - ignore_statusline_after_seek_ms after a seek
     //    - 300 after a load()
     // * parsePosition() is not running relative to "now" but relative to the stored readtime
-    QDateTime m_dont_trust_time_from_statusline_till;
+    MonoTime m_dont_trust_time_from_statusline_till;
     bool m_previous_seek_direction_is_fwd;
     bool m_currently_muted;
 
@@ -157,20 +226,44 @@ private:
     IOChannels m_cfg_output_accumulator_mode;
     size_t m_cfg_acc_maxlines;
     VRegularExpression *m_cfg_rx_output_accumulator_ignore;
-    QList<MpProcessIolog> m_acc;
-
-    QDateTime m_lastreadt;
-    QDateTime m_lastwritet;
-    qint64 m_max_encountered_readlatency_ms[MpState_maxidx];
-    qint64 m_max_encountered_writelatency_ms;
-    qint64 m_max_encountered_writequeuelatency_ms;
+    // drop what mpnoise_classify() finds, instead of matching a regex
+    bool m_cfg_acc_ignore_noise;
+    MyObjectRing<MpProcessIolog> m_acc;
+
+    MonoTime m_lastreadt;
+    MonoTime m_lastwritet;
+    // start of the reply the last written command is waiting for, empty if none
+    QByteArray m_ack_expected;
+    // the last written command got its reply
+    bool m_ack_received;
+    // when the last seek was written, null once a position was trusted after it
+    MonoTime m_seek_writtent;
+    MpMetrics m_metrics;
     QTimer m_heartbeattimer;
+    // empties an overlong m_outputq
+    QTimer m_flushtimer;
+
+    Transition m_transition;
+    QTimer m_transition_quiettimer;
+    QTimer m_transition_maxtimer;
+    // written after the transition settled
+    QString m_pending_loadcmd;
+    // written right after m_pending_loadcmd, in the same batch
+    QStringList m_pending_aftercmds;
+    // before the transition, the pending load waits for this
+    AsyncProbe *m_probe;
+    ProbeStage m_probestage;
+    // the load goes ahead after this one
+    ProbeStage m_probe_last_stage;
+    QString m_probe_url;
+    // what the access probe found, for the probe cache
+    FileIdentity m_probe_identity;
 
-    QByteArray m_not_yet_processed_out;
-    QByteArray m_not_yet_processed_err;
 
     int m_current_aid;
 
+    // false for a standby mplayer, which must not touch the screensaver
+    bool m_cfg_manage_screensaver;
     ScreenSaverManager m_ssmanager;
 
 private:
@@ -179,6 +272,9 @@ private:
     MpProcess(const MpProcess &);
     MpProcess &operator=(const MpProcess &in);
 
+    // tests/bench_mpparse.cpp drives the parsers without an mplayer
+    friend class MpParseBench;
+
 public:
 
     MpState state() const
@@ -193,6 +289,10 @@ public:
 
         return m_proc->processId();
     }
+    const MpMetrics &metrics() const
+    {
+        return m_metrics;
+    }
     const QString &videoOutput() const
     {
         return m_cfg_videoOutput;
@@ -220,21 +320,33 @@ public:
     void set_accumulated_output_maxlines(size_t in)
     {
         m_cfg_acc_maxlines = in;
-
-        while(size_t(m_acc.size()) > m_cfg_acc_maxlines) {
-            m_acc.removeFirst();
-        }
+        m_acc.set_capacity(int(m_cfg_acc_maxlines));
     }
-    const QList<MpProcessIolog> &accumulated_output() const
+    const MyObjectRing<MpProcessIolog> &accumulated_output() const
     {
         return m_acc;
     }
+    QDateTime accumulated_output_datetime(const MpProcessIolog &iolog) const
+    {
+        return iolog.t.toDateTime();
+    }
+    void set_trace_file(const QString &fn)
+    {
+        m_cfg_tracefile = fn;
+    }
+    void set_manage_screensaver(bool in)
+    {
+        m_cfg_manage_screensaver = in;
+        set_screensaver_by_state();
+    }
     void set_output_accumulator_mode(IOChannels in)
     {
         m_cfg_output_accumulator_mode = in;
     }
     void set_output_accumulator_ignore(const VRegularExpression &in)
     {
+        m_cfg_acc_ignore_noise = false;
+
         if(m_cfg_rx_output_accumulator_ignore != NULL) {
             delete m_cfg_rx_output_accumulator_ignore;
             m_cfg_rx_output_accumulator_ignore = NULL;
@@ -244,6 +356,8 @@ public:
     }
     void set_output_accumulator_ignore(char const *const in)
     {
+        m_cfg_acc_ignore_noise = false;
+
         if(m_cfg_rx_output_accumulator_ignore != NULL) {
             delete m_cfg_rx_output_accumulator_ignore;
             m_cfg_rx_output_accumulator_ignore = NULL;
@@ -259,7 +373,9 @@ public:
         return m_proc->state();
     }
 
-    explicit MpProcess(QObject *parent, MpMediaInfo *mip);
+    // manage_screensaver: false for one that must not touch the screensaver
+    // before it takes over, see set_manage_screensaver()
+    explicit MpProcess(QObject *parent, MpMediaInfo *mip, bool manage_screensaver);
     virtual ~MpProcess();
 
 protected:
@@ -269,10 +385,14 @@ public:
 
     double lastPositionRead() const;
     double currentExpectedPosition(bool maskinbadstates) const;
-    double expectedPositionAt(const QDateTime &now, bool maskinbadstates) const;
+    double expectedPositionAt(const MonoTime &now, bool maskinbadstates) const;
 
     void set_assume_aid(int aid);
     int set_assume_next_aid();
+    int current_aid() const
+    {
+        return m_current_aid;
+    }
     int find_next_alang_not_in(const QSet<QString> &forbidden) const;
 
     // Starts the MPlayer process in idle mode
@@ -285,6 +405,13 @@ public slots:
 
     // loads a file and starts to play. a slot so it can be called delayed
     void slot_load(const QString &url);
+    // loads a file that was read ahead already: only checks it can still
+    // be read, which can be long after it was read ahead
+    void slot_load_prepared(const QString &url);
+    // loads a file that was playing when the previous mplayer died: no
+    // probing, and the seek and track selection go out with the loadfile.
+    // aid, sid < 0: leave mplayer's choice
+    void slot_resume(const QString &url, double startpos, int aid, int sid);
     // slot so it can be run delayed
     void slot_pause();
     void slot_play();
@@ -297,7 +424,7 @@ public slots:
     // currently unused
     void slot_osd_show_location();
 
-    void slot_submit_write(const MpProcessCmd &mpc, const QDateTime &submittime);
+    void slot_submit_write(const MpProcessCmd &mpc, const MonoTime &submittime);
     void slot_submit_write(const QString &command);
     void slot_submit_write_latin1(char const *const latin1lit);
 
@@ -310,8 +437,7 @@ public slots:
     // internal
 
     // from the QProcess
-    void slot_readStdout();
-    void slot_readStderr();
+    void slot_pipe_lines_ready();
     void slot_finished(int, QProcess::ExitStatus);
     void slot_error_received(QProcess::ProcessError);
     void slot_started();
@@ -321,45 +447,62 @@ public slots:
     void slot_quit_if_we_are_not_playing_yet();
     void slot_heartbeat();
     void slot_try_to_write_now();
+    void slot_flush_output_queue();
+    void slot_transition_settled();
+    // from m_probe
+    void slot_probe_done();
 
 signals:
 
     void sig_stateChanged(MpState oldstate, MpState newstate);
     void sig_streamPositionChanged(double position);
     void sig_error(const QString &reason);
-    void sig_error_at_pos(const QString &reason, double lastpos);
+    // aid: the audio track till then, resetValues() forgets it right after
+    void sig_error_at_pos(const QString &reason, double lastpos, int aid);
     void sig_seekedTo(double position);
     void sig_loadDone();
 
 private:
 
-    bool allowed_to_write_now(const QDateTime &now, char const **reason);
-    void write_one_cmd(const QDateTime &now, const char *reason);
-    void try_to_write(const QDateTime &now);
+    bool allowed_to_write_now(const MonoTime &now, char const **reason);
+    void write_cmds(const MonoTime &now, const char *reason, int maxcmds);
+    bool coalesce_into_queue(const MpProcessCmd &mpc);
+    void try_to_write(const MonoTime &now);
     void force_cmd(const QString &cmd);
 
     void core_seek(double offset, MpProcess::SeekMode whence);
 
-    // Parses a line of MPlayer output
-    void parseLine(const QString &line, QStringList &positionlines, QList<MpState> &newstates, QStringList &errorreasons, QList<double> &foundspeeds);
+    // Acts on a line of MPlayer output, parsed by the MpPipeReader
+    MpLineKind parseLine(const MpLineView &line, const MpParsedLine &parsed, QByteArray &positionline, MpParsedLine &positionparsed, QList<MpState> &newstates, QStringList &errorreasons, QList<double> &foundspeeds);
     // Parses MPlayer's media identification output
-    void parseMediaInfo(const QString &line);
+    void parseMediaInfo(const QString &key, const QString &value);
     // Parses MPlayer's position output
-    void parsePosition(const QString &line, const QDateTime &readtime);
+    void parsePosition(const MpLineView &tline, const MpParsedLine &parsed, const MonoTime &readtime);
     // Changes the current state, possibly emitting multiple signals
-    void changeState(MpState state, const QDateTime &now);
+    void changeState(MpState state, const MonoTime &now);
     // Changes the current state, possibly emitting multiple signals
-    void changeToErrorState(const QString &comment, const QDateTime &now);
+    void changeToErrorState(const QString &comment, const MonoTime &now);
     // Resets the media info and position values
     void resetValues();
 
-    void proc_incremental_std(const QByteArray &bytes, IOChannel c);
+    void proc_read_lines();
     void clear_out_incremental_stdouterr();
-    void clear_out_iobuffer_before_load();
-    void update_lastreadt(const QDateTime &readtime);
+    void begin_transition(Transition t, int quiet_msec, int max_msec);
+    void cancel_transition();
+    bool note_read_during_transition();
+    void finish_stop();
+    // probe_upto: the last probe before loading, None for none
+    void begin_load(const QString &url, const QStringList &aftercmds, ProbeStage probe_upto);
+    void start_probe(ProbeStage stage);
+    ProbeStage next_probe_stage(ProbeStage stage) const;
+    void cancel_probe();
+    void continue_load();
+    void finish_load();
+    void update_lastreadt(const MonoTime &readtime);
     bool heartbeat_should_be_active() const;
     void make_heartbeat_active_or_not();
-    void streamPositionReadAt(double newpos, const QDateTime &now);
+    void ask_position_unless_confident();
+    void streamPositionReadAt(double newpos, const MonoTime &now, PositionSource src);
     double compute_seektarget_for_seek(double target, SeekMode smode) const;
     double mediainfo_length() const
     {
@@ -370,7 +513,12 @@ private:
         return m_mediaInfo->length();
     }
     void foundReadSpeed(double rspeed);
-    void dbg_out(char const *pref, const QString &line);
+    void check_for_ack(const MpLineView &bline, const MonoTime &readtime);
+    void acc_append(IOChannel c, char const *data, int len);
+    void trace_open();
+    void trace_close();
+    void trace_append(IOChannel c, const MonoTime &t, char const *data, int len);
+    void dbg_out(char const *pref, const MpLineView &bline, unsigned noise);
     void set_screensaver_by_state();
 
 
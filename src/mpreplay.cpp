@@ -0,0 +1,555 @@
+#include "mpreplay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <poll.h>
+
+#include <utility>
+
+// no Qt in here, this runs instead of the application
+
+static long long replay_now_msecs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+bool mpreplay_read_trace(char const *const tracefn, std::vector<ReplayRecord> *records)
+{
+    FILE *f = fopen(tracefn, "r");
+
+    if(f == NULL) {
+        fprintf(stderr, "MP_REPLAY: could not open %s: %s\n", tracefn, strerror(errno));
+        return false;
+    }
+
+    char *buf = NULL;
+    size_t bufsize = 0;
+    ssize_t len;
+    unsigned lineno = 0;
+
+    while((len = getline(&buf, &bufsize, f)) >= 0) {
+        lineno++;
+
+        while(len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r')) {
+            len--;
+        }
+
+        ReplayRecord r;
+        char *end = NULL;
+        r.msecs = strtoll(buf, &end, 10);
+
+        if(end == buf || end + 3 > buf + len || end[0] != ' ' || end[2] != ' ' || strchr("IOE", end[1]) == NULL) {
+            fprintf(stderr, "MP_REPLAY: %s:%u: bad record\n", tracefn, lineno);
+            continue;
+        }
+
+        r.channel = end[1];
+        r.line.assign(end + 3, buf + len - (end + 3));
+        records->push_back(r);
+    }
+
+    free(buf);
+    fclose(f);
+    return true;
+}
+
+// false on EOF or "quit"
+static bool wait_for_command()
+{
+    static std::string pending;
+    char buf[4096];
+
+    for(;;) {
+        const size_t nl = pending.find('\n');
+
+        if(nl != std::string::npos) {
+            const std::string cmd = pending.substr(0, nl);
+            pending.erase(0, nl + 1);
+            return cmd.find("quit") == std::string::npos;
+        }
+
+        const ssize_t got = ::read(STDIN_FILENO, buf, sizeof(buf));
+
+        if(got == 0) {
+            return false;
+        }
+
+        if(got < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        pending.append(buf, got);
+    }
+}
+
+static void sleep_until(long long when_msecs)
+{
+    const long long now = replay_now_msecs();
+
+    if(when_msecs <= now) {
+        return;
+    }
+
+    const long long ms = when_msecs - now;
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+
+    while(nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+int mpreplay_main(char const *const tracefn)
+{
+    std::vector<ReplayRecord> records;
+
+    if(!mpreplay_read_trace(tracefn, &records)) {
+        return 1;
+    }
+
+    // wall clock time of trace time 0
+    long long base = replay_now_msecs();
+
+    for(size_t i = 0; i < records.size(); i++) {
+        const ReplayRecord &r = records[i];
+
+        if(r.channel == 'I') {
+            if(!wait_for_command()) {
+                return 0;
+            }
+
+            base = replay_now_msecs() - r.msecs;
+            continue;
+        }
+
+        sleep_until(base + r.msecs);
+        FILE *out = (r.channel == 'O' ? stdout : stderr);
+        fwrite(r.line.data(), 1, r.line.size(), out);
+        fputc('\n', out);
+        fflush(out);
+    }
+
+    // like -idle: stay around until told to go
+    while(wait_for_command()) {
+    }
+
+    return 0;
+}
+
+// scripted responder, see mpreplay.h
+
+struct ScriptConfig {
+    // what loadfile prints, without "IDENTIFY: "
+    std::vector<std::string> identify;
+    double length;
+    std::string metadata;
+    // between status lines, 0: none
+    long long statusline_msecs;
+    // status lines written each time, to load the reader
+    int statusline_burst;
+    // before acting on a command, by its name
+    std::vector<std::pair<std::string, long long> > delays;
+};
+
+struct ScriptPlayer {
+    bool loaded;
+    bool paused;
+    bool muted;
+    int aid;
+    double speed;
+    // position at base_msecs
+    double pos;
+    long long base_msecs;
+    long long frames;
+    long long next_statusline_msecs;
+};
+
+static bool read_script(char const *const scriptfn, ScriptConfig *pc)
+{
+    pc->length = 60.;
+    pc->metadata = "title,MP_SCRIPT";
+    pc->statusline_msecs = 100;
+    pc->statusline_burst = 1;
+
+    if(scriptfn[0] == '\0') {
+        return true;
+    }
+
+    FILE *f = fopen(scriptfn, "r");
+
+    if(f == NULL) {
+        fprintf(stderr, "MP_SCRIPT: could not open %s: %s\n", scriptfn, strerror(errno));
+        return false;
+    }
+
+    char *buf = NULL;
+    size_t bufsize = 0;
+    ssize_t len;
+    unsigned lineno = 0;
+
+    while((len = getline(&buf, &bufsize, f)) >= 0) {
+        lineno++;
+
+        while(len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r')) {
+            len--;
+        }
+
+        buf[len] = '\0';
+
+        if(len == 0 || buf[0] == '#') {
+            continue;
+        }
+
+        char *arg = strchr(buf, ' ');
+
+        if(arg != NULL) {
+            *arg++ = '\0';
+        }
+        else {
+            arg = buf + len;
+        }
+
+        char name[64];
+        long long msecs;
+        int burst = 1;
+
+        if(0 == strcmp(buf, "identify")) {
+            pc->identify.push_back(arg);
+        }
+        else if(0 == strcmp(buf, "length")) {
+            pc->length = atof(arg);
+        }
+        else if(0 == strcmp(buf, "metadata")) {
+            pc->metadata = arg;
+        }
+        else if(0 == strcmp(buf, "statusline") && sscanf(arg, "%lld %d", &msecs, &burst) >= 1) {
+            pc->statusline_msecs = msecs;
+            pc->statusline_burst = (burst > 0 ? burst : 1);
+        }
+        else if(0 == strcmp(buf, "delay") && 2 == sscanf(arg, "%63s %lld", name, &msecs)) {
+            pc->delays.push_back(std::make_pair(std::string(name), msecs));
+        }
+        else {
+            fprintf(stderr, "MP_SCRIPT: %s:%u: bad line\n", scriptfn, lineno);
+        }
+    }
+
+    free(buf);
+    fclose(f);
+    return true;
+}
+
+static void script_out(char const *const fmt, ...) __attribute__((format(printf, 1, 2)));
+static void script_out(char const *const fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stdout, fmt, ap);
+    va_end(ap);
+    fflush(stdout);
+}
+
+static double script_pos(const ScriptPlayer &p, long long now)
+{
+    if(!p.loaded || p.paused) {
+        return p.pos;
+    }
+
+    return p.pos + double(now - p.base_msecs) * p.speed / 1000.;
+}
+
+// position changes are done at now
+static void script_set_pos(ScriptPlayer *pp, const ScriptConfig &cfg, double pos, long long now)
+{
+    if(pos < 0) {
+        pos = 0;
+    }
+
+    if(pos > cfg.length) {
+        pos = cfg.length;
+    }
+
+    pp->pos = pos;
+    pp->base_msecs = now;
+}
+
+static void script_statusline(ScriptPlayer *pp, long long now, bool paused)
+{
+    const double pos = script_pos(*pp, now);
+    pp->frames++;
+    script_out("STATUSLINE: A:%6.1f V:%6.1f A-V:  0.000 ct:  0.000 %4lld/%4lld  5%%  1%%  0.3%% 0 0 50%%%s",
+               pos, pos, pp->frames, pp->frames, paused ? " IDENTIFY: ID_PAUSED\n" : "\r");
+}
+
+static void script_load(ScriptPlayer *pp, const ScriptConfig &cfg, const std::string &args)
+{
+    std::string fn = args;
+    const size_t sp = fn.rfind(' ');
+
+    // loadfile <file> [append]
+    if(sp != std::string::npos && sp + 2 == fn.size() && (fn[sp + 1] == '0' || fn[sp + 1] == '1')) {
+        fn.erase(sp);
+    }
+
+    if(fn.size() >= 2 && (fn[0] == '\'' || fn[0] == '"') && fn[fn.size() - 1] == fn[0]) {
+        fn = fn.substr(1, fn.size() - 2);
+    }
+
+    script_out("Playing %s.\n", fn.c_str());
+    script_out("IDENTIFY: ID_FILENAME=%s\n", fn.c_str());
+
+    for(size_t i = 0; i < cfg.identify.size(); i++) {
+        script_out("IDENTIFY: %s\n", cfg.identify[i].c_str());
+    }
+
+    script_out("IDENTIFY: ID_LENGTH=%.2f\n", cfg.length);
+    script_out("IDENTIFY: ID_SEEKABLE=1\n");
+    script_out("CPLAYER: Starting playback...\n");
+
+    const long long now = replay_now_msecs();
+    pp->loaded = true;
+    pp->paused = false;
+    pp->frames = 0;
+    script_set_pos(pp, cfg, 0, now);
+    pp->next_statusline_msecs = now;
+}
+
+// "pausing_keep get_property pause" -> "get_property pause"
+// *pprefixed: there was one of the prefixes
+static std::string strip_pausing(const std::string &cmd, bool *pprefixed, bool *ppause_after, bool *ptoggle_after)
+{
+    static_var char const *const prefixes[] = {
+        "pausing_keep_force ",
+        "pausing_keep ",
+        "pausing_toggle ",
+        "pausing ",
+        NULL
+    };
+
+    *pprefixed = false;
+    *ppause_after = false;
+    *ptoggle_after = false;
+
+    for(int i = 0; prefixes[i] != NULL; i++) {
+        const size_t l = strlen(prefixes[i]);
+
+        if(0 == cmd.compare(0, l, prefixes[i])) {
+            *pprefixed = true;
+            *ppause_after = (i == 3);
+            *ptoggle_after = (i == 2);
+            return cmd.substr(l);
+        }
+    }
+
+    return cmd;
+}
+
+// false on "quit"
+static bool script_command(ScriptPlayer *pp, const ScriptConfig &cfg, const std::string &line)
+{
+    bool prefixed;
+    bool pause_after;
+    bool toggle_after;
+    const std::string cmd = strip_pausing(line, &prefixed, &pause_after, &toggle_after);
+    const size_t sp = cmd.find(' ');
+    const std::string verb = cmd.substr(0, sp);
+    const std::string args = (sp == std::string::npos ? std::string() : cmd.substr(sp + 1));
+
+    for(size_t i = 0; i < cfg.delays.size(); i++) {
+        if(cfg.delays[i].first == verb) {
+            sleep_until(replay_now_msecs() + cfg.delays[i].second);
+            break;
+        }
+    }
+
+    const long long now = replay_now_msecs();
+
+    if(verb == "quit") {
+        return false;
+    }
+    else if(verb == "loadfile") {
+        script_load(pp, cfg, args);
+    }
+    else if(verb == "seek") {
+        double value = 0;
+        int type = 0;
+        sscanf(args.c_str(), "%lf %d", &value, &type);
+
+        if(pp->loaded) {
+            const double cur = script_pos(*pp, now);
+            script_set_pos(pp, cfg, type == 2 ? value : (type == 1 ? cfg.length * value / 100. : cur + value), now);
+        }
+    }
+    else if(verb == "pause") {
+        toggle_after = !toggle_after;
+    }
+    else if(verb == "stop") {
+        pp->loaded = false;
+    }
+    else if(verb == "mute") {
+        pp->muted = (args.empty() ? !pp->muted : atoi(args.c_str()) != 0);
+    }
+    else if(verb == "switch_audio") {
+        pp->aid = atoi(args.c_str());
+    }
+    else if(verb == "speed_set") {
+        script_set_pos(pp, cfg, script_pos(*pp, now), now);
+        pp->speed = atof(args.c_str());
+    }
+    else if(verb == "get_time_pos") {
+        script_out("GLOBAL: ANS_TIME_POSITION=%.1f\n", script_pos(*pp, now));
+    }
+    else if(verb == "get_time_length") {
+        script_out("GLOBAL: ANS_LENGTH=%.2f\n", cfg.length);
+    }
+    else if(verb == "get_property") {
+        if(args == "pause") {
+            script_out("GLOBAL: ANS_pause=%s\n", pp->paused ? "yes" : "no");
+        }
+        else if(args == "mute") {
+            script_out("GLOBAL: ANS_mute=%s\n", pp->muted ? "yes" : "no");
+        }
+        else if(args == "switch_audio") {
+            script_out("GLOBAL: ANS_switch_audio=%d\n", pp->aid);
+        }
+        else if(args == "speed") {
+            script_out("GLOBAL: ANS_speed=%.2f\n", pp->speed);
+        }
+        else if(args == "time_pos") {
+            script_out("GLOBAL: ANS_time_pos=%.3f\n", script_pos(*pp, now));
+        }
+        else if(args == "metadata") {
+            script_out("GLOBAL: ANS_metadata=%s\n", cfg.metadata.c_str());
+        }
+        else {
+            script_out("GLOBAL: ANS_ERROR=PROPERTY_UNKNOWN\n");
+        }
+    }
+
+    // like mplayer, any other command without a prefix ends a pause
+    if(!prefixed && verb != "pause" && pp->paused) {
+        toggle_after = true;
+    }
+
+    if(pp->loaded && (toggle_after || (pause_after && !pp->paused))) {
+        script_set_pos(pp, cfg, script_pos(*pp, now), now);
+        pp->paused = !pp->paused;
+
+        if(pp->paused) {
+            script_statusline(pp, now, true);
+        }
+        else {
+            pp->next_statusline_msecs = now;
+        }
+    }
+
+    return true;
+}
+
+int mpreplay_script_main(char const *const scriptfn)
+{
+    ScriptConfig cfg;
+
+    if(!read_script(scriptfn, &cfg)) {
+        return 1;
+    }
+
+    ScriptPlayer p;
+    p.loaded = false;
+    p.paused = false;
+    p.muted = false;
+    p.aid = 0;
+    p.speed = 1.;
+    p.pos = 0.;
+    p.base_msecs = replay_now_msecs();
+    p.frames = 0;
+    p.next_statusline_msecs = 0;
+
+    std::string pending;
+    char buf[4096];
+
+    for(;;) {
+        long long now = replay_now_msecs();
+        const bool playing = (p.loaded && !p.paused);
+
+        if(playing && script_pos(p, now) >= cfg.length) {
+            script_set_pos(&p, cfg, cfg.length, now);
+            p.loaded = false;
+            script_out("\nGLOBAL: EOF code: 1\n");
+            continue;
+        }
+
+        if(playing && cfg.statusline_msecs > 0 && now >= p.next_statusline_msecs) {
+            for(int i = 0; i < cfg.statusline_burst; i++) {
+                script_statusline(&p, now, false);
+            }
+
+            p.next_statusline_msecs = now + cfg.statusline_msecs;
+        }
+
+        int timeout = (-1);
+
+        if(playing && cfg.statusline_msecs > 0) {
+            timeout = int(p.next_statusline_msecs - now);
+        }
+        else if(playing) {
+            // to notice the end of the file
+            timeout = 100;
+        }
+
+        struct pollfd pfd;
+        pfd.fd = STDIN_FILENO;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        const int pr = ::poll(&pfd, 1, timeout < 0 ? -1 : timeout);
+
+        if(pr < 0 && errno != EINTR) {
+            return 1;
+        }
+
+        if(pr <= 0) {
+            continue;
+        }
+
+        const ssize_t got = ::read(STDIN_FILENO, buf, sizeof(buf));
+
+        if(got == 0) {
+            return 0;
+        }
+
+        if(got < 0) {
+            if(errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+
+            return 1;
+        }
+
+        pending.append(buf, got);
+
+        for(size_t nl = pending.find('\n'); nl != std::string::npos; nl = pending.find('\n')) {
+            std::string cmd = pending.substr(0, nl);
+            pending.erase(0, nl + 1);
+
+            while(!cmd.empty() && (cmd[cmd.size() - 1] == '\r' || cmd[cmd.size() - 1] == ' ')) {
+                cmd.erase(cmd.size() - 1);
+            }
+
+            if(!cmd.empty() && !script_command(&p, cfg, cmd)) {
+                return 0;
+            }
+        }
+    }
+}
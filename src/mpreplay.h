@@ -0,0 +1,55 @@
+#ifndef MPREPLAY_H
+#define MPREPLAY_H
+
+#include <string>
+#include <vector>
+
+// An mplayer stand-in that plays back a trace recorded with MP_TRACE, so
+// MpProcess can be exercised without mplayer, a video or a GPU.
+//
+// Trace format, one record per line:
+//   <msecs since start> <I|O|E> <line as written or read>
+// I is what we wrote to mplayer, O and E what it wrote to stdout / stderr.
+//
+// O and E records are written with their original timing. At an I record,
+// playback waits for the next command on stdin and continues timed from
+// there, so the replay follows the caller, not the wall clock of the
+// recording. "quit" ends it; so does EOF on stdin.
+//
+// Run by singleplayer-main when it is started as "-slave ..." with
+// MP_REPLAY=<trace> in the environment, i.e. with MP_PATH pointing to
+// the singleplayer binary itself.
+int mpreplay_main(char const *const tracefn);
+
+struct ReplayRecord {
+    long long msecs;
+    // I, O or E
+    char channel;
+    std::string line;
+};
+
+// An mplayer stand-in that answers commands from a script instead, for
+// tests and benchmarks that need mplayer to follow them. It speaks
+//   loadfile   prints the identify lines, ID_LENGTH, "Starting playback..."
+//              and then status lines while playing, up to "EOF code: 1"
+//   seek, pause, stop, mute, switch_audio, speed_set, quit
+//   get_time_pos, get_time_length
+//   get_property pause, mute, switch_audio, speed, time_pos, metadata
+// with or without the pausing prefixes, and ignores everything else.
+// Script lines, all optional:
+//   identify ID_VIDEO_WIDTH=640   printed by loadfile, one per line
+//   length 60                     seconds
+//   metadata title,Foo            the ANS_metadata reply
+//   statusline 100 [1]            msecs between status lines, 0: none,
+//                                 and how many are written each time
+//   delay seek 200                msecs before a command is acted on
+// An empty file name uses the defaults.
+//
+// Run by singleplayer-main when it is started as "-slave ..." with
+// MP_SCRIPT=<script> in the environment.
+int mpreplay_script_main(char const *const scriptfn);
+
+// false if the trace can not be opened, bad records are skipped
+bool mpreplay_read_trace(char const *const tracefn, std::vector<ReplayRecord> *records);
+
+#endif // MPREPLAY_H
@@ -0,0 +1,246 @@
+#include "mpstatusline.h"
+
+#include <cstring>
+
+static bool is_separator(char c)
+{
+    return c == ' ' || c == ':' || c == '\t';
+}
+
+// next token separated by spaces or colons, false at the end of the line
+static bool next_token(const MpLineView &line, int *ppos, MpLineView *ptok)
+{
+    int pos = *ppos;
+
+    while(pos < line.len && is_separator(line.data[pos])) {
+        pos++;
+    }
+
+    if(pos >= line.len) {
+        *ppos = pos;
+        return false;
+    }
+
+    const int start = pos;
+
+    while(pos < line.len && !is_separator(line.data[pos])) {
+        pos++;
+    }
+
+    ptok->data = line.data + start;
+    ptok->len = pos - start;
+    *ppos = pos;
+    return true;
+}
+
+static bool token_is(const MpLineView &tok, char const *const latin1lit)
+{
+    const int l = ::strlen(latin1lit);
+    return tok.len == l && 0 == ::memcmp(tok.data, latin1lit, l);
+}
+
+// "28%" or "1.2%"
+static bool token_to_percent(const MpLineView &tok, double *pret)
+{
+    if(tok.len < 2 || tok.data[tok.len - 1] != '%') {
+        return false;
+    }
+
+    MpLineView num = tok;
+    num.len--;
+    return mpline_to_double(num, pret);
+}
+
+enum class Key {
+    None,
+    A,
+    V,
+    AV,
+    Ct
+};
+
+// what comes after the timestamps, in this order
+enum class Field {
+    Frames,
+    Decoded,
+    VcCpu,
+    VoCpu,
+    AcCpu,
+    Dropped,
+    Quality,
+    Cache,
+    Done
+};
+
+bool mpstatusline_parse(const MpLineView &line, MpStatusLine *ps)
+{
+    ::memset(ps, 0, sizeof(*ps));
+
+    int pos = 0;
+    MpLineView tok;
+    Key key = Key::None;
+    Field field = Field::Frames;
+
+    while(next_token(line, &pos, &tok)) {
+        if(key != Key::None) {
+            double d;
+
+            if(!mpline_to_double(tok, &d)) {
+                return false;
+            }
+
+            switch(key) {
+                case Key::A:
+                    ps->has_a = true;
+                    ps->a = d;
+                    break;
+
+                case Key::V:
+                    ps->has_v = true;
+                    ps->v = d;
+                    break;
+
+                case Key::AV:
+                    ps->has_av = true;
+                    ps->av = d;
+                    break;
+
+                case Key::Ct:
+                    ps->has_ct = true;
+                    ps->ct = d;
+                    break;
+
+                case Key::None:
+                    break;
+            }
+
+            key = Key::None;
+            continue;
+        }
+
+        if(token_is(tok, "A")) {
+            key = Key::A;
+            continue;
+        }
+
+        if(token_is(tok, "V")) {
+            key = Key::V;
+            continue;
+        }
+
+        if(token_is(tok, "A-V")) {
+            key = Key::AV;
+            continue;
+        }
+
+        if(token_is(tok, "ct")) {
+            key = Key::Ct;
+            continue;
+        }
+
+        // only video lines have the counters, and any surprise ends them
+        if(!ps->has_v || field == Field::Done) {
+            continue;
+        }
+
+        switch(field) {
+            case Field::Frames: {
+                // "0/" followed by "0", or "0/0"
+                char const *const slash = (char const *)::memchr(tok.data, '/', tok.len);
+
+                if(slash == NULL) {
+                    field = Field::Done;
+                    break;
+                }
+
+                MpLineView num;
+                num.data = tok.data;
+                num.len = slash - tok.data;
+
+                if(!mpline_to_int(num, &ps->frames)) {
+                    field = Field::Done;
+                    break;
+                }
+
+                num.data = slash + 1;
+                num.len = tok.len - num.len - 1;
+
+                if(num.len == 0) {
+                    field = Field::Decoded;
+                }
+                else if(mpline_to_int(num, &ps->decoded)) {
+                    ps->has_frames = true;
+                    field = Field::VcCpu;
+                }
+                else {
+                    field = Field::Done;
+                }
+
+                break;
+            }
+
+            case Field::Decoded:
+                if(mpline_to_int(tok, &ps->decoded)) {
+                    ps->has_frames = true;
+                    field = Field::VcCpu;
+                }
+                else {
+                    field = Field::Done;
+                }
+
+                break;
+
+            case Field::VcCpu:
+                field = (token_to_percent(tok, &ps->vc_cpu) ? Field::VoCpu : Field::Done);
+                break;
+
+            case Field::VoCpu:
+                field = (token_to_percent(tok, &ps->vo_cpu) ? Field::AcCpu : Field::Done);
+                break;
+
+            case Field::AcCpu:
+                if(token_to_percent(tok, &ps->ac_cpu)) {
+                    ps->has_cpu = true;
+                    field = Field::Dropped;
+                }
+                else {
+                    field = Field::Done;
+                }
+
+                break;
+
+            case Field::Dropped:
+                if(mpline_to_int(tok, &ps->dropped)) {
+                    ps->has_dropped = true;
+                    field = Field::Quality;
+                }
+                else {
+                    field = Field::Done;
+                }
+
+                break;
+
+            case Field::Quality:
+                if(mpline_to_int(tok, &ps->quality)) {
+                    ps->has_quality = true;
+                    field = Field::Cache;
+                }
+                else {
+                    field = Field::Done;
+                }
+
+                break;
+
+            case Field::Cache:
+                ps->has_cache = token_to_percent(tok, &ps->cache);
+                field = Field::Done;
+                break;
+
+            case Field::Done:
+                break;
+        }
+    }
+
+    // a key at the very end of the line
+    return key == Key::None;
+}
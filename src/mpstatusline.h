@@ -0,0 +1,46 @@
+#ifndef MPSTATUSLINE_H
+#define MPSTATUSLINE_H
+
+#include "mplinedispatch.h"
+
+// Everything mplayer puts into a status line
+//   A: 913.6 V: 897.9 A-V: 15.733 ct:  3.697   0/  0 28%  3%  1.2% 465 0 50%
+// audio only:
+//   A: 12.3 (12.3) of 100.0 (01:40.0)  0.5%
+// Fields that were not in the line keep their has_ flag false.
+struct MpStatusLine {
+    bool has_a;
+    double a;
+    bool has_v;
+    double v;
+    bool has_av;
+    double av;
+    bool has_ct;
+    double ct;
+
+    // "frames/decoded" after ct
+    bool has_frames;
+    int frames;
+    int decoded;
+
+    // CPU usage of video codec, video output and audio codec in percent
+    bool has_cpu;
+    double vc_cpu;
+    double vo_cpu;
+    double ac_cpu;
+
+    bool has_dropped;
+    int dropped;
+    bool has_quality;
+    int quality;
+
+    bool has_cache;
+    double cache;
+};
+
+// Parses the part of the line after "STATUSLINE:" (or the whole line,
+// the prefix is skipped if present) in a single pass over the bytes.
+// Returns false if one of A, V, A-V or ct is not followed by a number.
+bool mpstatusline_parse(const MpLineView &line, MpStatusLine *ps);
+
+#endif // MPSTATUSLINE_H
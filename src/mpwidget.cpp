@@ -25,6 +25,8 @@
 
 #include "mpprocess.h"
 #include "mpplainvideowidget.h"
+#include "playbackprefetcher.h"
+#include "remote_local.h"
 #include "util.h"
 #include "gui_overlayquit.h"
 #include "safe_signals.h"
@@ -43,6 +45,10 @@ static Q_LOGGING_CATEGORY(category_cwng, THIS_SOURCE_FILE_LOG_CATEGORY_CWNG)
 
 // give up after that many crashes
 static_var const unsigned MP_PROCESS_MAX_START_COUNT = 20;
+// start the standby mplayer that long after a load is done, off the critical path
+static_var const int standby_start_delay_ms = 3000;
+// stop keeping a standby mplayer after it failed that often
+static_var const unsigned standby_max_failcount = 3;
 // accumulate that many output lines
 static_var const unsigned max_lines_to_accumulate = 10000;
 // hide the seek slider after that many milliseconds
@@ -97,29 +103,108 @@ void MpWidget::init_process()
 
     m_process_startcount++;
 
-    m_process = new MpProcess(this, &m_mediaInfo);
-
-    m_process->set_output_accumulator_mode(MpProcess::Input | MpProcess::Output | MpProcess::Error);
-    m_process->set_accumulated_output_maxlines(max_lines_to_accumulate);
-    m_process->set_output_accumulator_ignore_default();
-
-    if(!m_videooutput.isEmpty()) {
-        m_process->setVideoOutput(m_videooutput);
+    if(m_standby != NULL && m_standby->processState() == QProcess::Running && m_standby_args == process_args()) {
+        MYDBG("init_process(): taking over the standby mplayer");
+        m_process = m_standby;
+        m_process_args = m_standby_args;
+        m_process->disconnect(this);
+        m_process->set_manage_screensaver(true);
+        m_standby = NULL;
+        m_standby_args.clear();
     }
-
-    if(!m_mplayerpath.isEmpty()) {
-        m_process->setMplayerPath(m_mplayerpath);
+    else {
+        drop_standby();
+        m_process = make_process(true);
+        m_process_args.clear();
     }
 
     XCONNECT(m_process, SIGNAL(sig_stateChanged(MpState, MpState)), this, SLOT(slot_mpStateChanged(MpState, MpState)), QUEUEDCONN);
     XCONNECT(m_process, SIGNAL(sig_streamPositionChanged(double)), this, SLOT(slot_mpStreamPositionChanged(double)), QUEUEDCONN);
-    XCONNECT(m_process, SIGNAL(sig_error_at_pos(QString, double)), this, SLOT(slot_error_received_at(QString, double)), QUEUEDCONN);
+    XCONNECT(m_process, SIGNAL(sig_error_at_pos(QString, double, int)), this, SLOT(slot_error_received_at(QString, double, int)), QUEUEDCONN);
     XCONNECT(m_process, SIGNAL(sig_loadDone()), this, SIGNAL(sig_loadDone()), QUEUEDCONN);
     XCONNECT(m_process, SIGNAL(sig_loadDone()), this, SLOT(slot_load_is_done()), QUEUEDCONN);
     XCONNECT(m_process, SIGNAL(sig_seekedTo(double)), this, SLOT(slot_mpSeekedTo(double)), QUEUEDCONN);
 
 }
 
+MpProcess *MpWidget::make_process(bool manage_screensaver)
+{
+    MpProcess *ret = new MpProcess(this, &m_mediaInfo, manage_screensaver);
+
+    ret->set_output_accumulator_mode(MpProcess::Input | MpProcess::Output | MpProcess::Error);
+    ret->set_accumulated_output_maxlines(max_lines_to_accumulate);
+    ret->set_output_accumulator_ignore_default();
+
+    if(!m_videooutput.isEmpty()) {
+        ret->setVideoOutput(m_videooutput);
+    }
+
+    if(!m_mplayerpath.isEmpty()) {
+        ret->setMplayerPath(m_mplayerpath);
+    }
+
+    if(!m_tracefile.isEmpty()) {
+        ret->set_trace_file(m_tracefile);
+    }
+
+    return ret;
+}
+
+void MpWidget::drop_standby()
+{
+    if(m_standby == NULL) {
+        return;
+    }
+
+    MYDBG("dropping the standby mplayer");
+    MpProcess *copy = m_standby;
+    m_standby = NULL;
+    m_standby_args.clear();
+    copy->disconnect(this);
+    copy->disconnect();
+    copy->quit();
+    copy->deleteLater();
+}
+
+/*!
+ * \brief Starts an idle MPlayer to replace the current one when it dies
+ * \details
+ * The standby MPlayer is embedded into the same window as the current one: it
+ * does not touch the window before it loads something, and once it does, it
+ * is the only one left. Not done while tracing, as both would write the
+ * same trace file.
+ */
+void MpWidget::slot_start_standby()
+{
+    if(m_stay_dead || m_standby != NULL || m_process == NULL || !m_tracefile.isEmpty()) {
+        return;
+    }
+
+    if(m_standby_failcount >= standby_max_failcount) {
+        return;
+    }
+
+    MYDBG("starting a standby mplayer");
+    // the one playing owns the screensaver, not this
+    m_standby = make_process(false);
+    m_standby_args = process_args();
+    XCONNECT(m_standby, SIGNAL(sig_error_at_pos(QString, double, int)), this, SLOT(slot_standby_error(QString, double)), QUEUEDCONN);
+    m_standby->start_process(m_widget->winId(), m_standby_args);
+}
+
+void MpWidget::slot_standby_error(const QString &s, double lastpos)
+{
+    Q_UNUSED(lastpos);
+
+    if(sender() != m_standby) {
+        return;
+    }
+
+    m_standby_failcount++;
+    qWarning("standby mplayer failed (%u times): \"%s\"", m_standby_failcount, qPrintable(s));
+    drop_standby();
+}
+
 static QToolButton *make_button(char const *const oN_latin1lit, QWidget *parent, QIcon &icon)
 {
     QToolButton *but = new QToolButton;
@@ -154,6 +239,13 @@ MpWidget::MpWidget(QWidget *parent, bool fullscreen)
     , m_fullscreen(fullscreen)
     , m_process(NULL)
     , m_process_startcount(0)
+    , m_current_sid(-1)
+    , m_resume_aid(-1)
+    , m_resume_sid(-1)
+    , m_resuming(false)
+    , m_prefetcher(NULL)
+    , m_standby(NULL)
+    , m_standby_failcount(0)
     , m_background(NULL)
     , m_widget(NULL)
     , m_seek_slider(NULL)
@@ -381,6 +473,7 @@ MpWidget::~MpWidget()
     MYDBG("MpWidget::~MpWidget");
     m_stay_dead = true;
 
+    drop_prefetcher();
 
     if(m_process != NULL) {
         MYDBG("deleting m_process");
@@ -398,6 +491,18 @@ MpWidget::~MpWidget()
         MYDBG("m_process is NULL");
     }
 
+    if(m_standby != NULL) {
+        MpProcess *copy = m_standby;
+        m_standby = NULL;
+        copy->disconnect(this);
+
+        if(copy->processState() == QProcess::Running) {
+            copy->quit();
+        }
+
+        delete copy;
+    }
+
     delete m_background;
     m_background = NULL;
 
@@ -405,14 +510,14 @@ MpWidget::~MpWidget()
     m_widget = NULL;
 }
 
-void MpWidget::slot_error_received_at(const QString &s, double lastpos)
+void MpWidget::slot_error_received_at(const QString &s, double lastpos, int aid)
 {
     if(m_stay_dead) {
-        MYDBG("slot_error_received_at(%s, %f), and m_stay_dead", qPrintable(s), lastpos);
+        MYDBG("slot_error_received_at(%s, %f, %d), and m_stay_dead", qPrintable(s), lastpos, aid);
         return;
     }
 
-    MYDBG("slot_error_received_at(%s, %f)", qPrintable(s), lastpos);
+    MYDBG("slot_error_received_at(%s, %f, %d)", qPrintable(s), lastpos, aid);
 
     if(lastpos < 0) {
         lastpos = 0.;
@@ -421,6 +526,11 @@ void MpWidget::slot_error_received_at(const QString &s, double lastpos)
     QString url = m_currently_playing;
     MpMediaInfo mmi = m_mediaInfo;
 
+    m_resume_url = url;
+    // m_process forgot it by now
+    m_resume_aid = (mmi.is_finalized() ? aid : (-1));
+    m_resume_sid = m_current_sid;
+
     qWarning("restarting process after error \"%s\" with %s at %f", qPrintable(s), qPrintable(url), lastpos);
 
     init_process();
@@ -445,6 +555,25 @@ void MpWidget::slot_load_is_done()
         set_deinterlace(true);
     }
 
+    if(m_standby == NULL) {
+        QTimer::singleShot(standby_start_delay_ms, this, SLOT(slot_start_standby()));
+    }
+
+    drop_prefetcher();
+
+    if(PlaybackPrefetcher::configured_window_secs() > 0 && path_is_definitely_remote(m_currently_playing.toLocal8Bit().constData())) {
+        m_prefetcher = new PlaybackPrefetcher(this, m_currently_playing, (m_mediaInfo.has_length() ? m_mediaInfo.length() : 0.), m_mediaInfo.total_bitrate());
+        m_prefetcher->set_playing(m_process != NULL && m_process->state() == MpState::PlayingState);
+    }
+
+    if(m_resuming) {
+        // resume() sent the tracks and the start position with the load
+        MYDBG("slot_load_is_done: resumed, keeping tracks");
+        m_resuming = false;
+        m_startpos = 0.;
+        return;
+    }
+
     foreach(const QString &al, m_preferred_alangs) {
         if(try_alang(al)) {
             break;
@@ -543,6 +672,7 @@ void MpWidget::setVideoOutput(const QString &output)
 {
     m_process->setVideoOutput(output);
     m_videooutput = output;
+    drop_standby();
 }
 
 /*!
@@ -581,6 +711,7 @@ void MpWidget::setMPlayerPath(const QString &path)
 {
     m_process->setMplayerPath(path);
     m_mplayerpath = path;
+    drop_standby();
 }
 
 /*!
@@ -594,12 +725,27 @@ const QString &MpWidget::mplayerPath() const
     return m_process->mplayerPath();
 }
 
+/*!
+ * \brief Records all I/O with MPlayer to a file
+ * \details
+ * The trace can be played back by the MPlayer stand-in in mpreplay.h.
+ * Takes effect when the next MPlayer process is started.
+ *
+ * \param fn trace file, overwritten for every MPlayer process
+ */
+void MpWidget::setMPlayerTraceFile(const QString &fn)
+{
+    m_process->set_trace_file(fn);
+    m_tracefile = fn;
+    drop_standby();
+}
+
 const QStringList &MpWidget::processed_mplayer_args() const
 {
     return m_process->mplayer_args();
 }
 
-const QList<MpProcess::MpProcessIolog> &MpWidget::mplayer_out() const
+const MyObjectRing<MpProcess::MpProcessIolog> &MpWidget::mplayer_out() const
 {
     return m_process->accumulated_output();
 }
@@ -663,13 +809,44 @@ QSize MpWidget::sizeHint() const
  */
 void MpWidget::start_process()
 {
+    const QStringList args = process_args();
+
     if(m_process->processState() == QProcess::Running) {
+        if(m_process_args == args && m_process->state() == MpState::IdleState) {
+            MYDBG("start() called but an idle mplayer with these arguments is running already");
+            return;
+        }
+
         MYDBG("start() called but previously running, invoking quit()");
         m_process->quit();
     }
 
-    int xwinid = m_widget->winId();
+    m_process_args = args;
+    m_process->start_process(m_widget->winId(), args);
+}
+
+/*!
+ * \brief Replaces the MPlayer process by a new one
+ * \details
+ * For arguments that changed since start_process(). Asked for, so it does not
+ * count towards giving up like a restart after an error does.
+ */
+void MpWidget::restart_process()
+{
+    MYDBG("restart_process()");
+    init_process();
+
+    if(m_process == NULL) {
+        return;
+    }
 
+    m_process_startcount--;
+    start_process();
+}
+
+// arguments to MpProcess::start_process() on top of the ones it always passes
+QStringList MpWidget::process_args() const
+{
     QStringList args = m_args;
 
     if(!m_preferred_alangs.isEmpty() && m_preferred_alangs.first() != QLatin1String("FIRST")) {
@@ -682,7 +859,7 @@ void MpWidget::start_process()
         args += m_preferred_slangs.join(QStringLiteral(","));
     }
 
-    m_process->start_process(xwinid, args);
+    return args;
 }
 
 /*!
@@ -692,6 +869,70 @@ void MpWidget::start_process()
  */
 void MpWidget::load(const QString &url, const MpMediaInfo &mmi, const double startpos)
 {
+    prepare_load(url, mmi);
+
+    m_startpos = startpos;
+    m_current_sid = (-1);
+    m_resuming = false;
+
+    MYDBG("xinvokeMethod m_process.slot_load(%s)", qPrintable(url));
+    xinvokeMethod(m_process, "slot_load", QUEUEDCONN, Q_ARG(QString, url));
+}
+
+/*!
+ * \brief Loads a file that has been read ahead already
+ * \details
+ * Like load(), but MPlayer is not kept waiting for the file to be probed.
+ *
+ * \param url File path or url
+ * \param mmi what is known about the file
+ */
+void MpWidget::load_prepared(const QString &url, const MpMediaInfo &mmi)
+{
+    prepare_load(url, mmi);
+
+    m_startpos = 0.;
+    m_current_sid = (-1);
+    m_resuming = false;
+
+    MYDBG("xinvokeMethod m_process.slot_load_prepared(%s)", qPrintable(url));
+    xinvokeMethod(m_process, "slot_load_prepared", QUEUEDCONN, Q_ARG(QString, url));
+}
+
+/*!
+ * \brief Loads the file the previous MPlayer died on and continues playback
+ * \details
+ * Reuses what is known about the file: the start position and the audio and
+ * subtitle tracks go to MPlayer together with the load, instead of after
+ * the identification, and the file is not probed again. Falls back to
+ * load() if the file did not finish loading before.
+ *
+ * \param url File path or url
+ * \param mmi media info as passed by sig_error_while()
+ * \param startpos where to continue
+ */
+void MpWidget::resume(const QString &url, const MpMediaInfo &mmi, const double startpos)
+{
+    if(url != m_resume_url || !mmi.is_finalized()) {
+        MYDBG("resume(%s): nothing to resume from, loading", qPrintable(url));
+        load(url, mmi, startpos);
+        return;
+    }
+
+    prepare_load(url, mmi);
+
+    m_startpos = 0.;
+    m_current_sid = m_resume_sid;
+    m_resuming = true;
+
+    MYDBG("xinvokeMethod m_process.slot_resume(%s, %f, %d, %d)", qPrintable(url), startpos, m_resume_aid, m_resume_sid);
+    xinvokeMethod(m_process, "slot_resume", QUEUEDCONN, Q_ARG(QString, url), Q_ARG(double, startpos), Q_ARG(int, m_resume_aid), Q_ARG(int, m_resume_sid));
+}
+
+void MpWidget::prepare_load(const QString &url, const MpMediaInfo &mmi)
+{
+    drop_prefetcher();
+
     m_widget->hide();
     m_hourglass->show();
     m_hourglass->raise();
@@ -714,12 +955,7 @@ void MpWidget::load(const QString &url, const MpMediaInfo &mmi, const double sta
 
     connect_seekslider(true);
 
-    m_startpos = startpos;
-
     m_currently_playing = url;
-
-    MYDBG("xinvokeMethod m_process.slot_load(%s)", qPrintable(url));
-    xinvokeMethod(m_process, "slot_load", QUEUEDCONN, Q_ARG(QString, url));
 }
 
 /*!
@@ -821,6 +1057,8 @@ void MpWidget::cycle_alang()
 }
 void MpWidget::cycle_slang()
 {
+    // mplayer picks the next one
+    m_current_sid = (-1);
     const QString cmd = QStringLiteral("sub_select");
     MYDBG("xinvokeMethod m_process.slot_submit_write(%s)", qPrintable(cmd));
     xinvokeMethod(m_process, "slot_submit_write", QUEUEDCONN, Q_ARG(const QString &, cmd));
@@ -1295,6 +1533,7 @@ bool MpWidget::try_slang(const QString &slang)
     MYDBG("strack %d is in %s", sid, qPrintable(slang));
     QString cmd = QString(QStringLiteral("sub_demux %1")).arg(sid);
     submit_write(cmd);
+    m_current_sid = sid;
     //slot_submit_write_latin1("get_property sub");
     return true;
 }
@@ -1364,6 +1603,10 @@ void MpWidget::slot_mpStateChanged(MpState oldstate, MpState newstate)
         m_seek_slider->setEnabled(false);
     }
 
+    if(m_prefetcher != NULL) {
+        m_prefetcher->set_playing(newstate == MpState::PlayingState);
+    }
+
     if(oldstate == MpState::LoadingState) {
         m_hourglass->hide();
         m_widget->show();
@@ -1392,8 +1635,18 @@ void MpWidget::adjust_slider_to(double position)
 
 }
 
+void MpWidget::drop_prefetcher()
+{
+    delete m_prefetcher;
+    m_prefetcher = NULL;
+}
+
 void MpWidget::slot_mpStreamPositionChanged(double position)
 {
+    if(m_prefetcher != NULL) {
+        m_prefetcher->set_position(position);
+    }
+
     if(!m_seek_slider->isSliderDown()) {
         MYDBG("slot_mpStreamPositionChanged(%f) and slider is not down", position);
         adjust_slider_to(position);
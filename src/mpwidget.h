@@ -34,6 +34,7 @@ class QSvgRenderer;
 class OverlayQuit;
 class QToolButton;
 class QIcon;
+class PlaybackPrefetcher;
 
 #include "mpprocess.h"
 
@@ -54,8 +55,24 @@ private:
     bool m_fullscreen;
     MpProcess *m_process;
     unsigned m_process_startcount;
+    // an idle mplayer, started ahead of time to replace m_process when it dies
+    MpProcess *m_standby;
+    // what m_process and m_standby were started with, see process_args()
+    QStringList m_process_args;
+    QStringList m_standby_args;
+    unsigned m_standby_failcount;
     MpMediaInfo m_mediaInfo;
     QString m_currently_playing;
+    // subtitle track selected by try_slang(), -1 if not known
+    int m_current_sid;
+    // what was playing when the last mplayer died, for resume()
+    QString m_resume_url;
+    int m_resume_aid;
+    int m_resume_sid;
+    // resume() is loading, the tracks are selected already
+    bool m_resuming;
+    // keeps reading ahead of playback, for remote files only
+    PlaybackPrefetcher *m_prefetcher;
 
     QWidget *m_background;
     MpPlainVideoWidget *m_widget;
@@ -82,6 +99,7 @@ private:
     QStringList m_preferred_slangs;
     QString m_videooutput;
     QString m_mplayerpath;
+    QString m_tracefile;
     bool m_stay_dead;
 
     double m_startpos;
@@ -126,8 +144,10 @@ public:
     void setMPlayerPath(const QString &path);
     const QString &mplayerPath() const;
 
+    void setMPlayerTraceFile(const QString &fn);
+
     const QStringList &processed_mplayer_args() const;
-    const QList<MpProcess::MpProcessIolog> &mplayer_out() const;
+    const MyObjectRing<MpProcess::MpProcessIolog> &mplayer_out() const;
 
     void set_preferred_alangs(const QStringList &als);
     void set_preferred_slangs(const QStringList &sls);
@@ -139,14 +159,25 @@ public:
     void set_crop(const QString &);
 
     void start_process();
+    // a new mplayer, e.g. for new setMplayerArgs()
+    void restart_process();
     void load(const QString &url, const MpMediaInfo &mmi, const double startpos = 0.);
+    // like load(), for a file NextItemPreparer has read ahead and identified
+    void load_prepared(const QString &url, const MpMediaInfo &mmi);
+    // like load(), for the file the previous mplayer died on
+    void resume(const QString &url, const MpMediaInfo &mmi, const double startpos);
 
 private:
     QRect compute_widget_new_geom() const;
     void connect_seekslider(bool doconnect);
+    void prepare_load(const QString &url, const MpMediaInfo &mmi);
     void init_process();
+    MpProcess *make_process(bool manage_screensaver);
+    QStringList process_args() const;
+    void drop_standby();
     QString sliderlabelstring(double pos) const;
     void adjust_slider_to(double position);
+    void drop_prefetcher();
     void set_deinterlace(bool toggle);
     void submit_write(const QString &command);
     void submit_write_latin1(char const *const latin1lit);
@@ -169,7 +200,9 @@ public slots:
     void slot_mpStreamPositionChanged(double position);
     void slot_mpSeekedTo(double position);
     void slot_load_is_done();
-    void slot_error_received_at(const QString &s, double lastpos);
+    void slot_error_received_at(const QString &s, double lastpos, int aid);
+    // from m_standby
+    void slot_standby_error(const QString &s, double lastpos);
 
     // internal, from timers etc
     void slot_hidemouse();
@@ -181,6 +214,8 @@ public slots:
     // internal, after a delay
     void slot_show_helpscreen();
     void slot_set_not_showing_help();
+    // internal, after a load is done
+    void slot_start_standby();
 
     // from QToolButtons
     void slot_tb_playpause_clicked();
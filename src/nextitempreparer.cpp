@@ -0,0 +1,237 @@
+#include "nextitempreparer.h"
+
+#include "asyncprobe.h"
+#include "cropdetector.h"
+#include "mountthroughput.h"
+#include "safe_signals.h"
+#include "event_desc.h"
+#include "util.h"
+
+#include <QRegExp>
+
+#include <QLoggingCategory>
+#define THIS_SOURCE_FILE_LOG_CATEGORY "NIP"
+static Q_LOGGING_CATEGORY(category, THIS_SOURCE_FILE_LOG_CATEGORY)
+#define MYDBG(msg, ...) qCDebug(category, msg, ##__VA_ARGS__)
+
+// read that much of the next file ahead, as much as MpProcess checks before a load
+static_var const off_t warmup_KBytes = 16 * 1024;
+// give up reading ahead after that long
+static_var const qint64 warmup_timeout_ms = 30000;
+// a crop cache is one line, anything bigger is not one
+static_var const off_t cropcache_maxbytes = 4 * 1024;
+// run the cropdetector if the crop cache takes longer to read
+static_var const qint64 cropcache_timeout_ms = 2000;
+// kill mplayer -identify after that long
+static_var const int identify_timeout_ms = 20000;
+
+NextItemPreparer::NextItemPreparer(QObject *parent, const QString &mfn, const QString &mplayerpath, bool detect_crop)
+    : super()
+    , m_mfn(mfn)
+    , m_warmup(NULL)
+    , m_warmup_done(false)
+    , m_cropcache(NULL)
+    , m_cd(NULL)
+    , m_crop_done(false)
+    , m_identify(QLatin1String("NextItemPreparer_identify"), this)
+    , m_identify_done(false)
+{
+    setObjectName(QStringLiteral("NextItemPreparer"));
+    setParent(parent);
+
+    MYDBG("preparing \"%s\"", qPrintable(m_mfn));
+
+    m_warmup = new AsyncProbe(this, m_mfn, false, warmup_KBytes * 1024, warmup_timeout_ms);
+    m_warmupelapsed.start();
+    XCONNECT(m_warmup, SIGNAL(sig_done()), this, SLOT(slot_warmup_done()), QUEUEDCONN);
+
+    if(detect_crop) {
+        m_cropcache = new AsyncProbe(this, m_mfn + QStringLiteral(".crop"), true, cropcache_maxbytes, cropcache_timeout_ms);
+        XCONNECT(m_cropcache, SIGNAL(sig_done()), this, SLOT(slot_cropcache_done()), QUEUEDCONN);
+    }
+    else {
+        m_crop_done = true;
+    }
+
+    // with MP_REPLAY, mplayerpath is us, and would not identify anything
+    if(qgetenv("MP_REPLAY").isEmpty()) {
+        QStringList args;
+        args += QStringLiteral("-identify");
+        args += QStringLiteral("-frames");
+        args += QStringLiteral("0");
+        args += QStringLiteral("-vo");
+        args += QStringLiteral("null");
+        args += QStringLiteral("-ao");
+        args += QStringLiteral("null");
+        args += QStringLiteral("-nolirc");
+        args += QStringLiteral("-quiet");
+        args += m_mfn;
+
+        XCONNECT(&m_identify, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(slot_identify_finished(int, QProcess::ExitStatus)), QUEUEDCONN);
+        XCONNECT(&m_identify, SIGNAL(error(QProcess::ProcessError)), this, SLOT(slot_identify_error(QProcess::ProcessError)), QUEUEDCONN);
+        m_identify.setStandardErrorFile(QProcess::nullDevice());
+        m_identify.start(mplayerpath, args, QIODevice::ReadOnly);
+
+        m_identifytimer.setSingleShot(true);
+        XCONNECT(&m_identifytimer, SIGNAL(timeout()), this, SLOT(slot_identify_timeout()), QUEUEDCONN);
+        m_identifytimer.start(identify_timeout_ms);
+    }
+    else {
+        m_identify_done = true;
+    }
+}
+
+NextItemPreparer::~NextItemPreparer()
+{
+    m_identifytimer.stop();
+
+    if(m_warmup != NULL) {
+        delete m_warmup;
+        m_warmup = NULL;
+    }
+
+    if(m_cropcache != NULL) {
+        delete m_cropcache;
+        m_cropcache = NULL;
+    }
+
+    m_identify.disconnect(this);
+
+    if(m_identify.state() != QProcess::NotRunning) {
+        m_identify.kill();
+        m_identify.waitForFinished(1000);
+    }
+}
+
+bool NextItemPreparer::event(QEvent *event)
+{
+    log_qevent(category(), this, event);
+
+    return super::event(event);
+}
+
+void NextItemPreparer::slot_warmup_done()
+{
+    if(m_warmup == NULL) {
+        return;
+    }
+
+    m_warmup_errors = m_warmup->errors();
+
+    if(m_warmup_errors.isEmpty()) {
+        mount_throughput_record_speed(m_mfn, m_warmup->bytes_read(), m_warmup->was_cached(), m_warmup->elapsed_msec());
+    }
+
+    m_warmup->deleteLater();
+    m_warmup = NULL;
+    m_warmup_done = true;
+
+    if(m_warmup_errors.isEmpty()) {
+        MYDBG("\"%s\": read ahead in %ld msec", qPrintable(m_mfn), (long int)m_warmupelapsed.elapsed());
+    }
+    else {
+        MYDBG("\"%s\": reading ahead failed: %s", qPrintable(m_mfn), qPrintable(warmup_error()));
+    }
+}
+
+void NextItemPreparer::start_cropdetector()
+{
+    m_cd = new CropDetector(this, m_mfn);
+    XCONNECT(m_cd, SIGNAL(sig_detected(bool, QString, QString)), this, SLOT(slot_cdDetected(bool, QString, QString)), QUEUEDCONN);
+}
+
+void NextItemPreparer::slot_cropcache_done()
+{
+    if(m_cropcache == NULL) {
+        return;
+    }
+
+    const QStringList errors = m_cropcache->errors();
+    const QSharedPointer<MappedFileContents> contents = m_cropcache->contents();
+    m_cropcache->deleteLater();
+    m_cropcache = NULL;
+
+    if(!errors.isEmpty() || contents.isNull()) {
+        // mostly, there is none
+        MYDBG("\"%s\": no crop cache: %s", qPrintable(m_mfn), qPrintable(errors.join(QStringLiteral("; "))));
+        start_cropdetector();
+        return;
+    }
+
+    // the QByteArray is on the mapping, done with it before contents goes
+    const QByteArray bytes = contents->bytes();
+    const QString scrop = QString::fromLocal8Bit(bytes.constData(), bytes.size()).simplified();
+
+    static QRegExp rxcs(QLatin1String("^(\\d+):(\\d+):(\\d+):(\\d+)$"));
+
+    if(!rxcs.isValid()) {
+        PROGRAMMERERROR("WTF");
+    }
+
+    // empty: no crop
+    if(!scrop.isEmpty() && rxcs.indexIn(scrop) < 0) {
+        qWarning("bad crop cache for \"%s\": \"%s\"", qPrintable(m_mfn), qPrintable(scrop));
+        start_cropdetector();
+        return;
+    }
+
+    MYDBG("\"%s\": crop \"%s\" from its crop cache", qPrintable(m_mfn), qPrintable(scrop));
+    m_crop = scrop;
+    m_crop_done = true;
+}
+
+void NextItemPreparer::slot_cdDetected(bool success, QString msg, QString mfn)
+{
+    Q_UNUSED(mfn);
+
+    if(success) {
+        MYDBG("\"%s\": crop \"%s\"", qPrintable(m_mfn), qPrintable(msg));
+        m_crop = msg;
+    }
+    else {
+        qWarning("detecting crop for \"%s\" did not succeed: %s", qPrintable(m_mfn), qPrintable(msg));
+    }
+
+    m_crop_done = true;
+}
+
+void NextItemPreparer::slot_identify_finished(int ecode, QProcess::ExitStatus estatus)
+{
+    m_identifytimer.stop();
+
+    if(m_identify_done) {
+        return;
+    }
+
+    MYDBG("\"%s\": mplayer -identify finished with %d/%d", qPrintable(m_mfn), ecode, int(estatus));
+
+    const QByteArray bout = m_identify.readAllStandardOutput();
+    const QList<QByteArray> blines = bout.split('\n');
+    QString currenttag;
+
+    foreach(const QByteArray &bline, blines) {
+        if(bline.startsWith("ID_")) {
+            m_mediainfo.parse_identify(QString::fromLocal8Bit(bline.constData(), bline.size()), &currenttag);
+        }
+    }
+
+    m_identify_done = true;
+}
+
+void NextItemPreparer::slot_identify_error(QProcess::ProcessError e)
+{
+    if(e != QProcess::FailedToStart) {
+        // finished() follows
+        return;
+    }
+
+    qWarning("could not run mplayer -identify on \"%s\"", qPrintable(m_mfn));
+    m_identifytimer.stop();
+    m_identify_done = true;
+}
+
+void NextItemPreparer::slot_identify_timeout()
+{
+    qWarning("mplayer -identify on \"%s\" took too long, killing it", qPrintable(m_mfn));
+    m_identify.kill();
+}
@@ -0,0 +1,99 @@
+#ifndef NEXTITEMPREPARER_H
+#define NEXTITEMPREPARER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include "mpmediainfo.h"
+#include "deathsigprocess.h"
+
+class AsyncProbe;
+class CropDetector;
+
+// Gets the next file of the playlist ready while the current one plays:
+// reads its start into the block cache, detects the crop and runs
+// mplayer -identify on it, all in parallel and without blocking the event
+// loop. Once is_done(), the file can be loaded with everything known.
+// The crop is taken from a sidecar "<file>.crop" when there is one,
+// holding what "videofile.info -crop" prints; only without it the
+// cropdetector is run.
+class NextItemPreparer : public QObject
+{
+    Q_OBJECT
+public:
+    typedef QObject super;
+private:
+    QString m_mfn;
+
+    AsyncProbe *m_warmup;
+    QElapsedTimer m_warmupelapsed;
+    QStringList m_warmup_errors;
+    bool m_warmup_done;
+
+    AsyncProbe *m_cropcache;
+    CropDetector *m_cd;
+    QString m_crop;
+    bool m_crop_done;
+
+    DeathSigProcess m_identify;
+    QTimer m_identifytimer;
+    MpMediaInfo m_mediainfo;
+    bool m_identify_done;
+
+    // forbid
+    NextItemPreparer();
+    NextItemPreparer(const NextItemPreparer &);
+    NextItemPreparer &operator=(const NextItemPreparer &in);
+
+public:
+    NextItemPreparer(QObject *parent, const QString &mfn, const QString &mplayerpath, bool detect_crop);
+    virtual ~NextItemPreparer();
+
+    const QString &mfn() const
+    {
+        return m_mfn;
+    }
+    bool is_done() const
+    {
+        return m_warmup_done && m_crop_done && m_identify_done;
+    }
+    // empty if the start of the file could be read
+    QString warmup_error() const
+    {
+        return m_warmup_errors.join(QStringLiteral("; "));
+    }
+    // empty if there is nothing to crop, or it could not be found out
+    const QString &crop() const
+    {
+        return m_crop;
+    }
+    // what -identify said, not finalized
+    const MpMediaInfo &mediainfo() const
+    {
+        return m_mediainfo;
+    }
+
+public slots:
+    // from m_warmup
+    void slot_warmup_done();
+    // from m_cropcache
+    void slot_cropcache_done();
+    // from the cropdetector
+    void slot_cdDetected(bool, QString, QString);
+    // from m_identify
+    void slot_identify_finished(int, QProcess::ExitStatus);
+    void slot_identify_error(QProcess::ProcessError);
+    // internal, from m_identifytimer
+    void slot_identify_timeout();
+
+protected:
+    virtual bool event(QEvent *event);
+
+private:
+    void start_cropdetector();
+};
+
+#endif // NEXTITEMPREPARER_H
@@ -0,0 +1,159 @@
+#ifndef OBJECT_RING_H
+#define OBJECT_RING_H
+
+#include <QVector>
+
+#include "util.h"
+
+// Like MyCircularBuffer, but for payloads that are not trivially copyable.
+// All slots are constructed up front and reused: append_slot() hands out
+// the slot of the oldest element once the ring is full, so whatever memory
+// the payload kept (e.g. QByteArray capacity) is reused as well.
+template<typename T>
+class MyObjectRing
+{
+private:
+    QVector<T> m_buf;
+    // index of the oldest element
+    int m_first;
+    int m_count;
+    // forbid
+    MyObjectRing(const MyObjectRing &);
+    MyObjectRing &operator=(const MyObjectRing &in);
+private:
+    int index_of(int i) const
+    {
+        const int idx = m_first + i;
+        return (idx >= m_buf.size() ? idx - m_buf.size() : idx);
+    }
+public:
+    class const_iterator
+    {
+    private:
+        MyObjectRing const *m_ring;
+        int m_i;
+    public:
+        const_iterator(MyObjectRing const *ring, int i)
+            : m_ring(ring)
+            , m_i(i)
+        {
+        }
+        const T &operator*() const
+        {
+            return m_ring->at(m_i);
+        }
+        T const *operator->() const
+        {
+            return &(m_ring->at(m_i));
+        }
+        const_iterator &operator++()
+        {
+            m_i++;
+            return *this;
+        }
+        bool operator==(const const_iterator &o) const
+        {
+            return m_i == o.m_i;
+        }
+        bool operator!=(const const_iterator &o) const
+        {
+            return m_i != o.m_i;
+        }
+    };
+
+    explicit MyObjectRing(int capacity = 0)
+        : m_first(0)
+        , m_count(0)
+    {
+        set_capacity(capacity);
+    }
+    int capacity() const
+    {
+        return m_buf.size();
+    }
+    int size() const
+    {
+        return m_count;
+    }
+    bool isEmpty() const
+    {
+        return m_count == 0;
+    }
+    // forgets the elements, but keeps the slots
+    void clear()
+    {
+        m_first = 0;
+        m_count = 0;
+    }
+    // keeps the newest elements that still fit
+    void set_capacity(int capacity)
+    {
+        if(capacity < 0) {
+            PROGRAMMERERROR("WTF");
+        }
+
+        if(capacity == m_buf.size()) {
+            return;
+        }
+
+        const int keep = (m_count < capacity ? m_count : capacity);
+        QVector<T> nbuf(capacity);
+
+        for(int i = 0; i < keep; i++) {
+            nbuf[i] = at(m_count - keep + i);
+        }
+
+        m_buf.swap(nbuf);
+        m_first = 0;
+        m_count = keep;
+    }
+    // 0 is the oldest element
+    const T &at(int i) const
+    {
+        return m_buf.at(index_of(i));
+    }
+    const T &last() const
+    {
+        return at(m_count - 1);
+    }
+    // this needs to be fast
+    // returns the slot for a new newest element, evicting the oldest one if full.
+    // The slot still holds whatever was in it before.
+    T &append_slot()
+    {
+        if(m_buf.isEmpty()) {
+            PROGRAMMERERROR("append to a ring without capacity");
+        }
+
+        if(m_count == m_buf.size()) {
+            T &ret = m_buf[m_first];
+            m_first = index_of(1);
+            return ret;
+        }
+
+        m_count++;
+        return m_buf[index_of(m_count - 1)];
+    }
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+    const_iterator end() const
+    {
+        return const_iterator(this, m_count);
+    }
+    // copy of the elements, oldest first
+    QVector<T> snapshot() const
+    {
+        QVector<T> ret;
+        ret.reserve(m_count);
+
+        for(int i = 0; i < m_count; i++) {
+            ret.append(at(i));
+        }
+
+        return ret;
+    }
+};
+
+#endif // OBJECT_RING_H
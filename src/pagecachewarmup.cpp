@@ -0,0 +1,139 @@
+#include "pagecachewarmup.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// wait for the file in windows of that size, and ask for one ahead
+static_var const off_t warmup_window_bytes = 1024 * 1024;
+
+static long long now_usecs()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void ask_for_window(int fd, off_t off, off_t end)
+{
+    if(off >= end) {
+        return;
+    }
+
+    const off_t len = (end - off > warmup_window_bytes ? warmup_window_bytes : end - off);
+    // only a hint, waiting for the pages below still works without it
+    (void)::posix_fadvise(fd, off, len, POSIX_FADV_WILLNEED);
+}
+
+bool warm_page_cache(int fd, off_t from, off_t toread, bool *p_unsupported, PageCacheWarmupStats *stats, char *errbuf, size_t errbufsize)
+{
+    *p_unsupported = false;
+    ::memset(stats, 0, sizeof(*stats));
+
+    if(toread <= 0) {
+        return true;
+    }
+
+    const long pagesize = ::sysconf(_SC_PAGESIZE);
+
+    if(pagesize <= 0 || (warmup_window_bytes % pagesize) != 0) {
+        *p_unsupported = true;
+        return false;
+    }
+
+    // mappings start at a page, windows are counted from there
+    const off_t mapstart = from - (from % pagesize);
+    const off_t end = from + toread;
+    const size_t maplen = size_t(end - mapstart);
+
+    // never touched, only for mincore(): no SIGBUS if the file shrinks
+    void *map = ::mmap(NULL, maplen, PROT_READ, MAP_SHARED, fd, mapstart);
+
+    if(map == MAP_FAILED) {
+        *p_unsupported = true;
+        return false;
+    }
+
+    const size_t window_pages = size_t(warmup_window_bytes / pagesize);
+    unsigned char *vec = (unsigned char *)::malloc(window_pages);
+
+    if(vec == NULL) {
+        ::munmap(map, maplen);
+        ::snprintf(errbuf, errbufsize, "no memory");
+        return false;
+    }
+
+    const long long start = now_usecs();
+    bool ret = true;
+
+    ask_for_window(fd, mapstart, end);
+
+    for(off_t off = mapstart; ret && off < end; off += warmup_window_bytes) {
+        const long long window_start = now_usecs();
+        const off_t len = (end - off > warmup_window_bytes ? warmup_window_bytes : end - off);
+        const size_t pages = size_t((len + pagesize - 1) / pagesize);
+
+        ask_for_window(fd, off + warmup_window_bytes, end);
+
+        size_t first_missing = 0;
+
+        while(true) {
+            if(::mincore((char *)map + (off - mapstart), size_t(len), vec)) {
+                *p_unsupported = (off == mapstart);
+                ::snprintf(errbuf, errbufsize, "mincore error at byte %lu: %s", (unsigned long)off, strerror(errno));
+                ret = false;
+                break;
+            }
+
+            while(first_missing < pages && (vec[first_missing] & 1)) {
+                first_missing++;
+            }
+
+            if(first_missing >= pages) {
+                break;
+            }
+
+            // blocks until the page is there, and reads it if nobody did
+            const off_t pageoff = off + off_t(first_missing) * pagesize;
+            char c;
+            const ssize_t got = ::pread(fd, &c, 1, pageoff);
+            stats->waits++;
+
+            if(got < 0) {
+                if(errno == EINTR || errno == EAGAIN) {
+                    continue;
+                }
+
+                ::snprintf(errbuf, errbufsize, "read error at byte %lu: %s", (unsigned long)pageoff, strerror(errno));
+                ret = false;
+                break;
+            }
+
+            if(got == 0) {
+                ::snprintf(errbuf, errbufsize, "got EOF at byte %lu before reading all of file?", (unsigned long)pageoff);
+                ret = false;
+                break;
+            }
+
+            // counted as there even if it was dropped again meanwhile
+            first_missing++;
+        }
+
+        const long long window_usecs = now_usecs() - window_start;
+
+        if(window_usecs > stats->slowest_window_usecs) {
+            stats->slowest_window_usecs = window_usecs;
+        }
+    }
+
+    stats->usecs = now_usecs() - start;
+
+    ::free(vec);
+    ::munmap(map, maplen);
+    return ret;
+}
@@ -0,0 +1,26 @@
+#ifndef PAGECACHEWARMUP_H
+#define PAGECACHEWARMUP_H
+
+#include <sys/types.h>
+#include <stddef.h>
+
+struct PageCacheWarmupStats {
+    // for all of it
+    long long usecs;
+    // the longest one window took to arrive
+    long long slowest_window_usecs;
+    // pread()s needed to wait for pages
+    unsigned long waits;
+};
+
+// Gets toread bytes of fd, starting at from, into the page cache without
+// copying them to us: the kernel is asked to read one window ahead, mincore()
+// on a mapping tells what arrived, and a 1 byte pread() of the first
+// missing page waits for it. No Qt in here, it runs in reading children
+// and the probe helper.
+//
+// Returns false with *p_unsupported set if the file cannot be mapped;
+// read it instead then. Returns false with errbuf filled on an error.
+bool warm_page_cache(int fd, off_t from, off_t toread, bool *p_unsupported, PageCacheWarmupStats *stats, char *errbuf, size_t errbufsize);
+
+#endif // PAGECACHEWARMUP_H
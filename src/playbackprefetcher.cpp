@@ -0,0 +1,217 @@
+#include "playbackprefetcher.h"
+
+#include "asyncprobe.h"
+#include "config.h"
+#include "safe_signals.h"
+#include "event_desc.h"
+#include "util.h"
+
+#include <QLoggingCategory>
+#define THIS_SOURCE_FILE_LOG_CATEGORY "PFCH"
+static Q_LOGGING_CATEGORY(category, THIS_SOURCE_FILE_LOG_CATEGORY)
+#define MYDBG(msg, ...) qCDebug(category, msg, ##__VA_ARGS__)
+
+// seconds of content to keep read ahead when MP_PREFETCH_SECS is not set
+static_var const double window_secs_default = 60.;
+// read that much at a time
+static_var const qint64 chunk_bytes = 4 * 1024 * 1024;
+// without any idea of the bitrate, read that much at the start to learn the file size
+static_var const qint64 size_probe_bytes = 64 * 1024;
+// read ahead at most that many times faster than the content plays
+static_var const double rate_cap_factor = 4.;
+// and never start chunks closer together than that
+static_var const int min_gap_ms = 250;
+// give up on a chunk after that long
+static_var const qint64 job_timeout_ms = 30000;
+// after a failed chunk wait that long, times the failures in a row, up to the max
+static_var const int failure_backoff_ms = 5000;
+static_var const int failure_backoff_max_ms = 60000;
+
+PlaybackPrefetcher::PlaybackPrefetcher(QObject *parent, const QString &url, double length_secs, double bitrate_bps)
+    : super()
+    , m_url(url)
+    , m_window_secs(configured_window_secs())
+    , m_length_secs(length_secs)
+    , m_bitrate_bps(bitrate_bps)
+    , m_filesize(-1)
+    , m_size_probed(false)
+    , m_position(0)
+    , m_playing(false)
+    , m_prefetched_until(-1)
+    , m_job(NULL)
+    , m_job_offset(0)
+    , m_job_bytes(0)
+    , m_failures(0)
+{
+    setObjectName(QStringLiteral("PlaybackPrefetcher"));
+    setParent(parent);
+
+    MYDBG("prefetching %f secs of \"%s\", length %f secs, %f bps", m_window_secs, qPrintable(m_url), m_length_secs, m_bitrate_bps);
+
+    m_throttletimer.setSingleShot(true);
+    XCONNECT(&m_throttletimer, SIGNAL(timeout()), this, SLOT(slot_step()), QUEUEDCONN);
+}
+
+PlaybackPrefetcher::~PlaybackPrefetcher()
+{
+    m_throttletimer.stop();
+    delete m_job;
+    m_job = NULL;
+}
+
+bool PlaybackPrefetcher::event(QEvent *event)
+{
+    log_qevent(category(), this, event);
+
+    return super::event(event);
+}
+
+double PlaybackPrefetcher::configured_window_secs()
+{
+    const QString s = get_MP_PREFETCH_SECS();
+
+    if(s.isEmpty()) {
+        return window_secs_default;
+    }
+
+    bool ok = false;
+    const double ret = s.toDouble(&ok);
+
+    if(!ok || ret < 0) {
+        qWarning("MP_PREFETCH_SECS=%s is not a number of seconds, using %f", qPrintable(s), window_secs_default);
+        return window_secs_default;
+    }
+
+    return ret;
+}
+
+void PlaybackPrefetcher::set_position(double secs)
+{
+    m_position = (secs < 0 ? 0. : secs);
+    slot_step();
+}
+
+void PlaybackPrefetcher::set_playing(bool playing)
+{
+    if(playing == m_playing) {
+        return;
+    }
+
+    MYDBG("\"%s\": %s", qPrintable(m_url), (playing ? "playing" : "not playing"));
+    m_playing = playing;
+
+    if(!m_playing) {
+        // a chunk being read is finished, no new one is started
+        m_throttletimer.stop();
+        return;
+    }
+
+    slot_step();
+}
+
+double PlaybackPrefetcher::bytes_per_sec() const
+{
+    if(m_filesize > 0 && m_length_secs > 0) {
+        return double(m_filesize) / m_length_secs;
+    }
+
+    if(m_bitrate_bps > 0) {
+        return m_bitrate_bps / 8.;
+    }
+
+    return 0;
+}
+
+void PlaybackPrefetcher::slot_step()
+{
+    if(!m_playing || m_window_secs <= 0 || m_job != NULL || m_throttletimer.isActive()) {
+        return;
+    }
+
+    const double bps = bytes_per_sec();
+
+    if(bps <= 0) {
+        if(m_filesize < 0 && m_length_secs > 0 && !m_size_probed) {
+            m_size_probed = true;
+            start_job(0, size_probe_bytes);
+        }
+
+        return;
+    }
+
+    const qint64 at = qint64(m_position * bps);
+    qint64 want_until = at + qint64(m_window_secs * bps);
+
+    if(m_filesize >= 0 && want_until > m_filesize) {
+        want_until = m_filesize;
+    }
+
+    // behind playback after a seek forward, or far beyond the window after one back
+    if(m_prefetched_until < at || m_prefetched_until > want_until) {
+        if(m_prefetched_until >= 0) {
+            MYDBG("\"%s\": seeked, prefetching from byte %ld", qPrintable(m_url), (long int)at);
+        }
+
+        m_prefetched_until = at;
+    }
+
+    if(m_prefetched_until >= want_until) {
+        return;
+    }
+
+    start_job(m_prefetched_until, qMin(chunk_bytes, want_until - m_prefetched_until));
+}
+
+void PlaybackPrefetcher::start_job(qint64 offset, qint64 bytes)
+{
+    MYDBG("\"%s\": reading %ld bytes from %ld", qPrintable(m_url), (long int)bytes, (long int)offset);
+
+    m_job_offset = offset;
+    m_job_bytes = bytes;
+    m_job = new AsyncProbe(this, m_url, false, off_t(bytes), job_timeout_ms, off_t(offset));
+    XCONNECT(m_job, SIGNAL(sig_done()), this, SLOT(slot_job_done()), QUEUEDCONN);
+}
+
+void PlaybackPrefetcher::slot_job_done()
+{
+    if(m_job == NULL || sender() != m_job) {
+        return;
+    }
+
+    const QStringList errors = m_job->errors();
+    const qint64 elapsed = m_job->elapsed_msec();
+
+    if(m_job->file_size() >= 0) {
+        m_filesize = m_job->file_size();
+    }
+
+    m_job->deleteLater();
+    m_job = NULL;
+
+    int delay_ms = min_gap_ms;
+
+    if(!errors.isEmpty()) {
+        m_failures++;
+        delay_ms = int(qMin(qint64(failure_backoff_max_ms), qint64(failure_backoff_ms) * m_failures));
+        qWarning("prefetching %ld bytes of \"%s\" at %ld failed, retrying in %d msec: %s", (long int)m_job_bytes, qPrintable(m_url), (long int)m_job_offset, delay_ms, qPrintable(errors.join(QStringLiteral("; "))));
+    }
+    else {
+        m_failures = 0;
+
+        // unless a seek made it start over meanwhile
+        if(m_prefetched_until == m_job_offset) {
+            m_prefetched_until = m_job_offset + m_job_bytes;
+        }
+
+        const double bps = bytes_per_sec();
+
+        if(bps > 0) {
+            const qint64 capped_ms = qint64(double(m_job_bytes) * 1000. / (rate_cap_factor * bps));
+            delay_ms = int(qBound(qint64(min_gap_ms), capped_ms - elapsed, qint64(failure_backoff_max_ms)));
+        }
+
+        MYDBG("\"%s\": read %ld bytes in %ld msec, next in %d msec", qPrintable(m_url), (long int)m_job_bytes, (long int)elapsed, delay_ms);
+    }
+
+    m_throttletimer.start(delay_ms);
+}
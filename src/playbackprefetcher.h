@@ -0,0 +1,75 @@
+#ifndef PLAYBACKPREFETCHER_H
+#define PLAYBACKPREFETCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+class AsyncProbe;
+
+// Keeps the next MP_PREFETCH_SECS of a playing remote file in the page
+// cache, so a short server hiccup does not make mplayer run dry. Where
+// playback is in the file is estimated from the position and the file
+// size over the length, or the bitrate. The reading is done by
+// AsyncProbe, one chunk at a time, so a hung mount never blocks the GUI;
+// it is kept to a few times the content rate, so it does not compete
+// with mplayer's own reads, and nothing new is read while not playing.
+class PlaybackPrefetcher : public QObject
+{
+    Q_OBJECT
+public:
+    typedef QObject super;
+private:
+    QString m_url;
+    double m_window_secs;
+    double m_length_secs;
+    double m_bitrate_bps;
+    // -1 until a chunk told
+    qint64 m_filesize;
+    // without a bitrate, one chunk is read for the size; only once, a reading
+    // child does not tell it
+    bool m_size_probed;
+
+    double m_position;
+    bool m_playing;
+
+    // the window is read up to there, -1 to start at the position
+    qint64 m_prefetched_until;
+
+    AsyncProbe *m_job;
+    qint64 m_job_offset;
+    qint64 m_job_bytes;
+    unsigned m_failures;
+    // holds the next chunk back, for the rate cap and after failures
+    QTimer m_throttletimer;
+
+    // forbid
+    PlaybackPrefetcher();
+    PlaybackPrefetcher(const PlaybackPrefetcher &);
+    PlaybackPrefetcher &operator=(const PlaybackPrefetcher &in);
+
+public:
+    // length_secs, bitrate_bps: 0 if unknown
+    PlaybackPrefetcher(QObject *parent, const QString &url, double length_secs, double bitrate_bps);
+    virtual ~PlaybackPrefetcher();
+
+    // MP_PREFETCH_SECS, 0 if prefetching is off
+    static double configured_window_secs();
+
+    void set_position(double secs);
+    void set_playing(bool playing);
+
+public slots:
+    // internal, from m_job and m_throttletimer
+    void slot_job_done();
+    void slot_step();
+
+protected:
+    virtual bool event(QEvent *event);
+
+private:
+    double bytes_per_sec() const;
+    void start_job(qint64 offset, qint64 bytes);
+};
+
+#endif // PLAYBACKPREFETCHER_H
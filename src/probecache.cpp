@@ -0,0 +1,181 @@
+#include "probecache.h"
+
+#include "config.h"
+#include "util.h"
+
+#include <QDateTime>
+#include <QHash>
+#include <QMultiMap>
+#include <QSettings>
+#include <QStringList>
+
+#include <QLoggingCategory>
+#define THIS_SOURCE_FILE_LOG_CATEGORY "PRBC"
+static Q_LOGGING_CATEGORY(category, THIS_SOURCE_FILE_LOG_CATEGORY)
+#define MYDBG(msg, ...) qCDebug(category, msg, ##__VA_ARGS__)
+
+// a passed probe is trusted that long, the mount can get slower meanwhile
+static_var const qint64 max_age_msec = 60 * 60 * 1000;
+// keep at most that many files, the oldest go first
+static_var const int max_entries = 256;
+
+enum class ProbeCacheMode {
+    Off,
+    Memory,
+    Persistent
+};
+
+// when the files passed, in msecs since the epoch like the persistent ones
+static_var QHash<QString, qint64> verified;
+static_var bool mode_known = false;
+static_var ProbeCacheMode mode = ProbeCacheMode::Memory;
+
+static ProbeCacheMode cache_mode()
+{
+    if(mode_known) {
+        return mode;
+    }
+
+    const QString s = get_MP_PROBE_CACHE();
+
+    if(s.isEmpty() || s == QLatin1String("memory")) {
+        mode = ProbeCacheMode::Memory;
+    }
+    else if(s == QLatin1String("persistent")) {
+        mode = ProbeCacheMode::Persistent;
+    }
+    else if(s == QLatin1String("off")) {
+        mode = ProbeCacheMode::Off;
+    }
+    else {
+        qWarning("MP_PROBE_CACHE=%s is not one of off, memory, persistent; using memory", qPrintable(s));
+        mode = ProbeCacheMode::Memory;
+    }
+
+    mode_known = true;
+    return mode;
+}
+
+static QString key_for(const FileIdentity &id)
+{
+    return QStringLiteral("%1:%2:%3:%4.%5")
+           .arg(id.dev, 0, 16)
+           .arg(id.ino, 0, 16)
+           .arg(id.size)
+           .arg(id.mtime_sec)
+           .arg(id.mtime_nsec);
+}
+
+// drops what is too old, then the oldest till there are at most max_entries
+static void prune(QHash<QString, qint64> *entries, QStringList *p_dropped, qint64 now)
+{
+    QMultiMap<qint64, QString> by_age;
+
+    for(QHash<QString, qint64>::const_iterator it = entries->constBegin(); it != entries->constEnd(); ++it) {
+        by_age.insert(it.value(), it.key());
+    }
+
+    int left = entries->size();
+
+    for(QMultiMap<qint64, QString>::const_iterator it = by_age.constBegin(); it != by_age.constEnd(); ++it) {
+        if(it.key() >= now - max_age_msec && left <= max_entries) {
+            break;
+        }
+
+        entries->remove(it.value());
+        p_dropped->append(it.value());
+        left--;
+    }
+}
+
+bool probe_cache_has_sustained(const FileIdentity &id)
+{
+    if(!id.is_known() || cache_mode() == ProbeCacheMode::Off) {
+        return false;
+    }
+
+    const QString key = key_for(id);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 when = verified.value(key, -1);
+
+    if(when < 0 && cache_mode() == ProbeCacheMode::Persistent) {
+        QSettings settings;
+        settings.beginGroup(QStringLiteral("probe_cache"));
+        when = settings.value(key, qint64(-1)).toLongLong();
+        settings.endGroup();
+
+        if(when >= 0) {
+            verified.insert(key, when);
+        }
+    }
+
+    if(when < 0) {
+        return false;
+    }
+
+    // a clock set back would keep it forever
+    if(when < now - max_age_msec || when > now) {
+        MYDBG("%s: passed %ld msec ago, too long", qPrintable(key), (long int)(now - when));
+        probe_cache_forget(id);
+        return false;
+    }
+
+    MYDBG("%s: passed %ld msec ago", qPrintable(key), (long int)(now - when));
+    return true;
+}
+
+void probe_cache_record_sustained(const QString &path, const FileIdentity &id)
+{
+    if(!id.is_known() || cache_mode() == ProbeCacheMode::Off) {
+        return;
+    }
+
+    const QString key = key_for(id);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    MYDBG("%s: \"%s\" passed", qPrintable(key), qPrintable(path));
+
+    verified.insert(key, now);
+    QStringList dropped;
+    prune(&verified, &dropped, now);
+
+    if(cache_mode() != ProbeCacheMode::Persistent) {
+        return;
+    }
+
+    QSettings settings;
+    settings.beginGroup(QStringLiteral("probe_cache"));
+    settings.setValue(key, now);
+
+    QHash<QString, qint64> stored;
+
+    foreach(const QString &k, settings.childKeys()) {
+        stored.insert(k, settings.value(k).toLongLong());
+    }
+
+    dropped.clear();
+    prune(&stored, &dropped, now);
+
+    foreach(const QString &k, dropped) {
+        settings.remove(k);
+    }
+
+    settings.endGroup();
+}
+
+void probe_cache_forget(const FileIdentity &id)
+{
+    if(!id.is_known() || cache_mode() == ProbeCacheMode::Off) {
+        return;
+    }
+
+    const QString key = key_for(id);
+    verified.remove(key);
+
+    if(cache_mode() == ProbeCacheMode::Persistent) {
+        QSettings settings;
+        settings.beginGroup(QStringLiteral("probe_cache"));
+        settings.remove(key);
+        settings.endGroup();
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef PROBECACHE_H
+#define PROBECACHE_H
+
+#include <QString>
+
+// What fstat() said about a file, enough to tell it from a replaced or
+// changed one.
+struct FileIdentity {
+    quint64 dev;
+    quint64 ino;
+    // < 0 if not known
+    qint64 size;
+    qint64 mtime_sec;
+    qint64 mtime_nsec;
+
+    FileIdentity()
+        : dev(0)
+        , ino(0)
+        , size(-1)
+        , mtime_sec(0)
+        , mtime_nsec(0)
+    {
+    }
+    bool is_known() const
+    {
+        return size >= 0;
+    }
+};
+
+// Files that recently passed the sustained reading probe before a load,
+// so reloading or resuming them only needs the access probe, which also
+// tells their identity. Kept in memory, and in the settings as well with
+// MP_PROBE_CACHE=persistent; MP_PROBE_CACHE=off switches it off.
+//
+// GUI thread only.
+bool probe_cache_has_sustained(const FileIdentity &id);
+void probe_cache_record_sustained(const QString &path, const FileIdentity &id);
+// after the file turned out not to be readable after all
+void probe_cache_forget(const FileIdentity &id);
+
+#endif // PROBECACHE_H
@@ -0,0 +1,332 @@
+#include "probehelper.h"
+
+#include "probehelper_child.h"
+#include "asynckillproc.h"
+#include "encoding.h"
+#include "util.h"
+#include "safe_signals.h"
+#include "event_desc.h"
+
+#include <QSocketNotifier>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <QLoggingCategory>
+#define THIS_SOURCE_FILE_LOG_CATEGORY "PRBH"
+static Q_LOGGING_CATEGORY(category, THIS_SOURCE_FILE_LOG_CATEGORY)
+#define MYDBG(msg, ...) qCDebug(category, msg, ##__VA_ARGS__)
+
+extern char **environ;
+
+// largest reply: header plus an error message
+static_var const size_t max_reply_size = sizeof(ProbeHelperReply) + 4096;
+// a job running that long is stuck in a read, longer than any caller waits
+static_var const qint64 helper_stuck_after_ms = 60000;
+
+ProbeHelper::ProbeHelper()
+    : super()
+    , m_fd(-1)
+    , m_pid(0)
+    , m_notifier(NULL)
+    , m_nextid(1)
+{
+    setObjectName(QStringLiteral("ProbeHelper"));
+    m_clock.start();
+}
+
+ProbeHelper::~ProbeHelper()
+{
+    delete m_notifier;
+    m_notifier = NULL;
+
+    // the helper exits on EOF
+    if(m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = (-1);
+    }
+}
+
+// never deleted, QObjects must not outlive the QApplication
+ProbeHelper &ProbeHelper::instance()
+{
+    static_var ProbeHelper *helper = NULL;
+
+    if(helper == NULL) {
+        helper = new ProbeHelper();
+    }
+
+    return *helper;
+}
+
+bool ProbeHelper::event(QEvent *event)
+{
+    log_qevent(category(), this, event);
+
+    return super::event(event);
+}
+
+void ProbeHelper::slot_readable(int fd)
+{
+    Q_UNUSED(fd);
+
+    bool got_any = false;
+    (void)read_replies(&got_any);
+
+    if(got_any) {
+        MYDBG("EMIT sig_replies");
+        emit sig_replies();
+    }
+}
+
+bool ProbeHelper::spawn(QString *error)
+{
+    int sv[2] = { -1, -1 };
+
+    if(::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1) {
+        *error = QStringLiteral("probe helper: socketpair: ") + err_xbin_2_local_qstring(strerror(errno));
+        return false;
+    }
+
+    // dup2() onto the same fd would leave FD_CLOEXEC set
+    if(sv[1] == PROBEHELPER_FD) {
+        const int moved = ::fcntl(sv[1], F_DUPFD_CLOEXEC, PROBEHELPER_FD + 1);
+
+        if(moved < 0) {
+            *error = QStringLiteral("probe helper: fcntl: ") + err_xbin_2_local_qstring(strerror(errno));
+            ::close(sv[0]);
+            ::close(sv[1]);
+            return false;
+        }
+
+        ::close(sv[1]);
+        sv[1] = moved;
+    }
+
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_adddup2(&fa, sv[1], PROBEHELPER_FD);
+
+    char arg0[] = "singleplayer-probe-helper";
+    char arg1[] = PROBEHELPER_ARG;
+    char *argv[] = { arg0, arg1, NULL };
+
+    pid_t pid = 0;
+    // no fork: posix_spawn() does not copy our page tables
+    const int serr = ::posix_spawn(&pid, "/proc/self/exe", &fa, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    ::close(sv[1]);
+
+    if(serr != 0) {
+        *error = QStringLiteral("probe helper: posix_spawn: ") + err_xbin_2_local_qstring(strerror(serr));
+        ::close(sv[0]);
+        return false;
+    }
+
+    MYDBG("spawned probe helper PID=%d", int(pid));
+    m_fd = sv[0];
+    m_pid = pid;
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    XCONNECT(m_notifier, SIGNAL(activated(int)), this, SLOT(slot_readable(int)));
+    return true;
+}
+
+void ProbeHelper::kill_helper(char const *const reason)
+{
+    MYDBG("killing probe helper PID=%d: %s, failing %d jobs", int(m_pid), reason, m_outstanding.size() - m_abandoned.size());
+
+    // before the fd goes away
+    delete m_notifier;
+    m_notifier = NULL;
+
+    if(m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = (-1);
+    }
+
+    if(m_pid > 0) {
+        const pid_t oripid = m_pid;
+        m_pid = 0;
+        async_kill_process(oripid, reason, "probe helper");
+    }
+
+    const QString msg = QStringLiteral("probe helper died: ") + QLatin1String(reason);
+
+    foreach(unsigned id, m_outstanding.keys()) {
+        if(!m_abandoned.contains(id)) {
+            Result r;
+            r.error = msg;
+            m_results.insert(id, r);
+        }
+    }
+
+    const bool failed_any = (m_outstanding.size() > m_abandoned.size());
+    m_outstanding.clear();
+    m_abandoned.clear();
+
+    if(failed_any) {
+        MYDBG("EMIT sig_replies");
+        emit sig_replies();
+    }
+}
+
+void ProbeHelper::kill_helper_if_stuck()
+{
+    const qint64 now = m_clock.elapsed();
+
+    for(QHash<unsigned, qint64>::const_iterator it = m_outstanding.constBegin(); it != m_outstanding.constEnd(); ++it) {
+        if(now - it.value() > helper_stuck_after_ms) {
+            kill_helper("a job is stuck");
+            return;
+        }
+    }
+}
+
+unsigned ProbeHelper::submit(const QByteArray &filename, off_t offset, off_t maxreadsize, QString *error)
+{
+    kill_helper_if_stuck();
+
+    if(m_fd < 0 && !spawn(error)) {
+        return 0;
+    }
+
+    const unsigned id = m_nextid++;
+
+    if(m_nextid == 0) {
+        m_nextid = 1;
+    }
+
+    ProbeHelperRequest req;
+    req.id = id;
+    req.maxreadsize = maxreadsize;
+    req.offset = offset;
+
+    QByteArray msg(reinterpret_cast<const char *>(&req), int(sizeof(req)));
+    msg.append(filename);
+
+    if(::send(m_fd, msg.constData(), size_t(msg.size()), MSG_NOSIGNAL | MSG_DONTWAIT) < 0) {
+        *error = QStringLiteral("probe helper: send: ") + err_xbin_2_local_qstring(strerror(errno));
+        kill_helper("could not send");
+        return 0;
+    }
+
+    m_outstanding.insert(id, m_clock.elapsed());
+    return id;
+}
+
+bool ProbeHelper::read_replies(bool *p_got_any)
+{
+    *p_got_any = false;
+
+    if(m_fd < 0) {
+        return false;
+    }
+
+    char buf[max_reply_size];
+
+    for(;;) {
+        const ssize_t got = ::recv(m_fd, buf, sizeof(buf), MSG_DONTWAIT);
+
+        if(got < 0) {
+            if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+
+            if(errno == EINTR) {
+                continue;
+            }
+
+            kill_helper("recv error");
+            return false;
+        }
+
+        if(got == 0) {
+            kill_helper("EOF");
+            return false;
+        }
+
+        if(size_t(got) < sizeof(ProbeHelperReply)) {
+            kill_helper("short reply");
+            return false;
+        }
+
+        ProbeHelperReply reply;
+        memcpy(&reply, buf, sizeof(reply));
+
+        if(!m_outstanding.remove(reply.id)) {
+            continue;
+        }
+
+        if(m_abandoned.remove(reply.id)) {
+            continue;
+        }
+
+        Result r;
+
+        if(reply.filesize >= 0) {
+            r.identity.dev = reply.dev;
+            r.identity.ino = reply.ino;
+            r.identity.size = reply.filesize;
+            r.identity.mtime_sec = reply.mtime_sec;
+            r.identity.mtime_nsec = reply.mtime_nsec;
+            r.bytes_read = reply.bytesread;
+            r.was_cached = (reply.cached != 0);
+        }
+
+        if(!reply.ok) {
+            r.error = err_xbin_2_local_qstring(QByteArray(buf + sizeof(reply), int(got - sizeof(reply))));
+
+            if(r.error.isEmpty()) {
+                r.error = QStringLiteral("failed");
+            }
+        }
+
+        m_results.insert(reply.id, r);
+        *p_got_any = true;
+    }
+}
+
+bool ProbeHelper::poll(unsigned id, QString *error, FileIdentity *pidentity, qint64 *p_bytes_read, bool *p_was_cached, bool *p_made_progress)
+{
+    bool got_any = false;
+    (void)read_replies(&got_any);
+    kill_helper_if_stuck();
+    *p_made_progress = got_any;
+
+    QHash<unsigned, Result>::iterator it = m_results.find(id);
+
+    if(it == m_results.end()) {
+        if(!m_outstanding.contains(id)) {
+            *error = QStringLiteral("unknown probe job");
+            *pidentity = FileIdentity();
+            *p_bytes_read = (-1);
+            *p_was_cached = false;
+            *p_made_progress = true;
+            return true;
+        }
+
+        return false;
+    }
+
+    *error = it.value().error;
+    *pidentity = it.value().identity;
+    *p_bytes_read = it.value().bytes_read;
+    *p_was_cached = it.value().was_cached;
+    m_results.erase(it);
+    *p_made_progress = true;
+    return true;
+}
+
+void ProbeHelper::abandon(unsigned id)
+{
+    m_results.remove(id);
+
+    // the reply is dropped when it comes, kill_helper_if_stuck() deals with hangs
+    if(m_outstanding.contains(id)) {
+        m_abandoned.insert(id);
+    }
+}
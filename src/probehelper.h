@@ -0,0 +1,93 @@
+#ifndef PROBEHELPER_H
+#define PROBEHELPER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QElapsedTimer>
+
+#include <sys/types.h>
+
+#include "probecache.h"
+
+class QSocketNotifier;
+
+// Talks to the probe helper, a copy of this program started once as
+// PROBEHELPER_ARG (see probehelper_child.h), which reads the start of
+// files for AsyncReadFile. Spawning it once instead of forking the whole
+// GUI for every probe saves the page table copy and the copy-on-write
+// faults after it. A hung read still only hangs the helper: a job that
+// runs for much longer than any caller waits gets it killed, and the
+// next job starts a new one.
+//
+// GUI thread only.
+class ProbeHelper : public QObject
+{
+    Q_OBJECT
+public:
+    typedef QObject super;
+private:
+    int m_fd;
+    pid_t m_pid;
+    QSocketNotifier *m_notifier;
+    unsigned m_nextid;
+    QElapsedTimer m_clock;
+    // sent, no reply yet: when it was sent
+    QHash<unsigned, qint64> m_outstanding;
+    // outstanding, but nobody waits for the reply anymore
+    QSet<unsigned> m_abandoned;
+    struct Result {
+        // empty on success
+        QString error;
+        // of the whole file, unknown if it could not be opened
+        FileIdentity identity;
+        // of it, -1 if unknown
+        qint64 bytes_read;
+        // all of those were in the page cache already
+        bool was_cached;
+
+        Result() : bytes_read(-1), was_cached(false) {}
+    };
+    // replied, not polled yet
+    QHash<unsigned, Result> m_results;
+
+    bool spawn(QString *error);
+    void kill_helper(char const *const reason);
+    void kill_helper_if_stuck();
+    // false if the helper is gone
+    bool read_replies(bool *p_got_any);
+
+    ProbeHelper();
+    ~ProbeHelper();
+    // forbid
+    ProbeHelper(const ProbeHelper &);
+    ProbeHelper &operator=(const ProbeHelper &in);
+
+public:
+    static ProbeHelper &instance();
+
+    // 0 if the job could not be handed to the helper, *error says why
+    unsigned submit(const QByteArray &filename, off_t offset, off_t maxreadsize, QString *error);
+    // false while the job runs; then *error is its outcome, empty on success,
+    // *pidentity what the file was, unknown if it could not be opened, and
+    // *p_bytes_read (-1 if unknown) how much was read, *p_was_cached whether
+    // all of that came from the page cache
+    bool poll(unsigned id, QString *error, FileIdentity *pidentity, qint64 *p_bytes_read, bool *p_was_cached, bool *p_made_progress);
+    // nobody waits for the job anymore
+    void abandon(unsigned id);
+
+signals:
+    // some jobs finished, poll() them
+    void sig_replies();
+
+public slots:
+    // from m_notifier
+    void slot_readable(int fd);
+
+protected:
+    virtual bool event(QEvent *event);
+};
+
+#endif // PROBEHELPER_H
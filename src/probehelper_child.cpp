@@ -0,0 +1,212 @@
+#include "probehelper_child.h"
+#include "pagecachewarmup.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/prctl.h>
+
+#include <string>
+
+// largest request: header plus a file name
+static_var const size_t max_request_size = sizeof(ProbeHelperRequest) + 8192;
+// read the file in blocks of that size
+static_var const size_t read_blocksize = 65536;
+
+struct ProbeJob {
+    int fd;
+    uint32_t id;
+    int64_t maxreadsize;
+    int64_t offset;
+    std::string filename;
+};
+
+// fills in what fstat() says about the file and what was read of it in *reply
+static bool probe_read(const ProbeJob *job, ProbeHelperReply *reply, std::string *err)
+{
+    reply->filesize = (-1);
+
+    const int filefd = ::open(job->filename.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if(filefd < 0) {
+        *err = std::string("could not open: ") + strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+
+    if(::fstat(filefd, &st)) {
+        *err = std::string("could not stat: ") + strerror(errno);
+        ::close(filefd);
+        return false;
+    }
+
+    const off_t size = st.st_size;
+    reply->filesize = size;
+    reply->dev = uint64_t(st.st_dev);
+    reply->ino = uint64_t(st.st_ino);
+    reply->mtime_sec = int64_t(st.st_mtim.tv_sec);
+    reply->mtime_nsec = int64_t(st.st_mtim.tv_nsec);
+    const off_t from = (job->offset > size ? size : off_t(job->offset));
+    const off_t left = size - from;
+    const off_t toread = (job->maxreadsize < 0 ? left : (left > job->maxreadsize ? off_t(job->maxreadsize) : left));
+
+    {
+        bool unsupported = false;
+        PageCacheWarmupStats stats;
+        char errbuf[256] = "";
+
+        if(warm_page_cache(filefd, from, toread, &unsupported, &stats, errbuf, sizeof(errbuf))) {
+            reply->bytesread = toread;
+            // nothing had to be waited for
+            reply->cached = (stats.waits == 0 ? 1 : 0);
+            ::close(filefd);
+            return true;
+        }
+
+        if(!unsupported) {
+            *err = errbuf;
+            ::close(filefd);
+            return false;
+        }
+
+        // not mappable, read it then
+    }
+
+    char *buf = (char *)::malloc(read_blocksize);
+
+    if(buf == NULL) {
+        *err = "no memory";
+        ::close(filefd);
+        return false;
+    }
+
+    off_t done = 0;
+    bool ret = true;
+
+    while(done < toread) {
+        const size_t want = (toread - done > off_t(read_blocksize) ? read_blocksize : size_t(toread - done));
+        const ssize_t got = ::pread(filefd, buf, want, from + done);
+
+        if(got < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+
+            char msg[100];
+            snprintf(msg, sizeof(msg), "read error at byte %lu: ", (unsigned long)(from + done));
+            *err = std::string(msg) + strerror(errno);
+            ret = false;
+            break;
+        }
+
+        if(got == 0) {
+            break;
+        }
+
+        done += got;
+    }
+
+    // no telling what came from the page cache
+    reply->bytesread = done;
+    reply->cached = 0;
+
+    ::free(buf);
+    ::close(filefd);
+    return ret;
+}
+
+static void *probe_thread(void *arg)
+{
+    ProbeJob *job = (ProbeJob *)arg;
+    std::string err;
+    ProbeHelperReply reply;
+    memset(&reply, 0, sizeof(reply));
+    const bool ok = probe_read(job, &reply, &err);
+
+    std::string msg(sizeof(ProbeHelperReply), '\0');
+    reply.id = job->id;
+    reply.ok = (ok ? 1 : 0);
+    memcpy(&msg[0], &reply, sizeof(reply));
+    msg += err;
+
+    // one packet, no need to serialize the threads
+    if(::send(job->fd, msg.data(), msg.size(), MSG_NOSIGNAL) < 0) {
+        fprintf(stderr, "probe helper: could not reply to job %u: %s\n", (unsigned)job->id, strerror(errno));
+    }
+
+    delete job;
+    return NULL;
+}
+
+int probehelper_main(int fd)
+{
+    // nobody to report to once the application is gone
+    (void)::prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+    if(::getppid() == 1) {
+        return 1;
+    }
+
+    char *req = (char *)::malloc(max_request_size);
+
+    if(req == NULL) {
+        return 1;
+    }
+
+    for(;;) {
+        const ssize_t got = ::recv(fd, req, max_request_size, 0);
+
+        if(got < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+
+            fprintf(stderr, "probe helper: recv: %s\n", strerror(errno));
+            break;
+        }
+
+        if(got == 0) {
+            break;
+        }
+
+        if(size_t(got) <= sizeof(ProbeHelperRequest)) {
+            fprintf(stderr, "probe helper: short request of %ld bytes\n", (long)got);
+            continue;
+        }
+
+        ProbeHelperRequest hdr;
+        memcpy(&hdr, req, sizeof(hdr));
+
+        ProbeJob *job = new ProbeJob;
+        job->fd = fd;
+        job->id = hdr.id;
+        job->maxreadsize = hdr.maxreadsize;
+        job->offset = hdr.offset;
+        job->filename.assign(req + sizeof(hdr), size_t(got) - sizeof(hdr));
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        pthread_t tid;
+        const int perr = ::pthread_create(&tid, &attr, &probe_thread, job);
+        pthread_attr_destroy(&attr);
+
+        if(perr != 0) {
+            fprintf(stderr, "probe helper: could not start a thread: %s\n", strerror(perr));
+            // answer from here then, better late than never
+            (void)probe_thread(job);
+        }
+    }
+
+    ::free(req);
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef PROBEHELPER_CHILD_H
+#define PROBEHELPER_CHILD_H
+
+#include <stdint.h>
+
+// Messages on the SOCK_SEQPACKET socket between ProbeHelper and
+// probehelper_main(), one per packet.
+//
+// request: ProbeHelperRequest, then the file name, not 0-terminated
+// reply:   ProbeHelperReply, then the error message if !ok
+
+struct ProbeHelperRequest {
+    uint32_t id;
+    // read at most that many bytes, < 0 for all of the file
+    int64_t maxreadsize;
+    // starting there
+    int64_t offset;
+};
+
+struct ProbeHelperReply {
+    uint32_t id;
+    int32_t ok;
+    // of the whole file, < 0 if it could not be opened
+    int64_t filesize;
+    // with filesize, tell the file apart from a replaced one
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    // of it, read or found in the page cache
+    int64_t bytesread;
+    // 1 if all of those were in the page cache already
+    int32_t cached;
+};
+
+// the socket is passed as this fd
+#define PROBEHELPER_FD 3
+// argv[1] of the helper
+#define PROBEHELPER_ARG "--probe-helper"
+
+// Runs instead of the application when started as PROBEHELPER_ARG.
+// No Qt in here: a small process that reads files into the block cache
+// so the application does not have to fork itself for that. Every job
+// gets its own thread, so a hung read only holds up its own job.
+// Returns when the socket is closed.
+int probehelper_main(int fd);
+
+#endif // PROBEHELPER_CHILD_H
@@ -35,7 +35,10 @@ ScreenSaverManager::ScreenSaverManager(QObject *parent, predicate_t func, void *
 
 ScreenSaverManager::~ScreenSaverManager()
 {
-    enable();
+    // never touched it, e.g. for a standby mplayer: leave it to the others
+    if(m_screensaver_currently_enabled != NoYesUnknown::Unknown) {
+        enable();
+    }
 }
 
 bool ScreenSaverManager::event(QEvent *event)
@@ -9,12 +9,17 @@
 #include <QLoggingCategory>
 #include <QMutex>
 #include <signal.h>
+#include <string.h>
+#include <stdlib.h>
 
 #include "mainwindow.h"
 #include "capslock.h"
 #include "system.h"
 #include "logging.h"
 #include "event_desc.h"
+#include "mpmetrics.h"
+#include "mpreplay.h"
+#include "probehelper_child.h"
 
 #include <QLoggingCategory>
 #define THIS_SOURCE_FILE_LOG_CATEGORY "MAIN"
@@ -125,6 +130,12 @@ static void usage(const QString &in_msg = QString())
               "MP_OPTS_APPEND   - extra mplayer command line options\n"
               "MP_OPTS_OVERRIDE - mplayer command line options\n"
               "MP_VO            - mplayer -vo option\n"
+              "MP_PATH          - mplayer executable\n"
+              "MP_TRACE         - record all I/O with mplayer to this file\n"
+              "MP_REPLAY        - act as mplayer, playing back this trace\n"
+              "MP_SCRIPT        - act as mplayer, answering commands as this script says, see mpreplay.h\n"
+              "MP_PREFETCH_SECS - seconds to read ahead of playback on remote files, 0: off (default 60)\n"
+              "MP_PROBE_CACHE   - remember files that read fine: off, memory, persistent (default memory)\n"
               "CROP             - mplayer-like crop string\n"
               "QT_LOGGING_RULES - change default logging"
               "\n"
@@ -237,6 +248,20 @@ static AutoCUM autocum_static("autocum_static");
 
 int main(int argc, char *argv[])
 {
+    // started by ourselves to read files, see probehelper.h
+    if(argc >= 2 && 0 == strcmp(argv[1], PROBEHELPER_ARG)) {
+        return probehelper_main(PROBEHELPER_FD);
+    }
+
+    // started by ourselves as mplayer stand-in, MP_PATH=<this binary>
+    if(argc >= 2 && 0 == strcmp(argv[1], "-slave") && getenv("MP_REPLAY") != NULL) {
+        return mpreplay_main(getenv("MP_REPLAY"));
+    }
+
+    if(argc >= 2 && 0 == strcmp(argv[1], "-slave") && getenv("MP_SCRIPT") != NULL) {
+        return mpreplay_script_main(getenv("MP_SCRIPT"));
+    }
+
     QApplication app(argc, argv);
 
     init_logging();
@@ -305,6 +330,9 @@ int main(int argc, char *argv[])
         set_signal(SIGIO);
     }
 
+    // kill -USR1 logs the mplayer latency histograms
+    mpmetrics_install_dump_signal(SIGUSR1);
+
     int ret = -1;
 
     try {
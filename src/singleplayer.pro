@@ -38,7 +38,27 @@ HEADERS       = \
     focusstack.h \
     event_desc.h \
     logging.h \
-    circularbuffer.h
+    circularbuffer.h \
+    linesplitter.h \
+    mplinedispatch.h \
+    mpstatusline.h \
+    mpnoiseclassifier.h \
+    objectring.h \
+    monotime.h \
+    spscring.h \
+    mppipereader.h \
+    latencyhistogram.h \
+    mpmetrics.h \
+    mppositionestimator.h \
+    mpreplay.h \
+    nextitempreparer.h \
+    probehelper.h \
+    probehelper_child.h \
+    asyncprobe.h \
+    pagecachewarmup.h \
+    mountthroughput.h \
+    playbackprefetcher.h \
+    probecache.h
 SOURCES       = \
     mainwindow.cpp \
     util.cpp \
@@ -69,7 +89,24 @@ SOURCES       = \
     focusstack.cpp \
     event_desc.cpp \
     logging.cpp \
-    qprocess_meta.cpp
+    qprocess_meta.cpp \
+    mplinedispatch.cpp \
+    mpstatusline.cpp \
+    mpnoiseclassifier.cpp \
+    monotime.cpp \
+    mppipereader.cpp \
+    latencyhistogram.cpp \
+    mpmetrics.cpp \
+    mppositionestimator.cpp \
+    mpreplay.cpp \
+    nextitempreparer.cpp \
+    probehelper.cpp \
+    probehelper_child.cpp \
+    asyncprobe.cpp \
+    pagecachewarmup.cpp \
+    mountthroughput.cpp \
+    playbackprefetcher.cpp \
+    probecache.cpp
 
 QT+=svg dbus
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets 
@@ -0,0 +1,96 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <QVector>
+#include <QAtomicInteger>
+
+#include "util.h"
+
+// A bounded queue between exactly one producer thread and exactly one
+// consumer thread, without locks. Like MyObjectRing, all slots are
+// constructed up front and reused, so the payload keeps its memory.
+//
+// The producer fills slots with push_slot()/push_done() and makes them
+// visible to the consumer in one go with publish(). The consumer looks at
+// front() and hands the slot back with pop().
+template<typename T>
+class MySpscRing
+{
+private:
+    QVector<T> m_buf;
+    // both count up forever, the slot is the count modulo capacity
+    // next slot to pop, only written by the consumer
+    QAtomicInteger<unsigned> m_head;
+    // next slot to publish, only written by the producer
+    QAtomicInteger<unsigned> m_tail;
+    // next slot to push, producer only
+    unsigned m_pushed;
+    // forbid
+    MySpscRing(const MySpscRing &);
+    MySpscRing &operator=(const MySpscRing &in);
+private:
+    T &slot(unsigned count)
+    {
+        return m_buf[int(count % unsigned(m_buf.size()))];
+    }
+public:
+    explicit MySpscRing(int capacity)
+        : m_buf(capacity)
+        , m_head(0)
+        , m_tail(0)
+        , m_pushed(0)
+    {
+        if(capacity < 1) {
+            PROGRAMMERERROR("WTF");
+        }
+    }
+    int capacity() const
+    {
+        return m_buf.size();
+    }
+
+    // producer: a slot to fill, NULL if the ring is full
+    // The slot still holds whatever was in it before.
+    T *push_slot()
+    {
+        if(m_pushed - m_head.loadAcquire() >= unsigned(m_buf.size())) {
+            return NULL;
+        }
+
+        return &slot(m_pushed);
+    }
+    // producer: the slot from push_slot() is filled
+    void push_done()
+    {
+        m_pushed++;
+    }
+    // producer: everything pushed so far becomes visible to the consumer
+    void publish()
+    {
+        m_tail.storeRelease(m_pushed);
+    }
+    // producer: pushed, but not published yet
+    int unpublished() const
+    {
+        return int(m_pushed - m_tail.load());
+    }
+
+    // consumer: the oldest published slot, NULL if there is none
+    T *front()
+    {
+        const unsigned head = m_head.load();
+
+        if(head == m_tail.loadAcquire()) {
+            return NULL;
+        }
+
+        return &slot(head);
+    }
+    // consumer: done with the slot from front()
+    void pop()
+    {
+        m_head.storeRelease(m_head.load() + 1);
+    }
+};
+
+#endif // SPSC_RING_H
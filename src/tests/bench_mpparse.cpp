@@ -0,0 +1,215 @@
+// What reading mplayer output costs, by the kind of line: an MP_TRACE
+// file goes through the line splitter, the reader thread's parsing and
+// MpProcess::parseLine(), which calls parseMediaInfo(), and the status
+// lines and time answers through parsePosition(), once per read. Reports
+// ns, allocations and bytes allocated per line, in the categories of
+// MpMetrics.
+//
+// usage: bench_mpparse [trace [rounds]]
+
+#include "../mpprocess.h"
+#include "../mpmediainfo.h"
+#include "../mppipereader.h"
+#include "../mpnoiseclassifier.h"
+#include "../mpmetrics.h"
+#include "../linesplitter.h"
+#include "benchutil.h"
+
+#include <QCoreApplication>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct BenchCounter {
+    unsigned long long lines;
+    long long nsecs;
+    unsigned long long allocs;
+    unsigned long long bytes;
+};
+
+// the output of one read() of mplayer
+struct BenchRead {
+    QByteArray bytes;
+    int channel;
+};
+
+class MpParseBench
+{
+private:
+    MpProcess &m_proc;
+    MyLineSplitter m_splitter[2];
+    // reused like the slots of the reader's ring
+    std::vector<MpPipeLine> m_slots;
+    std::vector<MpLineView> m_lines;
+
+public:
+    BenchCounter split;
+    BenchCounter cat[MpMetrics::ParseCategoryCount];
+
+    explicit MpParseBench(MpProcess &proc)
+        : m_proc(proc)
+    {
+        memset(&split, 0, sizeof(split));
+        memset(cat, 0, sizeof(cat));
+        // as if mplayer was playing along
+        m_proc.m_cfg_currently_parsing_mplayer_text = true;
+        m_proc.m_curr_state = MpState::PlayingState;
+    }
+
+    static void add(BenchCounter &c, unsigned long long lines, long long t0, long long t1, const BenchAllocs &a0, const BenchAllocs &a1)
+    {
+        c.lines += lines;
+        c.nsecs += t1 - t0;
+        c.allocs += a1.calls - a0.calls;
+        c.bytes += a1.bytes - a0.bytes;
+    }
+
+    void run_read(const BenchRead &rd)
+    {
+        const MonoTime readtime = MonoTime::now();
+        MyLineSplitter &splitter = m_splitter[rd.channel];
+
+        BenchAllocs a0 = bench_allocs();
+        long long t0 = bench_now_nsecs();
+
+        splitter.append(rd.bytes);
+        m_lines.clear();
+        MpLineView v;
+
+        while(splitter.next_line(&v.data, &v.len)) {
+            if(v.len > 0) {
+                m_lines.push_back(v);
+            }
+        }
+
+        long long t1 = bench_now_nsecs();
+        BenchAllocs a1 = bench_allocs();
+        add(split, m_lines.size(), t0, t1, a0, a1);
+
+        if(m_slots.size() < m_lines.size()) {
+            m_slots.resize(m_lines.size());
+        }
+
+        QByteArray positionline;
+        MpParsedLine positionparsed;
+        QList<MpState> newstates;
+        QStringList errorreasons;
+        QList<double> foundspeeds;
+
+        for(size_t i = 0; i < m_lines.size(); i++) {
+            const MpLineView &line = m_lines[i];
+            MpPipeLine *pl = &m_slots[i];
+
+            a0 = bench_allocs();
+            t0 = bench_now_nsecs();
+
+            // MpPipeReader::push_lines()
+            pl->line.resize(line.len);
+            memcpy(pl->line.data(), line.data, line.len);
+            pl->c = rd.channel;
+            pl->t = readtime;
+            MpPipeReader::parse_line(pl);
+
+            MpLineView bline;
+            bline.data = pl->line.constData();
+            bline.len = pl->line.size();
+            const MpLineKind kind = m_proc.parseLine(bline, pl->parsed, positionline, positionparsed, newstates, errorreasons, foundspeeds);
+
+            t1 = bench_now_nsecs();
+            a1 = bench_allocs();
+
+            // not timed, MpProcess only does this for debug output
+            const unsigned noise = mpnoise_classify(bline);
+            add(cat[MpMetrics::parse_category_of(kind, noise)], 1, t0, t1, a0, a1);
+        }
+
+        if(!positionline.isEmpty()) {
+            MpLineView pline;
+            pline.data = positionline.constData();
+            pline.len = positionline.size();
+
+            a0 = bench_allocs();
+            t0 = bench_now_nsecs();
+            m_proc.parsePosition(pline, positionparsed, readtime);
+            t1 = bench_now_nsecs();
+            a1 = bench_allocs();
+            add(cat[MpMetrics::ParsePosition], 1, t0, t1, a0, a1);
+        }
+    }
+};
+
+static void report(char const *const name, const BenchCounter &c)
+{
+    if(c.lines == 0) {
+        return;
+    }
+
+    ::printf("%-12s %9llu lines %8.1f ns/line %8.2f allocs/line %10.1f bytes/line\n",
+             name,
+             c.lines,
+             double(c.nsecs) / double(c.lines),
+             double(c.allocs) / double(c.lines),
+             double(c.bytes) / double(c.lines));
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    std::vector<ReplayRecord> records;
+
+    if(!bench_load_corpus(argc > 1 ? argv[1] : NULL, &records)) {
+        return 1;
+    }
+
+    // records with the same time and channel came in one read()
+    std::vector<BenchRead> reads;
+
+    for(size_t i = 0; i < records.size(); i++) {
+        const ReplayRecord &r = records[i];
+        const int channel = (r.channel == 'O' ? MpPipeReader::Out : MpPipeReader::Err);
+
+        if(i == 0 || r.msecs != records[i - 1].msecs || r.channel != records[i - 1].channel) {
+            BenchRead rd;
+            rd.channel = channel;
+            reads.push_back(rd);
+        }
+
+        reads.back().bytes.append(r.line.data(), int(r.line.size()));
+        reads.back().bytes.append('\n');
+    }
+
+    const int rounds = (argc > 2 ? atoi(argv[2]) : int(1000000 / records.size()) + 1);
+    ::printf("%zu lines in %zu reads, %d rounds\n", records.size(), reads.size(), rounds);
+
+    // the timer itself, to be subtracted when reading the numbers
+    const long long c0 = bench_now_nsecs();
+
+    for(int i = 0; i < 1000000; i++) {
+        bench_now_nsecs();
+    }
+
+    ::printf("clock_gettime: %.1f ns\n", double(bench_now_nsecs() - c0) / 1e6);
+
+    MpMediaInfo mediainfo;
+    MpProcess proc(NULL, &mediainfo, false);
+    MpParseBench bench(proc);
+
+    for(int r = 0; r < rounds; r++) {
+        for(size_t i = 0; i < reads.size(); i++) {
+            bench.run_read(reads[i]);
+        }
+
+        // anything parseLine() or parsePosition() posted
+        QCoreApplication::removePostedEvents(&proc);
+    }
+
+    report("split", bench.split);
+
+    for(int c = 0; c < MpMetrics::ParseCategoryCount; c++) {
+        report(MpMetrics::parse_category_name(MpMetrics::ParseCategory(c)), bench.cat[c]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,9 @@
+TEMPLATE = app
+TARGET = bench_mpparse
+CONFIG += console c++11
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS += -W -Wall
+DEFINES += BENCH_DATA_DIR=\\\"$$PWD/data\\\"
+include(mpprocess.pri)
+HEADERS += benchutil.h
+SOURCES += benchutil.cpp bench_mpparse.cpp
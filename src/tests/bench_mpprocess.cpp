@@ -0,0 +1,238 @@
+// Drives MpProcess through the scripted mplayer stand-in and reports how
+// fast it loads, how many lines a second it keeps up with and how long
+// seeks take. The stand-in is this binary, started by MpProcess as
+// "-slave ..." with MP_SCRIPT set.
+//
+// usage: bench_mpprocess [stream secs [seeks [seek delay msecs [status lines per msec]]]]
+
+#include "bench_mpprocess.h"
+
+#include "../mpmediainfo.h"
+#include "../mpreplay.h"
+#include "../probehelper_child.h"
+#include "../safe_signals.h"
+
+#include <QCoreApplication>
+#include <QTemporaryFile>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// seconds, long enough to never reach the end
+static_var const double bench_media_length = 3600.;
+// the file MpProcess probes before loading it
+static_var const int bench_media_bytes = 1024 * 1024;
+// gives up on a load or seek after this
+static_var const int bench_step_timeout_msec = 10000;
+// between the end of a seek and the next one
+static_var const int bench_seek_gap_msec = 200;
+
+BenchDriver::BenchDriver(MpProcess &proc, const QString &mediafn, double length, int stream_msecs, int nseeks)
+    : super()
+    , m_proc(proc)
+    , m_mediafn(mediafn)
+    , m_length(length)
+    , m_stream_msecs(stream_msecs)
+    , m_nseeks(nseeks)
+    , m_phase(Loading)
+    , m_stream_start_lines(0)
+    , m_positions(0)
+    , m_seeks_done(0)
+    , m_seek_seen(0)
+    , m_seek_waiting(false)
+    , failures(0)
+    , load_usecs(-1)
+    , lines_per_sec(0)
+    , positions_per_sec(0)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setParent(this);
+    XCONNECT(&m_timer, SIGNAL(timeout()), this, SLOT(slot_timeout()));
+    XCONNECT(&m_proc, SIGNAL(sig_loadDone()), this, SLOT(slot_loadDone()));
+    XCONNECT(&m_proc, SIGNAL(sig_streamPositionChanged(double)), this, SLOT(slot_position(double)));
+    XCONNECT(&m_proc, SIGNAL(sig_seekedTo(double)), this, SLOT(slot_seekedTo(double)));
+}
+
+quint64 BenchDriver::lines_parsed() const
+{
+    quint64 ret = 0;
+
+    for(int c = 0; c < MpMetrics::ParsePosition; c++) {
+        ret += m_proc.metrics().parse[c].lines;
+    }
+
+    return ret;
+}
+
+void BenchDriver::start()
+{
+    m_load_start = MonoTime::now();
+    m_proc.slot_load(m_mediafn);
+    m_timer.start(bench_step_timeout_msec);
+}
+
+void BenchDriver::finish(bool ok, char const *const why)
+{
+    if(!ok) {
+        ::fprintf(stderr, "FAIL %s\n", why);
+        failures++;
+    }
+
+    m_phase = Done;
+    m_timer.stop();
+    emit sig_done();
+}
+
+void BenchDriver::slot_loadDone()
+{
+    if(m_phase != Loading) {
+        return;
+    }
+
+    load_usecs = (MonoTime::now().nsecs() - m_load_start.nsecs()) / 1000;
+    m_phase = Streaming;
+    m_stream_start = MonoTime::now();
+    m_stream_start_lines = lines_parsed();
+    m_positions = 0;
+    m_timer.start(m_stream_msecs);
+}
+
+void BenchDriver::slot_position(double pos)
+{
+    Q_UNUSED(pos);
+    m_positions++;
+
+    if(m_phase != Seeking || !m_seek_waiting) {
+        return;
+    }
+
+    // MpProcess trusted a position after the seek
+    if(m_proc.metrics().seek_to_position.count() > m_seek_seen) {
+        m_seek_waiting = false;
+        m_seeks_done++;
+        m_timer.start(bench_seek_gap_msec);
+    }
+}
+
+void BenchDriver::slot_seekedTo(double pos)
+{
+    Q_UNUSED(pos);
+
+    if(m_phase == Seeking && !m_seek_start.isNull()) {
+        seek_queue.record(m_seek_start, MonoTime::now());
+        m_seek_start = MonoTime();
+    }
+}
+
+void BenchDriver::next_seek()
+{
+    if(m_seeks_done >= m_nseeks) {
+        finish(true, NULL);
+        return;
+    }
+
+    // spread over the file, away from both ends
+    const double target = 10. + double(qrand() % 1000) * (m_length - 20.) / 1000.;
+    m_seek_seen = m_proc.metrics().seek_to_position.count();
+    m_seek_waiting = true;
+    m_seek_start = MonoTime::now();
+    m_proc.slot_abs_seek_from_keyboard(target);
+    m_timer.start(bench_step_timeout_msec);
+}
+
+void BenchDriver::slot_timeout()
+{
+    switch(m_phase) {
+        case Loading:
+            finish(false, "loading timed out");
+            break;
+
+        case Streaming: {
+            const double secs = double(MonoTime::now().nsecs() - m_stream_start.nsecs()) / 1e9;
+            lines_per_sec = double(lines_parsed() - m_stream_start_lines) / secs;
+            positions_per_sec = double(m_positions) / secs;
+            m_phase = Seeking;
+            next_seek();
+            break;
+        }
+
+        case Seeking:
+            if(m_seek_waiting) {
+                finish(false, "seek timed out");
+                break;
+            }
+
+            next_seek();
+            break;
+
+        case Done:
+            break;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // started by MpProcess, see probehelper.h
+    if(argc >= 2 && 0 == strcmp(argv[1], PROBEHELPER_ARG)) {
+        return probehelper_main(PROBEHELPER_FD);
+    }
+
+    // started by MpProcess as mplayer
+    if(argc >= 2 && 0 == strcmp(argv[1], "-slave") && getenv("MP_SCRIPT") != NULL) {
+        return mpreplay_script_main(getenv("MP_SCRIPT"));
+    }
+
+    QCoreApplication app(argc, argv);
+
+    const int stream_secs = (argc > 1 ? atoi(argv[1]) : 3);
+    const int nseeks = (argc > 2 ? atoi(argv[2]) : 50);
+    const int seek_delay_msecs = (argc > 3 ? atoi(argv[3]) : 20);
+    const int lines_per_msec = (argc > 4 ? atoi(argv[4]) : 20);
+
+    QTemporaryFile media;
+    QTemporaryFile script;
+
+    if(!media.open() || !script.open()) {
+        ::fprintf(stderr, "could not create temporary files\n");
+        return 1;
+    }
+
+    media.write(QByteArray(bench_media_bytes, 'x'));
+    media.flush();
+
+    const QByteArray scripttext = QByteArray("identify ID_VIDEO_WIDTH=640\n")
+                                  + "identify ID_VIDEO_HEIGHT=360\n"
+                                  + "identify ID_VIDEO_FPS=25.000\n"
+                                  + "length " + QByteArray::number(bench_media_length) + "\n"
+                                  + "statusline 1 " + QByteArray::number(lines_per_msec) + "\n"
+                                  + "delay loadfile 50\n"
+                                  + "delay seek " + QByteArray::number(seek_delay_msecs) + "\n";
+    script.write(scripttext);
+    script.flush();
+    qputenv("MP_SCRIPT", script.fileName().toLocal8Bit());
+
+    MpMediaInfo mediainfo;
+    MpProcess proc(NULL, &mediainfo, false);
+    proc.setMplayerPath(QCoreApplication::applicationFilePath());
+    proc.start_process(0, QStringList());
+
+    BenchDriver driver(proc, media.fileName(), bench_media_length, stream_secs * 1000, nseeks);
+    XCONNECT(&driver, SIGNAL(sig_done()), &app, SLOT(quit()), QUEUEDCONN);
+    driver.start();
+    app.exec();
+    proc.quit();
+
+    ::printf("load:          %.1f ms\n", double(driver.load_usecs) / 1000.);
+    ::printf("throughput:    %.0f lines/s, %.0f positions/s\n", driver.lines_per_sec, driver.positions_per_sec);
+    ::printf("seek queued:   %s\n", qPrintable(driver.seek_queue.summary()));
+    ::printf("seek to pos:   %s\n", qPrintable(proc.metrics().seek_to_position.summary()));
+    ::printf("%s\n", qPrintable(proc.metrics().report()));
+
+    if(driver.failures > 0) {
+        ::fprintf(stderr, "%d FAILED\n", driver.failures);
+        return 1;
+    }
+
+    return 0;
+}
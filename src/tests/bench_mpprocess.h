@@ -0,0 +1,81 @@
+#ifndef BENCH_MPPROCESS_H
+#define BENCH_MPPROCESS_H
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#include "../mpprocess.h"
+#include "../monotime.h"
+#include "../latencyhistogram.h"
+
+// Plays a file with MpProcess talking to the MP_SCRIPT stand-in: loads
+// it, lets the status lines stream for a while and then seeks around.
+class BenchDriver : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef QObject super;
+
+private:
+    MpProcess &m_proc;
+    const QString m_mediafn;
+    const double m_length;
+    const int m_stream_msecs;
+    const int m_nseeks;
+
+    enum Phase {
+        Loading,
+        Streaming,
+        Seeking,
+        Done
+    };
+    Phase m_phase;
+    QTimer m_timer;
+
+    MonoTime m_load_start;
+    MonoTime m_stream_start;
+    quint64 m_stream_start_lines;
+    quint64 m_positions;
+
+    int m_seeks_done;
+    MonoTime m_seek_start;
+    // seek_to_position count when the seek went out
+    quint64 m_seek_seen;
+    bool m_seek_waiting;
+
+    // forbid
+    BenchDriver();
+    BenchDriver(const BenchDriver &);
+    BenchDriver &operator=(const BenchDriver &in);
+
+public:
+    int failures;
+    // from slot_load() to sig_loadDone()
+    qint64 load_usecs;
+    double lines_per_sec;
+    double positions_per_sec;
+    // from asking for a seek to MpProcess writing it
+    MyLatencyHistogram seek_queue;
+
+    BenchDriver(MpProcess &proc, const QString &mediafn, double length, int stream_msecs, int nseeks);
+
+    void start();
+
+private:
+    quint64 lines_parsed() const;
+    void next_seek();
+    void finish(bool ok, char const *const why);
+
+signals:
+    void sig_done();
+
+private slots:
+    void slot_loadDone();
+    void slot_position(double pos);
+    void slot_seekedTo(double pos);
+    void slot_timeout();
+};
+
+#endif // BENCH_MPPROCESS_H
@@ -0,0 +1,8 @@
+TEMPLATE = app
+TARGET = bench_mpprocess
+CONFIG += console c++11
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS += -W -Wall
+include(mpprocess.pri)
+HEADERS += bench_mpprocess.h
+SOURCES += bench_mpprocess.cpp
@@ -0,0 +1,182 @@
+// mpstatusline_parse() against the regex split plus QString::toDouble()
+// that parsePosition used before, on the STATUSLINEs of an MP_TRACE file.
+//
+// usage: bench_mpstatusline [trace [rounds]]
+
+#include "../mplinedispatch.h"
+#include "../mpstatusline.h"
+#include "../vregularexpression.h"
+#include "benchutil.h"
+
+#include <QString>
+#include <QStringList>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct Fields {
+    bool has_a;
+    double a;
+    bool has_v;
+    double v;
+    bool has_av;
+    double av;
+};
+
+// what parsePosition did with a status line before mpstatusline_parse()
+static void old_parse(const std::string &line, Fields *pf)
+{
+    static_var const VRegularExpression rx_split("[ :]");
+
+    pf->has_a = pf->has_v = pf->has_av = false;
+
+    const QString tline = QString::fromLatin1(line.data(), int(line.size()));
+    const QStringList info = tline.split(rx_split, QString::SkipEmptyParts);
+
+    for(int i = 0; i + 1 < info.count(); i++) {
+        bool ok = false;
+
+        if(info[i] == QLatin1String("A")) {
+            pf->a = info[i + 1].toDouble(&ok);
+            pf->has_a = ok;
+        }
+        else if(info[i] == QLatin1String("V")) {
+            pf->v = info[i + 1].toDouble(&ok);
+            pf->has_v = ok;
+        }
+        else if(info[i] == QLatin1String("A-V")) {
+            pf->av = info[i + 1].toDouble(&ok);
+            pf->has_av = ok;
+        }
+    }
+}
+
+static bool new_parse(const std::string &line, Fields *pf)
+{
+    MpLineView v;
+    v.data = line.data();
+    v.len = int(line.size());
+
+    MpStatusLine st;
+
+    if(!mpstatusline_parse(v, &st)) {
+        return false;
+    }
+
+    pf->has_a = st.has_a;
+    pf->a = st.a;
+    pf->has_v = st.has_v;
+    pf->v = st.v;
+    pf->has_av = st.has_av;
+    pf->av = st.av;
+    return true;
+}
+
+static bool same(bool has1, double v1, bool has2, double v2)
+{
+    if(has1 != has2) {
+        return false;
+    }
+
+    return !has1 || (v1 - v2 < 1e-9 && v2 - v1 < 1e-9);
+}
+
+static void report(char const *const name, unsigned long long lines, long long nsecs, const BenchAllocs &before, const BenchAllocs &after)
+{
+    ::printf("%-20s %8.1f ns/line %8.2f allocs/line %10.1f bytes/line\n",
+             name,
+             double(nsecs) / double(lines),
+             double(after.calls - before.calls) / double(lines),
+             double(after.bytes - before.bytes) / double(lines));
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<ReplayRecord> records;
+
+    if(!bench_load_corpus(argc > 1 ? argv[1] : NULL, &records)) {
+        return 1;
+    }
+
+    std::vector<std::string> lines;
+
+    for(size_t i = 0; i < records.size(); i++) {
+        MpLineView v;
+        v.data = records[i].line.data();
+        v.len = int(records[i].line.size());
+
+        const MpLineView tline = mpline_trimmed(v);
+        MpLineView value;
+
+        if(mpline_classify(tline, &value) == MpLineKind::StatusLine) {
+            lines.push_back(std::string(tline.data, tline.len));
+        }
+    }
+
+    if(lines.empty()) {
+        ::fprintf(stderr, "no STATUSLINE in the corpus\n");
+        return 1;
+    }
+
+    // both have to agree before their speed matters
+    int failures = 0;
+
+    for(size_t i = 0; i < lines.size(); i++) {
+        Fields fo;
+        Fields fn;
+        old_parse(lines[i], &fo);
+
+        if(!new_parse(lines[i], &fn)) {
+            ::fprintf(stderr, "FAIL \"%s\": mpstatusline_parse failed\n", lines[i].c_str());
+            failures++;
+        }
+        else if(!same(fo.has_a, fo.a, fn.has_a, fn.a) || !same(fo.has_v, fo.v, fn.has_v, fn.v) || !same(fo.has_av, fo.av, fn.has_av, fn.av)) {
+            ::fprintf(stderr, "FAIL \"%s\": parsers disagree\n", lines[i].c_str());
+            failures++;
+        }
+    }
+
+    if(failures > 0) {
+        ::fprintf(stderr, "%d FAILED\n", failures);
+        return 1;
+    }
+
+    const int rounds = (argc > 2 ? atoi(argv[2]) : int(1000000 / lines.size()) + 1);
+    const unsigned long long nlines = (unsigned long long)rounds * lines.size();
+    ::printf("%zu status lines, %d rounds\n", lines.size(), rounds);
+
+    // keeps the results alive
+    double sink = 0;
+    Fields f;
+
+    BenchAllocs a0 = bench_allocs();
+    long long t0 = bench_now_nsecs();
+
+    for(int r = 0; r < rounds; r++) {
+        for(size_t i = 0; i < lines.size(); i++) {
+            old_parse(lines[i], &f);
+            sink += f.a;
+        }
+    }
+
+    long long t1 = bench_now_nsecs();
+    BenchAllocs a1 = bench_allocs();
+    report("regex split", nlines, t1 - t0, a0, a1);
+
+    a0 = bench_allocs();
+    t0 = bench_now_nsecs();
+
+    for(int r = 0; r < rounds; r++) {
+        for(size_t i = 0; i < lines.size(); i++) {
+            new_parse(lines[i], &f);
+            sink += f.a;
+        }
+    }
+
+    t1 = bench_now_nsecs();
+    a1 = bench_allocs();
+    report("mpstatusline_parse", nlines, t1 - t0, a0, a1);
+
+    ::printf("(%g)\n", sink);
+    return 0;
+}
@@ -0,0 +1,10 @@
+TEMPLATE = app
+TARGET = bench_mpstatusline
+CONFIG += console c++11
+CONFIG -= app_bundle
+QT = core
+QMAKE_CXXFLAGS += -W -Wall
+DEFINES += static_var=static
+DEFINES += BENCH_DATA_DIR=\\\"$$PWD/data\\\"
+HEADERS = ../mplinedispatch.h ../mpstatusline.h ../mpreplay.h ../vregularexpression.h benchutil.h
+SOURCES = ../mplinedispatch.cpp ../mpstatusline.cpp ../mpreplay.cpp benchutil.cpp bench_mpstatusline.cpp
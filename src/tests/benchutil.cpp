@@ -0,0 +1,76 @@
+#include "benchutil.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+
+extern "C" {
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t n, size_t size);
+    void *__libc_realloc(void *p, size_t size);
+}
+
+static thread_local unsigned long long alloc_calls = 0;
+static thread_local unsigned long long alloc_bytes = 0;
+
+extern "C" void *malloc(size_t size)
+{
+    alloc_calls++;
+    alloc_bytes += size;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+    alloc_calls++;
+    alloc_bytes += n * size;
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *p, size_t size)
+{
+    alloc_calls++;
+    alloc_bytes += size;
+    return __libc_realloc(p, size);
+}
+
+BenchAllocs bench_allocs()
+{
+    BenchAllocs ret;
+    ret.calls = alloc_calls;
+    ret.bytes = alloc_bytes;
+    return ret;
+}
+
+long long bench_now_nsecs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+bool bench_load_corpus(char const *tracefn, std::vector<ReplayRecord> *records)
+{
+    if(tracefn == NULL) {
+        tracefn = BENCH_DATA_DIR "/mplayer-all9.trace";
+    }
+
+    std::vector<ReplayRecord> all;
+
+    if(!mpreplay_read_trace(tracefn, &all)) {
+        return false;
+    }
+
+    for(size_t i = 0; i < all.size(); i++) {
+        if(all[i].channel != 'I') {
+            records->push_back(all[i]);
+        }
+    }
+
+    if(records->empty()) {
+        fprintf(stderr, "%s: no mplayer output in there\n", tracefn);
+        return false;
+    }
+
+    return true;
+}
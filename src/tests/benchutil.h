@@ -0,0 +1,25 @@
+#ifndef BENCHUTIL_H
+#define BENCHUTIL_H
+
+#include <vector>
+
+#include "../mpreplay.h"
+
+// Heap allocations of the calling thread, Qt's included: benchutil.cpp
+// interposes malloc(), calloc() and realloc() and hands them on to glibc.
+// posix_memalign() and friends are not counted.
+struct BenchAllocs {
+    unsigned long long calls;
+    unsigned long long bytes;
+};
+
+// running totals, subtract two of them
+BenchAllocs bench_allocs();
+
+long long bench_now_nsecs();
+
+// What mplayer wrote (the O and E records) in an MP_TRACE file. Without a
+// file name, the sample in tests/data is used.
+bool bench_load_corpus(char const *tracefn, std::vector<ReplayRecord> *records);
+
+#endif // BENCHUTIL_H
@@ -0,0 +1,87 @@
+# MpProcess and what it pulls in, for test targets that drive it
+QT += widgets dbus
+LIBS += -lX11
+DEFINES += QT_NO_CAST_FROM_ASCII QT_USE_QSTRINGBUILDER QT_USE_FAST_CONCATENATION QT_USE_FAST_OPERATOR_PLUS QT_NO_CAST_FROM_BYTEARRAY
+DEFINES += static_var=static
+INCLUDEPATH += ..
+
+HEADERS += \
+    ../util.h \
+    ../mpmediainfo.h \
+    ../checkedget.h \
+    ../mpprocess.h \
+    ../mpstate.h \
+    ../gui_overlayquit.h \
+    ../singleqprocesssingleshot.h \
+    ../singleqprocess.h \
+    ../screensavermanager.h \
+    ../qprocess_meta.h \
+    ../dbus.h \
+    ../xsetscreensaver.h \
+    ../asynckillproc.h \
+    ../asyncreadfile.h \
+    ../asyncreadfile_child.h \
+    ../asynckillproc_p.h \
+    ../safe_signals.h \
+    ../config.h \
+    ../encoding.h \
+    ../event_types.h \
+    ../vregularexpression.h \
+    ../deathsigprocess.h \
+    ../focusstack.h \
+    ../event_desc.h \
+    ../linesplitter.h \
+    ../mplinedispatch.h \
+    ../mpstatusline.h \
+    ../mpnoiseclassifier.h \
+    ../objectring.h \
+    ../monotime.h \
+    ../spscring.h \
+    ../mppipereader.h \
+    ../latencyhistogram.h \
+    ../mpmetrics.h \
+    ../mppositionestimator.h \
+    ../mpreplay.h \
+    ../probehelper.h \
+    ../probehelper_child.h \
+    ../asyncprobe.h \
+    ../pagecachewarmup.h \
+    ../mountthroughput.h \
+    ../probecache.h
+SOURCES += \
+    ../util.cpp \
+    ../mpmediainfo.cpp \
+    ../mpprocess.cpp \
+    ../mpstate.cpp \
+    ../gui_overlayquit.cpp \
+    ../singleqprocesssingleshot.cpp \
+    ../singleqprocess.cpp \
+    ../screensavermanager.cpp \
+    ../dbus.cpp \
+    ../xsetscreensaver.cpp \
+    ../asynckillproc.cpp \
+    ../asyncreadfile.cpp \
+    ../asyncreadfile_child.cpp \
+    ../asynckillproc_p.cpp \
+    ../config.cpp \
+    ../encoding.cpp \
+    ../event_types.cpp \
+    ../deathsigprocess.cpp \
+    ../focusstack.cpp \
+    ../event_desc.cpp \
+    ../qprocess_meta.cpp \
+    ../mplinedispatch.cpp \
+    ../mpstatusline.cpp \
+    ../mpnoiseclassifier.cpp \
+    ../monotime.cpp \
+    ../mppipereader.cpp \
+    ../latencyhistogram.cpp \
+    ../mpmetrics.cpp \
+    ../mppositionestimator.cpp \
+    ../mpreplay.cpp \
+    ../probehelper.cpp \
+    ../probehelper_child.cpp \
+    ../asyncprobe.cpp \
+    ../pagecachewarmup.cpp \
+    ../mountthroughput.cpp \
+    ../probecache.cpp
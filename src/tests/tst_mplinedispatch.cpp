@@ -0,0 +1,49 @@
+#include "../mplinedispatch.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+static void expect_kind(char const *const line, MpLineKind want, char const *const want_value)
+{
+    MpLineView v;
+    v.data = line;
+    v.len = int(::strlen(line));
+
+    MpLineView value;
+    const MpLineKind got = mpline_classify(mpline_trimmed(v), &value);
+
+    if(got != want) {
+        ::fprintf(stderr, "FAIL \"%s\": kind %d, expected %d\n", line, int(got), int(want));
+        failures++;
+        return;
+    }
+
+    if(want_value != NULL && (value.len != int(::strlen(want_value)) || 0 != ::memcmp(value.data, want_value, value.len))) {
+        ::fprintf(stderr, "FAIL \"%s\": value \"%.*s\", expected \"%s\"\n", line, value.len, value.data, want_value);
+        failures++;
+    }
+}
+
+int main()
+{
+    expect_kind("IDENTIFY: ID_PAUSED", MpLineKind::IdPaused, NULL);
+    // the pause comes after a status line without a newline
+    expect_kind("STATUSLINE: A:  12.3 V:  12.3 A-V:  0.000 ct:  0.000   0/  0  2%  1%  0.4% 0 0 IDENTIFY: ID_PAUSED", MpLineKind::IdPaused, NULL);
+    expect_kind("STATUSLINE: A:  12.3 V:  12.3 A-V:  0.000", MpLineKind::StatusLine, "  12.3 V:  12.3 A-V:  0.000");
+    expect_kind("IDENTIFY: ID_PAUSED_NOT", MpLineKind::Identify, "PAUSED_NOT");
+    expect_kind("IDENTIFY: ID_EXIT=QUIT", MpLineKind::IdExit, "=QUIT");
+    expect_kind("  GLOBAL: ANS_pause=yes \r", MpLineKind::AnsPauseYes, "");
+    expect_kind("GLOBAL: ANS_pause=yesno", MpLineKind::Unknown, NULL);
+    expect_kind("Stream: No stream found to handle url x", MpLineKind::NoStreamFound, NULL);
+    expect_kind("", MpLineKind::Unknown, NULL);
+
+    if(failures > 0) {
+        ::fprintf(stderr, "%d FAILED\n", failures);
+        return 1;
+    }
+
+    ::printf("all passed\n");
+    return 0;
+}
@@ -0,0 +1,15 @@
+TEMPLATE = app
+TARGET = tst_mplinedispatch
+CONFIG += console c++11
+CONFIG -= qt app_bundle
+
+QMAKE_CXXFLAGS += -W -Wall
+
+DEFINES += static_var=static
+
+HEADERS = \
+    ../mplinedispatch.h
+
+SOURCES = \
+    ../mplinedispatch.cpp \
+    tst_mplinedispatch.cpp